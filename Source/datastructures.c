@@ -1,7 +1,688 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE		// for pthread_setaffinity_np
+#endif
+
 #include "datastructures.h"
 #include <stdio.h>
 #include <string.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+/* --------------------------- platform helpers --------------------------- */
+
+#ifdef _WIN32
+typedef HANDLE ds_thread_t;
+typedef LPTHREAD_START_ROUTINE ds_thread_func_t;
+#define DS_THREAD_FUNC DWORD WINAPI
+#define DS_THREAD_RETURN 0
+#else
+typedef pthread_t ds_thread_t;
+typedef void *(*ds_thread_func_t)(void *);
+#define DS_THREAD_FUNC void *
+#define DS_THREAD_RETURN NULL
+#endif
+
+#ifdef _WIN32
+typedef SRWLOCK ds_mutex_t;
+typedef CONDITION_VARIABLE ds_cond_t;
+#define DS_THREAD_LOCAL __declspec(thread)
+#else
+typedef pthread_mutex_t ds_mutex_t;
+typedef pthread_cond_t ds_cond_t;
+#define DS_THREAD_LOCAL __thread
+#endif
+
+/* Size of a cache line, in bytes */
+#define CACHE_LINE_SIZE 64
+
+/** Start a new thread running `func(arg)`. Return whether the thread was
+ * started. */
+static bool ds_thread_create(ds_thread_t *thread, ds_thread_func_t func, void *arg) {
+#ifdef _WIN32
+	return (*thread = CreateThread(NULL, 0, func, arg, 0, NULL)) != NULL;
+#else
+	return pthread_create(thread, NULL, func, arg) == 0;
+#endif
+}
+
+/** Wait for `thread` to finish and release its resources. */
+static void ds_thread_join(ds_thread_t thread) {
+#ifdef _WIN32
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+#else
+	pthread_join(thread, NULL);
+#endif
+}
+
+/** Return the number of online processors, at least 1. */
+static int64_t ds_cpu_count(void) {
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return MAX((int64_t)info.dwNumberOfProcessors, 1);
+#else
+	return MAX((int64_t)sysconf(_SC_NPROCESSORS_ONLN), 1);
+#endif
+}
+
+/** Bind `thread` to processor `cpu` modulo the number of processors. Pinning
+ * is best effort and silently does nothing where unsupported. */
+static void ds_thread_pin(ds_thread_t thread, int64_t cpu) {
+	cpu %= ds_cpu_count();
+#if defined(_WIN32)
+	if (cpu < (int64_t)sizeof(DWORD_PTR) * 8) SetThreadAffinityMask(thread, (DWORD_PTR)1 << cpu);
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET((int)cpu, &set);
+	pthread_setaffinity_np(thread, sizeof(set), &set);
+#else
+	(void)thread;
+#endif
+}
+
+/** Give up the rest of the calling thread's time slice. */
+static void ds_thread_yield(void) {
+#ifdef _WIN32
+	SwitchToThread();
+#else
+	sched_yield();
+#endif
+}
+
+static void ds_mutex_init(ds_mutex_t *mutex) {
+#ifdef _WIN32
+	InitializeSRWLock(mutex);
+#else
+	pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+static void ds_mutex_destroy(ds_mutex_t *mutex) {
+#ifdef _WIN32
+	(void)mutex;
+#else
+	pthread_mutex_destroy(mutex);
+#endif
+}
+
+static void ds_mutex_lock(ds_mutex_t *mutex) {
+#ifdef _WIN32
+	AcquireSRWLockExclusive(mutex);
+#else
+	pthread_mutex_lock(mutex);
+#endif
+}
+
+static void ds_mutex_unlock(ds_mutex_t *mutex) {
+#ifdef _WIN32
+	ReleaseSRWLockExclusive(mutex);
+#else
+	pthread_mutex_unlock(mutex);
+#endif
+}
+
+static void ds_cond_init(ds_cond_t *cond) {
+#ifdef _WIN32
+	InitializeConditionVariable(cond);
+#else
+	pthread_cond_init(cond, NULL);
+#endif
+}
+
+static void ds_cond_destroy(ds_cond_t *cond) {
+#ifdef _WIN32
+	(void)cond;
+#else
+	pthread_cond_destroy(cond);
+#endif
+}
+
+/** Atomically release `mutex` and wait on `cond`, then reacquire `mutex`. */
+static void ds_cond_wait(ds_cond_t *cond, ds_mutex_t *mutex) {
+#ifdef _WIN32
+	SleepConditionVariableSRW(cond, mutex, INFINITE, 0);
+#else
+	pthread_cond_wait(cond, mutex);
+#endif
+}
+
+static void ds_cond_signal(ds_cond_t *cond) {
+#ifdef _WIN32
+	WakeConditionVariable(cond);
+#else
+	pthread_cond_signal(cond);
+#endif
+}
+
+static void ds_cond_broadcast(ds_cond_t *cond) {
+#ifdef _WIN32
+	WakeAllConditionVariable(cond);
+#else
+	pthread_cond_broadcast(cond);
+#endif
+}
+
+/* Atomic operations. Loads have acquire semantics, stores have release
+   semantics, and read-modify-write operations are sequentially consistent. */
+
+static int64_t ds_atomic_load(const volatile int64_t *target) {
+#ifdef _WIN32
+	return InterlockedCompareExchange64((volatile LONG64 *)target, 0, 0);
+#else
+	return __atomic_load_n(target, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static void ds_atomic_store(volatile int64_t *target, int64_t value) {
+#ifdef _WIN32
+	InterlockedExchange64((volatile LONG64 *)target, value);
+#else
+	__atomic_store_n(target, value, __ATOMIC_RELEASE);
+#endif
+}
+
+/** Atomically add `value` to `*target` and return the previous value. */
+static int64_t ds_atomic_fetch_add(volatile int64_t *target, int64_t value) {
+#ifdef _WIN32
+	return InterlockedExchangeAdd64((volatile LONG64 *)target, value);
+#else
+	return __atomic_fetch_add(target, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/** If `*target` equals `expected`, set it to `desired` and return true.
+ * Otherwise return false. */
+static bool ds_atomic_cas(volatile int64_t *target, int64_t expected, int64_t desired) {
+#ifdef _WIN32
+	return InterlockedCompareExchange64((volatile LONG64 *)target, desired, expected) == expected;
+#else
+	return __atomic_compare_exchange_n(target, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static void *ds_atomic_load_ptr(void *const volatile *target) {
+#ifdef _WIN32
+	return InterlockedCompareExchangePointer((PVOID volatile *)target, NULL, NULL);
+#else
+	return __atomic_load_n(target, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static void ds_atomic_store_ptr(void *volatile *target, void *value) {
+#ifdef _WIN32
+	InterlockedExchangePointer(target, value);
+#else
+	__atomic_store_n(target, value, __ATOMIC_RELEASE);
+#endif
+}
+
+/** If `*target` equals `expected`, set it to `desired` and return true.
+ * Otherwise return false. */
+static bool ds_atomic_cas_ptr(void *volatile *target, void *expected, void *desired) {
+#ifdef _WIN32
+	return InterlockedCompareExchangePointer(target, desired, expected) == expected;
+#else
+	return __atomic_compare_exchange_n(target, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/** Set `*target` to `value` and return the previous value. */
+static void *ds_atomic_exchange_ptr(void *volatile *target, void *value) {
+#ifdef _WIN32
+	return InterlockedExchangePointer(target, value);
+#else
+	return __atomic_exchange_n(target, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/** Full sequentially consistent memory fence */
+static void ds_atomic_fence(void) {
+#ifdef _WIN32
+	MemoryBarrier();
+#else
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif
+}
+
+/** Return the number of set bits in `x`. */
+static int64_t ds_popcount64(uint64_t x) {
+#if defined(_WIN32) && defined(_M_IX86)
+	// 64-bit intrinsics exist only on x64, so count each half
+	return (int64_t)__popcnt((unsigned int)x) + (int64_t)__popcnt((unsigned int)(x >> 32));
+#elif defined(_WIN32)
+	return (int64_t)__popcnt64(x);
+#else
+	return __builtin_popcountll(x);
+#endif
+}
+
+/** Return the index of the lowest set bit in `x`, which must be nonzero. */
+static int64_t ds_ctz64(uint64_t x) {
+#if defined(_WIN32) && defined(_M_IX86)
+	unsigned long index;
+	if (_BitScanForward(&index, (unsigned long)x)) return (int64_t)index;
+	_BitScanForward(&index, (unsigned long)(x >> 32));
+	return (int64_t)index + 32;
+#elif defined(_WIN32)
+	unsigned long index;
+	_BitScanForward64(&index, x);
+	return (int64_t)index;
+#else
+	return __builtin_ctzll(x);
+#endif
+}
+
+/** Return the index of the highest set bit in `x`, which must be nonzero. */
+static int64_t ds_msb64(uint64_t x) {
+#if defined(_WIN32) && defined(_M_IX86)
+	unsigned long index;
+	if (_BitScanReverse(&index, (unsigned long)(x >> 32))) return (int64_t)index + 32;
+	_BitScanReverse(&index, (unsigned long)x);
+	return (int64_t)index;
+#elif defined(_WIN32)
+	unsigned long index;
+	_BitScanReverse64(&index, x);
+	return (int64_t)index;
+#else
+	return 63 - __builtin_clzll(x);
+#endif
+}
+
+/** Return `x` with its bits mixed so that every bit of the result depends on
+ * every bit of `x`, for hash functions as weak as the identity. */
+static uint64_t ds_mix64(uint64_t x) {
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdull;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ull;
+	x ^= x >> 33;
+	return x;
+}
+
+/** Hint that the cache line holding `address` will be read soon. */
+static void ds_prefetch(const void *address) {
+#ifdef _WIN32
+	PreFetchCacheLine(PF_TEMPORAL_LEVEL_1, address);
+#else
+	__builtin_prefetch(address);
+#endif
+}
+
+/** Open the file at `path` as fopen does. Return NULL on failure. */
+static FILE *ds_fopen(const char *path, const char *mode) {
+#ifdef _WIN32
+	FILE *file;
+	return fopen_s(&file, path, mode) ? NULL : file;
+#else
+	return fopen(path, mode);
+#endif
+}
+
+/** Create and open a binary temporary file for reading and writing that is
+ * deleted once closed. Return NULL on failure. */
+static FILE *ds_tmpfile(void) {
+#ifdef _WIN32
+	// tmpfile creates its file in the root of the drive, usually not writable
+	char dir[MAX_PATH + 1], path[MAX_PATH + 1];
+	DWORD len = GetTempPathA(sizeof(dir), dir);
+	if (!len || len > sizeof(dir) || !GetTempFileNameA(dir, "ds", 0, path)) return NULL;
+	FILE *file = ds_fopen(path, "w+bTD");
+	if (!file) DeleteFileA(path);
+	return file;
+#else
+	return tmpfile();
+#endif
+}
+
+#ifdef DS_PROFILE
+/** Return the time in nanoseconds from an arbitrary fixed point, monotonic. */
+static int64_t ds_now_ns(void) {
+#ifdef _WIN32
+	LARGE_INTEGER counter, frequency;
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	return counter.QuadPart / frequency.QuadPart * 1000000000 + counter.QuadPart % frequency.QuadPart * 1000000000 / frequency.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+#endif
+
+/* ------------------------------- profiling ------------------------------- */
+
+/* Number of bits below the highest set bit that select the bucket of a latency,
+   so that every bucket is at most 1/16 as wide as the latencies it holds */
+#define PROFILE_SUB_BUCKET_BITS 4
+
+/* Number of buckets sharing the same highest set bit */
+#define PROFILE_SUB_BUCKETS (1 << PROFILE_SUB_BUCKET_BITS)
+
+/* Number of buckets of a latency histogram, covering every int64_t */
+#define PROFILE_NUM_BUCKETS ((64 - PROFILE_SUB_BUCKET_BITS + 1) * PROFILE_SUB_BUCKETS)
+
+/* Number of hardware counters read around each profiled call: cycles, cache
+   misses and branch misses */
+#define PROFILE_NUM_COUNTERS 3
+
+/* Statistics of a profiled function, one per function in a static variable */
+typedef struct profile_op_t {
+	const char *name;									// name of the function
+	volatile int64_t registered;						// whether the function was added to profile_ops
+	struct profile_op_t *next;							// next function in profile_ops
+	volatile int64_t count;								// number of calls
+	volatile int64_t counted;							// number of calls with hardware counters
+	volatile int64_t counters[PROFILE_NUM_COUNTERS];	// sum of each hardware counter over counted calls
+	volatile int64_t buckets[PROFILE_NUM_BUCKETS];		// number of calls whose latency falls in each bucket
+} profile_op_t;
+
+/* Call of a profiled function in progress */
+typedef struct {
+	profile_op_t *op;							// statistics of the function
+	int64_t start;								// time at which the call started
+	bool counting;								// whether the hardware counters were read
+	uint64_t counters[PROFILE_NUM_COUNTERS];	// hardware counters when the call started
+} profile_scope_t;
+
+/* Every function profiled so far, most recently first */
+static void *volatile profile_ops;
+
+/* Whether hardware counters are read around profiled calls */
+static volatile int64_t profile_counters_enabled;
+
+#ifdef __linux__
+/* Group of hardware counters of the calling thread, -1 if not open yet, -2 if
+   they could not be opened */
+static DS_THREAD_LOCAL int profile_perf_fd = -1;
+
+/** Open the hardware counters of the calling thread as a group that is read
+ * at once. Return the descriptor of the group leader, -1 on failure. */
+static int profile_perf_open(void) {
+	static const uint64_t configs[PROFILE_NUM_COUNTERS] = {
+		PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+	};
+	int fds[PROFILE_NUM_COUNTERS];
+	for (int i = 0; i < PROFILE_NUM_COUNTERS; i++) {
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = configs[i];
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP;
+		fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, i ? fds[0] : -1, 0);
+		if (fds[i] < 0) {
+			while (i--) close(fds[i]);
+			return -1;
+		}
+	}
+	return fds[0];
+}
+
+/** Read the hardware counters of the calling thread into `counters`, opening
+ * them first if needed. Return false if they could not be opened or read. */
+static bool profile_perf_read(uint64_t *counters) {
+	if (profile_perf_fd == -1 && (profile_perf_fd = profile_perf_open()) < 0) profile_perf_fd = -2;
+	if (profile_perf_fd < 0) return false;
+	struct {
+		uint64_t nr;
+		uint64_t values[PROFILE_NUM_COUNTERS];
+	} data;
+	if (read(profile_perf_fd, &data, sizeof(data)) != (ssize_t)sizeof(data)) return false;
+	memcpy(counters, data.values, sizeof(data.values));
+	return true;
+}
+#else
+static bool profile_perf_read(uint64_t *counters) {
+	return false;
+}
+#endif
+
+/** Return the greatest latency held by bucket `bucket` of a latency histogram. */
+static int64_t profile_bucket_max(int64_t bucket) {
+	if (bucket < PROFILE_SUB_BUCKETS) return bucket;
+	int64_t shift = bucket / PROFILE_SUB_BUCKETS - 1;
+	uint64_t mantissa = PROFILE_SUB_BUCKETS + bucket % PROFILE_SUB_BUCKETS + 1;
+	return (int64_t)MIN((mantissa << shift) - 1, (uint64_t)INT64_MAX);
+}
+
+#ifdef DS_PROFILE
+/** Return the bucket of a latency histogram holding `latency`. */
+static int64_t profile_bucket(uint64_t latency) {
+	if (latency < PROFILE_SUB_BUCKETS) return (int64_t)latency;
+	int64_t shift = ds_msb64(latency) - PROFILE_SUB_BUCKET_BITS;
+	return (shift + 1) * PROFILE_SUB_BUCKETS + (int64_t)(latency >> shift) - PROFILE_SUB_BUCKETS;
+}
+
+/* Number of profiled calls in progress on the calling thread */
+static DS_THREAD_LOCAL int64_t profile_depth;
+
+/** Start a call of the function with statistics `op` and name `name`. */
+static profile_scope_t profile_begin(profile_op_t *op, const char *name) {
+	if (!ds_atomic_load(&op->registered) && ds_atomic_cas(&op->registered, 0, 1)) {
+		op->name = name;
+		do {
+			op->next = ds_atomic_load_ptr(&profile_ops);
+		} while (!ds_atomic_cas_ptr(&profile_ops, op->next, op));
+	}
+	profile_scope_t scope;
+	// a call made by another profiled call is part of that call's latency, so
+	// only the outermost call is recorded
+	if (profile_depth++) {
+		scope.op = NULL;
+		return scope;
+	}
+	scope.op = op;
+	scope.counting = ds_atomic_load(&profile_counters_enabled) && profile_perf_read(scope.counters);
+	// read the clock last so that reading the counters is not part of the latency
+	scope.start = ds_now_ns();
+	return scope;
+}
+
+/** Finish the call `scope` and record its latency and hardware counters. */
+static void profile_end(profile_scope_t *scope) {
+	profile_depth--;
+	profile_op_t *op = scope->op;
+	if (!op) return;
+	int64_t latency = ds_now_ns() - scope->start;
+	uint64_t counters[PROFILE_NUM_COUNTERS];
+	if (scope->counting && profile_perf_read(counters)) {
+		for (int i = 0; i < PROFILE_NUM_COUNTERS; i++) {
+			ds_atomic_fetch_add(&op->counters[i], (int64_t)(counters[i] - scope->counters[i]));
+		}
+		ds_atomic_fetch_add(&op->counted, 1);
+	}
+	ds_atomic_fetch_add(&op->buckets[profile_bucket((uint64_t)MAX(latency, 0))], 1);
+	ds_atomic_fetch_add(&op->count, 1);
+}
+#endif
+
+/* Profile the enclosing function from this point until it returns, in builds
+   with DS_PROFILE defined. Relies on the cleanup attribute of GCC and Clang. */
+#ifdef DS_PROFILE
+#if defined(__GNUC__)
+#define PROFILE_FUNCTION() \
+	static profile_op_t profile_op; \
+	profile_scope_t profile_scope __attribute__((cleanup(profile_end))) = profile_begin(&profile_op, __func__)
+#else
+#error DS_PROFILE requires a compiler supporting __attribute__((cleanup)), such as GCC or Clang
+#endif
+#else
+#define PROFILE_FUNCTION() do {} while (0)
+#endif
+
+bool ds_profile_enable_counters(bool enable) {
+	if (enable) {
+		uint64_t counters[PROFILE_NUM_COUNTERS];
+		if (!profile_perf_read(counters)) return false;
+	}
+	ds_atomic_store(&profile_counters_enabled, enable);
+	return true;
+}
+
+/** Return the smallest latency not exceeded by the fraction `quantile` of the
+ * calls recorded in `op`. */
+static int64_t profile_quantile(const profile_op_t *op, int64_t count, double quantile) {
+	int64_t rank = MAX((int64_t)(quantile * (double)count + 0.999999), 1), seen = 0;
+	for (int64_t bucket = 0; bucket < PROFILE_NUM_BUCKETS; bucket++) {
+		seen += op->buckets[bucket];
+		if (seen >= rank) return profile_bucket_max(bucket);
+	}
+	return 0;
+}
+
+int64_t ds_profile_snapshot(ds_profile_stats_t *stats, int64_t max_stats) {
+	int64_t num_ops = 0;
+	for (const profile_op_t *op = ds_atomic_load_ptr(&profile_ops); op; op = op->next, num_ops++) {
+		if (num_ops >= max_stats) continue;
+		ds_profile_stats_t *stat = &stats[num_ops];
+		int64_t count = 0;
+		for (int64_t bucket = 0; bucket < PROFILE_NUM_BUCKETS; bucket++) {
+			count += ds_atomic_load(&op->buckets[bucket]);
+		}
+		stat->name = op->name;
+		stat->count = count;
+		stat->p50 = profile_quantile(op, count, 0.5);
+		stat->p99 = profile_quantile(op, count, 0.99);
+		stat->p999 = profile_quantile(op, count, 0.999);
+		stat->max = profile_quantile(op, count, 1.0);
+		int64_t counted = ds_atomic_load(&op->counted);
+		stat->cycles = counted ? (double)op->counters[0] / (double)counted : 0;
+		stat->cache_misses = counted ? (double)op->counters[1] / (double)counted : 0;
+		stat->branch_misses = counted ? (double)op->counters[2] / (double)counted : 0;
+	}
+	return num_ops;
+}
+
+void ds_profile_report(FILE *file) {
+	int64_t num_ops = ds_profile_snapshot(NULL, 0);
+	ds_profile_stats_t *stats = malloc((size_t)MAX(num_ops, 1) * sizeof(ds_profile_stats_t));
+	if (!stats) return;
+	num_ops = MIN(ds_profile_snapshot(stats, num_ops), num_ops);
+	fprintf(file, "%-32s %12s %10s %10s %10s %10s %10s %10s %10s\n", "function", "calls", "p50 ns",
+		"p99 ns", "p999 ns", "max ns", "cycles", "cache miss", "branch miss");
+	for (int64_t i = 0; i < num_ops; i++) {
+		if (!stats[i].count) continue;
+		fprintf(file, "%-32s %12lld %10lld %10lld %10lld %10lld %10.0f %10.1f %10.1f\n", stats[i].name,
+			(long long)stats[i].count, (long long)stats[i].p50, (long long)stats[i].p99, (long long)stats[i].p999,
+			(long long)stats[i].max, stats[i].cycles, stats[i].cache_misses, stats[i].branch_misses);
+	}
+	free(stats);
+}
+
+void ds_profile_reset(void) {
+	for (profile_op_t *op = ds_atomic_load_ptr(&profile_ops); op; op = op->next) {
+		ds_atomic_store(&op->count, 0);
+		ds_atomic_store(&op->counted, 0);
+		for (int i = 0; i < PROFILE_NUM_COUNTERS; i++) {
+			ds_atomic_store(&op->counters[i], 0);
+		}
+		for (int64_t bucket = 0; bucket < PROFILE_NUM_BUCKETS; bucket++) {
+			ds_atomic_store(&op->buckets[bucket], 0);
+		}
+	}
+}
+
+/* ----------------------------- Bloom filter ----------------------------- */
+
+/* Number of 64-bit words in a block of a Bloom filter, one cache line */
+#define BLOOM_BLOCK_WORDS 8
+
+/* Number of bits in a block of a Bloom filter */
+#define BLOOM_BLOCK_BITS (BLOOM_BLOCK_WORDS * 64)
+
+/* Odd multipliers deriving the bit set in each word of a block from a hash */
+static const uint32_t bloom_salts[BLOOM_BLOCK_WORDS] = {
+	0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+	0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+/** Return the hash of `value` in `bloom`, mixed so that weak hash functions
+ * such as the identity still spread over all blocks. */
+static uint64_t bloom_hash(const bloom_t *bloom, const void *value) {
+	return ds_mix64(bloom->hash_func(value));
+}
+
+/** Return the block of `bloom` selected by `hash`. */
+static uint64_t *bloom_block(const bloom_t *bloom, uint64_t hash) {
+	return bloom->blocks + ((hash >> 32) * (uint64_t)bloom->num_blocks >> 32) * BLOOM_BLOCK_WORDS;
+}
+
+bloom_t *bloom_new(int64_t capacity, int64_t bits_per_elem, hash_func_t hash_func) {
+	bloom_t *bloom = malloc(sizeof(bloom_t));
+	if (!bloom) return NULL;
+	bloom->num_blocks = MAX((capacity * bits_per_elem + BLOOM_BLOCK_BITS - 1) / BLOOM_BLOCK_BITS, 1);
+	size_t size = (size_t)bloom->num_blocks * BLOOM_BLOCK_WORDS * sizeof(uint64_t);
+#ifdef _WIN32
+	bloom->blocks = _aligned_malloc(size, CACHE_LINE_SIZE);
+#else
+	if (posix_memalign((void **)&bloom->blocks, CACHE_LINE_SIZE, size)) bloom->blocks = NULL;
+#endif
+	if (!bloom->blocks) {
+		free(bloom);
+		return NULL;
+	}
+	bloom->capacity = capacity;
+	bloom->bits_per_elem = bits_per_elem;
+	bloom->hash_func = hash_func;
+	bloom_clear(bloom);
+	return bloom;
+}
+
+void bloom_free(bloom_t *bloom) {
+#ifdef _WIN32
+	_aligned_free(bloom->blocks);
+#else
+	free(bloom->blocks);
+#endif
+	free(bloom);
+}
+
+void bloom_add(bloom_t *bloom, const void *value) {
+	uint64_t hash = bloom_hash(bloom, value);
+	uint64_t *block = bloom_block(bloom, hash);
+	for (int i = 0; i < BLOOM_BLOCK_WORDS; i++) {
+		block[i] |= (uint64_t)1 << ((uint32_t)hash * bloom_salts[i] >> 26);
+	}
+	bloom->count++;
+}
+
+bool bloom_may_contain(const bloom_t *bloom, const void *value) {
+	uint64_t hash = bloom_hash(bloom, value);
+	const uint64_t *block = bloom_block(bloom, hash);
+	uint64_t missing = 0;
+	for (int i = 0; i < BLOOM_BLOCK_WORDS; i++) {
+		missing |= ~block[i] & (uint64_t)1 << ((uint32_t)hash * bloom_salts[i] >> 26);
+	}
+	return !missing;
+}
+
+void bloom_clear(bloom_t *bloom) {
+	memset(bloom->blocks, 0, (size_t)bloom->num_blocks * BLOOM_BLOCK_WORDS * sizeof(uint64_t));
+	bloom->count = 0;
+}
+
 /* -------------------------- variable size array -------------------------- */
 
 /* Growth/shrink factor for arraylist */
@@ -19,30 +700,148 @@
 /* Initial physical length of array */
 #define ARRAYLIST_INIT_LEN 5
 
+/* Size, in bytes, of a huge page. Contents of arraylists created with
+   `huge_pages` that need at least this many bytes are mapped directly and
+   advised to be backed by huge pages. */
+#define ARRAYLIST_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+/* Number of bits per element of the Bloom filter attached to an arraylist */
+#define ARRAYLIST_BLOOM_BITS_PER_ELEM 12
+
+/* Minimum capacity of the Bloom filter attached to an arraylist */
+#define ARRAYLIST_BLOOM_MIN_CAPACITY 64
+
+/* The Bloom filter attached to an arraylist is rebuilt when its capacity
+   exceeds this many times the length of the arraylist */
+#define ARRAYLIST_BLOOM_SHRINK_THRESHOLD 4
+
 /* Pointer to item at index `index` in `arraylist`. No bounds checking is done.
    Negative indices are not supported. */
 #define ARRAYLIST_GET_UNCHECKED(arraylist, index) \
 	((arraylist)->contents + (index) * (int64_t)(arraylist)->elem_size)
 
+/** Return whether contents of `arraylist` with physical length `phys_len` are
+ * mapped with mmap rather than allocated from the heap. */
+static bool contents_is_mapped(const arraylist_t *arraylist, int64_t phys_len) {
+#ifdef __linux__
+	return arraylist->huge_pages && (size_t)phys_len * arraylist->elem_size >= ARRAYLIST_HUGE_PAGE_SIZE;
+#else
+	(void)arraylist;
+	(void)phys_len;
+	return false;
+#endif
+}
+
+#ifdef __linux__
+/** Return the size of the mapping holding contents with physical length
+ * `phys_len`, a multiple of the huge page size. */
+static size_t contents_mapped_size(const arraylist_t *arraylist, int64_t phys_len) {
+	size_t size = (size_t)phys_len * arraylist->elem_size;
+	return (size + ARRAYLIST_HUGE_PAGE_SIZE - 1) / ARRAYLIST_HUGE_PAGE_SIZE * ARRAYLIST_HUGE_PAGE_SIZE;
+}
+#endif
+
+/** Allocate contents able to hold `phys_len` elements, honoring the alignment
+ * and huge page options of `arraylist`. Return NULL if there is insufficient
+ * memory. */
+static int8_t *contents_alloc(const arraylist_t *arraylist, int64_t phys_len) {
+	size_t size = (size_t)phys_len * arraylist->elem_size;
+#ifdef __linux__
+	if (contents_is_mapped(arraylist, phys_len)) {
+		void *contents = mmap(NULL, contents_mapped_size(arraylist, phys_len), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (contents == MAP_FAILED) return NULL;
+#ifdef MADV_HUGEPAGE
+		madvise(contents, contents_mapped_size(arraylist, phys_len), MADV_HUGEPAGE);
+#endif
+		return contents;
+	}
+#endif
+	if (!arraylist->alignment) return malloc(size);
+#ifdef _WIN32
+	return _aligned_malloc(size, arraylist->alignment);
+#else
+	void *contents;
+	if (posix_memalign(&contents, MAX(arraylist->alignment, sizeof(void *)), size)) return NULL;
+	return contents;
+#endif
+}
+
+/** Free `contents` of `arraylist` with physical length `phys_len`. */
+static void contents_free(const arraylist_t *arraylist, int8_t *contents, int64_t phys_len) {
+#ifdef __linux__
+	if (contents_is_mapped(arraylist, phys_len)) {
+		munmap(contents, contents_mapped_size(arraylist, phys_len));
+		return;
+	}
+#endif
+#ifdef _WIN32
+	if (arraylist->alignment) {
+		_aligned_free(contents);
+		return;
+	}
+#else
+	(void)phys_len;
+#endif
+	free(contents);
+}
+
+/** Resize the contents of `arraylist` to hold `phys_len` elements, keeping its
+ * first min(len, `phys_len`) elements and its alignment and huge page options.
+ * Return the new contents, or NULL if there is insufficient memory, in which
+ * case the old contents are unchanged. Does not modify `arraylist`. */
+static int8_t *contents_realloc(const arraylist_t *arraylist, int64_t phys_len) {
+	bool mapped = contents_is_mapped(arraylist, arraylist->phys_len);
+	bool mapped_new = contents_is_mapped(arraylist, phys_len);
+	if (!mapped && !mapped_new) {
+		if (!arraylist->alignment) return realloc(arraylist->contents, (size_t)phys_len * arraylist->elem_size);
+#ifdef _WIN32
+		return _aligned_realloc(arraylist->contents, (size_t)phys_len * arraylist->elem_size, arraylist->alignment);
+#endif
+	}
+#ifdef __linux__
+	if (mapped && mapped_new) {
+		void *contents = mremap(arraylist->contents, contents_mapped_size(arraylist, arraylist->phys_len),
+			contents_mapped_size(arraylist, phys_len), MREMAP_MAYMOVE);
+		return contents == MAP_FAILED ? NULL : contents;
+	}
+#endif
+	int8_t *contents = contents_alloc(arraylist, phys_len);
+	if (!contents) return NULL;
+	memcpy(contents, arraylist->contents, (size_t)MIN(arraylist->len, phys_len) * arraylist->elem_size);
+	contents_free(arraylist, arraylist->contents, arraylist->phys_len);
+	return contents;
+}
+
 arraylist_t *arraylist_new(size_t elem_size, cmp_func_t cmp_func) {
+	PROFILE_FUNCTION();
+	return arraylist_new_aligned(elem_size, cmp_func, 0, false);
+}
+
+arraylist_t *arraylist_new_aligned(size_t elem_size, cmp_func_t cmp_func, size_t alignment, bool huge_pages) {
+	PROFILE_FUNCTION();
 	arraylist_t *new_arraylist = malloc(sizeof(arraylist_t));
 	if (!new_arraylist) return NULL;
-	if ((new_arraylist->contents = malloc(ARRAYLIST_INIT_LEN * elem_size)) != NULL) {
+	new_arraylist->elem_size = elem_size;
+	new_arraylist->alignment = alignment;
+	new_arraylist->huge_pages = huge_pages;
+	if ((new_arraylist->contents = contents_alloc(new_arraylist, ARRAYLIST_INIT_LEN)) != NULL) {
 		new_arraylist->phys_len = ARRAYLIST_INIT_LEN;
-	} else if ((new_arraylist->contents = malloc(elem_size)) != NULL) {
+	} else if ((new_arraylist->contents = contents_alloc(new_arraylist, 1)) != NULL) {
 		new_arraylist->phys_len = 1;
 	} else {
 		free(new_arraylist);
 		return NULL;
 	}
 	new_arraylist->len = 0;
-	new_arraylist->elem_size = elem_size;
 	new_arraylist->end = new_arraylist->contents;
 	new_arraylist->cmp_func = cmp_func;
+	new_arraylist->refcount = NULL;
+	new_arraylist->bloom = NULL;
 	return new_arraylist;
 }
 
 arraylist_t *arraylist_from_array(const void *array, int64_t array_len, size_t elem_size, cmp_func_t cmp_func) {
+	PROFILE_FUNCTION();
 	if (array_len == 0) return arraylist_new(elem_size, cmp_func);
 	arraylist_t *new_arraylist = malloc(sizeof(arraylist_t));
 	if (!new_arraylist) return NULL;
@@ -53,36 +852,123 @@ arraylist_t *arraylist_from_array(const void *array, int64_t array_len, size_t e
 	new_arraylist->len = array_len;
 	new_arraylist->phys_len = array_len;
 	new_arraylist->elem_size = elem_size;
+	new_arraylist->alignment = 0;
+	new_arraylist->huge_pages = false;
 	memcpy(new_arraylist->contents, array, (size_t)array_len * elem_size);
 	new_arraylist->end = ARRAYLIST_GET_UNCHECKED(new_arraylist, array_len);
 	new_arraylist->cmp_func = cmp_func;
+	new_arraylist->refcount = NULL;
+	new_arraylist->bloom = NULL;
 	return new_arraylist;
 }
 
+/** Give up the reference of `arraylist` to its contents without modifying
+ * `arraylist`. The contents are freed if no other arraylist shares them. */
+static void arraylist_release_contents(arraylist_t *arraylist) {
+	if (arraylist->refcount) {
+		if (ds_atomic_fetch_add(arraylist->refcount, -1) > 1) return;
+		free((void *)arraylist->refcount);
+	}
+	contents_free(arraylist, arraylist->contents, arraylist->phys_len);
+}
+
+/** If the contents of `arraylist` are shared with copy-on-write copies, give
+ * `arraylist` its own copy of the contents so that it can be modified. Return
+ * false if there is insufficient memory, in which case `arraylist` is
+ * unchanged. */
+static bool arraylist_unshare(arraylist_t *arraylist) {
+	if (!arraylist->refcount) return true;
+	if (ds_atomic_load(arraylist->refcount) > 1) {
+		int8_t *contents = contents_alloc(arraylist, arraylist->phys_len);
+		if (!contents) return false;
+		memcpy(contents, arraylist->contents, (size_t)arraylist->len * arraylist->elem_size);
+		arraylist_release_contents(arraylist);
+		arraylist->contents = contents;
+		arraylist->end = ARRAYLIST_GET_UNCHECKED(arraylist, arraylist->len);
+	} else {
+		// the other copies have been freed
+		free((void *)arraylist->refcount);
+	}
+	arraylist->refcount = NULL;
+	return true;
+}
+
+/** Replace the Bloom filter of `arraylist` with one sized for twice its length
+ * holding its current elements. If there is insufficient memory, detach the
+ * filter so that lookups fall back to scanning. */
+static void arraylist_bloom_rebuild(arraylist_t *arraylist) {
+	bloom_t *bloom = bloom_new(MAX(2 * arraylist->len, ARRAYLIST_BLOOM_MIN_CAPACITY),
+		ARRAYLIST_BLOOM_BITS_PER_ELEM, arraylist->bloom->hash_func);
+	bloom_free(arraylist->bloom);
+	arraylist->bloom = bloom;
+	if (!bloom) return;
+	for (int8_t *value = arraylist->contents; value < arraylist->end; value += arraylist->elem_size) {
+		bloom_add(bloom, value);
+	}
+}
+
+/** Record in the Bloom filter of `arraylist`, if any, that `value` was just
+ * stored in the arraylist. */
+static void arraylist_bloom_add(arraylist_t *arraylist, const void *value) {
+	if (!arraylist->bloom) return;
+	if (arraylist->bloom->count < arraylist->bloom->capacity) bloom_add(arraylist->bloom, value);
+	else arraylist_bloom_rebuild(arraylist);
+}
+
+/** Rebuild the Bloom filter of `arraylist`, if any, after elements were
+ * removed, if the arraylist has shrunk to a fraction of its capacity. Removed
+ * elements otherwise stay in the filter, which only costs false positives. */
+static void arraylist_bloom_shrink(arraylist_t *arraylist) {
+	if (arraylist->bloom && arraylist->bloom->capacity >
+		ARRAYLIST_BLOOM_SHRINK_THRESHOLD * MAX(arraylist->len, ARRAYLIST_BLOOM_MIN_CAPACITY)) {
+		arraylist_bloom_rebuild(arraylist);
+	}
+}
+
+/** Rebuild the Bloom filter of `arraylist`, if any, after its elements may
+ * have been modified in place. */
+static void arraylist_bloom_invalidate(arraylist_t *arraylist) {
+	if (arraylist->bloom) arraylist_bloom_rebuild(arraylist);
+}
+
+/** Return whether the Bloom filter of `arraylist` shows that `value` is not in
+ * the arraylist. */
+static bool arraylist_bloom_excludes(const arraylist_t *arraylist, const void *value) {
+	return arraylist->bloom && !bloom_may_contain(arraylist->bloom, value);
+}
+
 void arraylist_free(arraylist_t *arraylist) {
-	free(arraylist->contents);
+	PROFILE_FUNCTION();
+	arraylist_detach_bloom(arraylist);
+	arraylist_release_contents(arraylist);
 	free(arraylist);
 }
 
 int64_t arraylist_len(const arraylist_t *arraylist) {
+	PROFILE_FUNCTION();
 	return arraylist->len;
 }
 
 void *arraylist_set(arraylist_t *arraylist, int64_t index, const void *value) {
+	PROFILE_FUNCTION();
 	if (index < -arraylist->len || index >= arraylist->len) return NULL;
 	if (index < 0) index += arraylist->len;
+	if (!arraylist_unshare(arraylist)) return NULL;
 	int8_t *elem_location = ARRAYLIST_GET_UNCHECKED(arraylist, index);
 	memmove(elem_location, value, arraylist->elem_size);
+	arraylist_bloom_add(arraylist, elem_location);
 	return elem_location;
 }
 
 void *arraylist_get(const arraylist_t *arraylist, int64_t index) {
+	PROFILE_FUNCTION();
 	if (index < -arraylist->len || index >= arraylist->len) return NULL;
 	if (index < 0) index += arraylist->len;
 	return ARRAYLIST_GET_UNCHECKED(arraylist, index);
 }
 
 void *arraylist_get_copy(const arraylist_t *arraylist, int64_t index, void *dest) {
+	PROFILE_FUNCTION();
 	void *ptr = arraylist_get(arraylist, index);
 	if (ptr) memmove(dest, ptr, arraylist->elem_size);
 	return ptr;
@@ -97,11 +983,12 @@ void *arraylist_get_copy(const arraylist_t *arraylist, int64_t index, void *dest
 static bool arraylist_grow(arraylist_t *arraylist) {
 	if (arraylist->phys_len != arraylist->len) return true;
 	int64_t phys_len_new = MAX(ARRAYLIST_GROWTH_FACTOR * arraylist->phys_len, arraylist->phys_len + 1);
-	int8_t *contents_new = realloc(arraylist->contents, (size_t)phys_len_new * arraylist->elem_size);
+	int8_t *contents_new = contents_realloc(arraylist, phys_len_new);
 	if (contents_new) {
 		arraylist->phys_len = phys_len_new;
 		arraylist->contents = contents_new;
-	} else if ((contents_new = realloc(arraylist->contents, (size_t)(++arraylist->phys_len) * arraylist->elem_size)) != NULL) {
+	} else if ((contents_new = contents_realloc(arraylist, arraylist->phys_len + 1)) != NULL) {
+		arraylist->phys_len++;
 		arraylist->contents = contents_new;
 	} else {
 		return false;
@@ -118,7 +1005,7 @@ static void arraylist_shrink(arraylist_t *arraylist) {
 	if (arraylist->phys_len / ARRAYLIST_GROWTH_FACTOR >= ARRAYLIST_INIT_LEN &&
 		arraylist->len <= arraylist->phys_len / ARRAYLIST_SHRINK_THRESHOLD) {
 		int64_t new_phys_len = arraylist->phys_len / ARRAYLIST_GROWTH_FACTOR;
-		int8_t *new_contents = realloc(arraylist->contents, (size_t)new_phys_len * arraylist->elem_size);
+		int8_t *new_contents = contents_realloc(arraylist, new_phys_len);
 		if (new_contents) {
 			arraylist->phys_len = new_phys_len;
 			arraylist->contents = new_contents;
@@ -127,16 +1014,49 @@ static void arraylist_shrink(arraylist_t *arraylist) {
 	}
 }
 
+/** Shrink the physical length of `arraylist` with a single reallocation to
+ * what repeated calls to arraylist_shrink would leave, for use after removing
+ * many elements at once. */
+static void arraylist_shrink_all(arraylist_t *arraylist) {
+	int64_t new_phys_len = arraylist->phys_len;
+	while (new_phys_len / ARRAYLIST_GROWTH_FACTOR >= ARRAYLIST_INIT_LEN &&
+		arraylist->len <= new_phys_len / ARRAYLIST_SHRINK_THRESHOLD) {
+		new_phys_len /= ARRAYLIST_GROWTH_FACTOR;
+	}
+	if (new_phys_len == arraylist->phys_len) return;
+	int8_t *new_contents = contents_realloc(arraylist, new_phys_len);
+	if (new_contents) {
+		arraylist->phys_len = new_phys_len;
+		arraylist->contents = new_contents;
+		arraylist->end = ARRAYLIST_GET_UNCHECKED(arraylist, arraylist->len);
+	}
+}
+
+/** Ensure the physical length of `arraylist` is at least `phys_len`, leaving
+ * the virtual length unchanged. Return false if there is insufficient memory. */
+static bool arraylist_reserve(arraylist_t *arraylist, int64_t phys_len) {
+	if (arraylist->phys_len >= phys_len) return true;
+	int8_t *contents_new = contents_realloc(arraylist, phys_len);
+	if (!contents_new) return false;
+	arraylist->phys_len = phys_len;
+	arraylist->contents = contents_new;
+	arraylist->end = ARRAYLIST_GET_UNCHECKED(arraylist, arraylist->len);
+	return true;
+}
+
 void *arraylist_append(arraylist_t *arraylist, const void *value) {
-	if (!arraylist_grow(arraylist)) return NULL;
+	PROFILE_FUNCTION();
+	if (!arraylist_unshare(arraylist) || !arraylist_grow(arraylist)) return NULL;
 	memmove(arraylist->end, value, arraylist->elem_size);
 	arraylist->len++;
 	void *old_end = arraylist->end;
 	arraylist->end += arraylist->elem_size;
+	arraylist_bloom_add(arraylist, old_end);
 	return old_end;
 }
 
 int64_t arraylist_extend(arraylist_t *dest, const arraylist_t *source) {
+	PROFILE_FUNCTION();
 	int64_t num_appended = 0;
 	for (int8_t *value = source->contents; value < source->end; value += source->elem_size) {
 		if (arraylist_append(dest, value)) num_appended++;
@@ -146,61 +1066,196 @@ int64_t arraylist_extend(arraylist_t *dest, const arraylist_t *source) {
 }
 
 void *arraylist_insert(arraylist_t *arraylist, int64_t index, const void *value) {
+	PROFILE_FUNCTION();
 	if (index < -arraylist->len) index = 0;
 	else if (index < 0) index += arraylist->len;
 	else if (index > arraylist->len) index = arraylist->len;
-	if (!arraylist_grow(arraylist)) return NULL;
+	if (!arraylist_unshare(arraylist) || !arraylist_grow(arraylist)) return NULL;
 	memmove(ARRAYLIST_GET_UNCHECKED(arraylist, index + 1),
 		ARRAYLIST_GET_UNCHECKED(arraylist, index),
 		(size_t)(arraylist->len - index) * arraylist->elem_size);
 	memmove(ARRAYLIST_GET_UNCHECKED(arraylist, index), value, arraylist->elem_size);
 	arraylist->len++;
 	arraylist->end += arraylist->elem_size;
+	arraylist_bloom_add(arraylist, ARRAYLIST_GET_UNCHECKED(arraylist, index));
 	return ARRAYLIST_GET_UNCHECKED(arraylist, index);
 }
 
-bool arraylist_contains(const arraylist_t *arraylist, const void *value) {
-	for (int8_t *current = arraylist->contents; current < arraylist->end; current += arraylist->elem_size) {
-		if (!arraylist->cmp_func(current, value)) {
-			return true;
-		}
+bool arraylist_attach_bloom(arraylist_t *arraylist, hash_func_t hash_func) {
+	PROFILE_FUNCTION();
+	bloom_t *bloom = bloom_new(MAX(2 * arraylist->len, ARRAYLIST_BLOOM_MIN_CAPACITY),
+		ARRAYLIST_BLOOM_BITS_PER_ELEM, hash_func);
+	if (!bloom) return false;
+	for (int8_t *value = arraylist->contents; value < arraylist->end; value += arraylist->elem_size) {
+		bloom_add(bloom, value);
+	}
+	arraylist_detach_bloom(arraylist);
+	arraylist->bloom = bloom;
+	return true;
+}
+
+void arraylist_detach_bloom(arraylist_t *arraylist) {
+	PROFILE_FUNCTION();
+	if (arraylist->bloom) bloom_free(arraylist->bloom);
+	arraylist->bloom = NULL;
+}
+
+bool arraylist_contains(const arraylist_t *arraylist, const void *value) {
+	PROFILE_FUNCTION();
+	if (arraylist_bloom_excludes(arraylist, value)) return false;
+	for (int8_t *current = arraylist->contents; current < arraylist->end; current += arraylist->elem_size) {
+		if (!arraylist->cmp_func(current, value)) {
+			return true;
+		}
 	}
 	return false;
 }
 
 bool arraylist_remove(arraylist_t *arraylist, const void *value) {
+	PROFILE_FUNCTION();
+	if (arraylist_bloom_excludes(arraylist, value)) return false;
 	for (int8_t *current = arraylist->contents; current < arraylist->end; current += arraylist->elem_size) {
 		if (!arraylist->cmp_func(current, value)) {
+			int64_t offset = current - arraylist->contents;
+			if (!arraylist_unshare(arraylist)) return false;
+			current = arraylist->contents + offset;
 			memmove(current, current + arraylist->elem_size,
 				(size_t)(arraylist->end - current) - arraylist->elem_size);
 			arraylist->len--;
 			arraylist->end -= arraylist->elem_size;
 			arraylist_shrink(arraylist);
+			arraylist_bloom_shrink(arraylist);
 			return true;
 		}
 	}
 	return false;
 }
 
+/** Swap the `size` bytes at `a` and `b`, which must not overlap. */
+static void swap_bytes(void *a, void *b, size_t size) {
+	int8_t buffer[64];
+	for (int8_t *x = a, *y = b; size; ) {
+		size_t n = MIN(size, sizeof(buffer));
+		memcpy(buffer, x, n);
+		memcpy(x, y, n);
+		memcpy(y, buffer, n);
+		x += n;
+		y += n;
+		size -= n;
+	}
+}
+
+int64_t arraylist_remove_if(arraylist_t *arraylist, bool(*pred)(const void*, void*), void *ctx) {
+	PROFILE_FUNCTION();
+	// find the first element to remove before unsharing
+	int8_t *current = arraylist->contents;
+	while (current < arraylist->end && !pred(current, ctx)) {
+		current += arraylist->elem_size;
+	}
+	if (current == arraylist->end) return 0;
+	int64_t offset = current - arraylist->contents;
+	if (!arraylist_unshare(arraylist)) return 0;
+	// compact the kept elements in one pass
+	int8_t *kept = arraylist->contents + offset;
+	for (current = kept + arraylist->elem_size; current < arraylist->end; current += arraylist->elem_size) {
+		if (!pred(current, ctx)) {
+			memcpy(kept, current, arraylist->elem_size);
+			kept += arraylist->elem_size;
+		}
+	}
+	int64_t num_removed = (arraylist->end - kept) / (int64_t)arraylist->elem_size;
+	arraylist->len -= num_removed;
+	arraylist->end = kept;
+	arraylist_shrink_all(arraylist);
+	arraylist_bloom_shrink(arraylist);
+	return num_removed;
+}
+
+/** Context of remove_all_pred */
+typedef struct {
+	const arraylist_t *arraylist;	// arraylist whose comparison function is used
+	const void *value;				// value to remove
+} remove_all_ctx_t;
+
+/** Return whether `value` is equal to the value to remove of `ctx`, a
+ * remove_all_ctx_t. */
+static bool remove_all_pred(const void *value, void *ctx) {
+	remove_all_ctx_t *remove_all_ctx = ctx;
+	return !remove_all_ctx->arraylist->cmp_func(value, remove_all_ctx->value);
+}
+
+int64_t arraylist_remove_all(arraylist_t *arraylist, const void *value) {
+	PROFILE_FUNCTION();
+	if (arraylist_bloom_excludes(arraylist, value)) return 0;
+	remove_all_ctx_t ctx = { arraylist, value };
+	return arraylist_remove_if(arraylist, remove_all_pred, &ctx);
+}
+
+int64_t arraylist_partition(arraylist_t *arraylist, bool(*pred)(const void*, void*), void *ctx) {
+	PROFILE_FUNCTION();
+	if (!arraylist->len) return 0;
+	if (!arraylist_unshare(arraylist)) return -1;
+	int8_t *a = arraylist->contents, *b = arraylist->end;
+	for (;;) {
+		while (a < b && pred(a, ctx)) a += arraylist->elem_size;
+		do b -= arraylist->elem_size; while (a < b && !pred(b, ctx));
+		if (a >= b) break;
+		swap_bytes(a, b, arraylist->elem_size);
+		a += arraylist->elem_size;
+	}
+	return (a - arraylist->contents) / (int64_t)arraylist->elem_size;
+}
+
+int64_t arraylist_stable_partition(arraylist_t *arraylist, bool(*pred)(const void*, void*), void *ctx) {
+	PROFILE_FUNCTION();
+	if (!arraylist_unshare(arraylist)) return -1;
+	int8_t *rejected = malloc((size_t)MAX(arraylist->len, 1) * arraylist->elem_size);
+	if (!rejected) return -1;
+	// compact the matching elements in place and set the others aside
+	int8_t *kept = arraylist->contents, *rejected_end = rejected;
+	for (int8_t *current = arraylist->contents; current < arraylist->end; current += arraylist->elem_size) {
+		if (pred(current, ctx)) {
+			if (kept != current) memcpy(kept, current, arraylist->elem_size);
+			kept += arraylist->elem_size;
+		} else {
+			memcpy(rejected_end, current, arraylist->elem_size);
+			rejected_end += arraylist->elem_size;
+		}
+	}
+	memcpy(kept, rejected, (size_t)(rejected_end - rejected));
+	free(rejected);
+	return (kept - arraylist->contents) / (int64_t)arraylist->elem_size;
+}
+
 bool arraylist_delete(arraylist_t *arraylist, int64_t index) {
+	PROFILE_FUNCTION();
 	if (index < -arraylist->len || index >= arraylist->len) return false;
 	if (index < 0) index += arraylist->len;
+	if (!arraylist_unshare(arraylist)) return false;
 	memmove(ARRAYLIST_GET_UNCHECKED(arraylist, index),
 		ARRAYLIST_GET_UNCHECKED(arraylist, index + 1),
 		(size_t)(arraylist->len - index - 1) * arraylist->elem_size);
 	arraylist->len--;
 	arraylist->end -= arraylist->elem_size;
 	arraylist_shrink(arraylist);
+	arraylist_bloom_shrink(arraylist);
 	return true;
 }
 
+/** Normalize slice indices `*start` and `*end` of a sequence of length `len`
+ * as described for arraylist_slice. */
+static void normalize_slice(int64_t len, int64_t *start, int64_t *end) {
+	if (*start < -len) *start = 0;
+	else if (*start < 0) *start += len;
+	else if (*start >= len) *start = len;
+	if (*end < -len) *end = 0;
+	else if (*end < 0) *end += len;
+	else if (*end >= len) *end = len;
+}
+
 arraylist_t *arraylist_slice(arraylist_t *arraylist, int64_t start, int64_t end) {
-	if (start < -arraylist->len) start = 0;
-	else if (start < 0) start += arraylist->len;
-	else if (start >= arraylist->len) start = arraylist->len;
-	if (end < -arraylist->len) end = 0;
-	else if (end < 0) end += arraylist->len;
-	else if (end >= arraylist->len) end = arraylist->len;
+	PROFILE_FUNCTION();
+	normalize_slice(arraylist->len, &start, &end);
 	if (start >= end) {
 		return arraylist_new(arraylist->elem_size, arraylist->cmp_func);
 	}
@@ -209,18 +1264,34 @@ arraylist_t *arraylist_slice(arraylist_t *arraylist, int64_t start, int64_t end)
 }
 
 bool arraylist_pop(arraylist_t *arraylist, int64_t index, void *dest) {
+	PROFILE_FUNCTION();
 	if (!arraylist_get_copy(arraylist, index, dest)) return false;
 	return arraylist_delete(arraylist, index);
 }
 
 void arraylist_clear(arraylist_t *arraylist) {
+	PROFILE_FUNCTION();
 	arraylist->len = 0;
-	int8_t *contents_new = realloc(arraylist->contents, ARRAYLIST_INIT_LEN * arraylist->elem_size);
+	arraylist->end = arraylist->contents;
+	arraylist_bloom_invalidate(arraylist);
+	if (arraylist->refcount) {
+		// leave the shared contents to the other copies
+		int64_t phys_len = ARRAYLIST_INIT_LEN;
+		int8_t *contents_new = contents_alloc(arraylist, phys_len);
+		if (!contents_new && (contents_new = contents_alloc(arraylist, phys_len = 1)) == NULL) return;
+		arraylist_release_contents(arraylist);
+		arraylist->refcount = NULL;
+		arraylist->phys_len = phys_len;
+		arraylist->contents = contents_new;
+		arraylist->end = arraylist->contents;
+		return;
+	}
+	int8_t *contents_new = contents_realloc(arraylist, ARRAYLIST_INIT_LEN);
 	if (contents_new) {
 		arraylist->phys_len = ARRAYLIST_INIT_LEN;
 		arraylist->contents = contents_new;
 		arraylist->end = arraylist->contents;
-	} else if ((contents_new = realloc(arraylist->contents, arraylist->elem_size)) != NULL) {
+	} else if ((contents_new = contents_realloc(arraylist, 1)) != NULL) {
 		arraylist->phys_len = 1;
 		arraylist->contents = contents_new;
 		arraylist->end = arraylist->contents;
@@ -228,6 +1299,8 @@ void arraylist_clear(arraylist_t *arraylist) {
 }
 
 int64_t arraylist_find(const arraylist_t *arraylist, const void *value) {
+	PROFILE_FUNCTION();
+	if (arraylist_bloom_excludes(arraylist, value)) return -1;
 	int64_t i = 0;
 	for (int8_t *current = arraylist->contents; current < arraylist->end; current += arraylist->elem_size, i++) {
 		if (!arraylist->cmp_func(current, value)) {
@@ -238,6 +1311,8 @@ int64_t arraylist_find(const arraylist_t *arraylist, const void *value) {
 }
 
 int64_t arraylist_rfind(const arraylist_t *arraylist, const void *value) {
+	PROFILE_FUNCTION();
+	if (arraylist_bloom_excludes(arraylist, value)) return -1;
 	int64_t i = arraylist->len - 1;
 	for (int8_t *current = arraylist->end - arraylist->elem_size; current >= arraylist->contents; current -= arraylist->elem_size, i--) {
 		if (!arraylist->cmp_func(current, value)) {
@@ -248,6 +1323,8 @@ int64_t arraylist_rfind(const arraylist_t *arraylist, const void *value) {
 }
 
 int64_t arraylist_count(const arraylist_t *arraylist, const void *value) {
+	PROFILE_FUNCTION();
+	if (arraylist_bloom_excludes(arraylist, value)) return 0;
 	int64_t count = 0;
 	for (int8_t *current = arraylist->contents; current < arraylist->end; current += arraylist->elem_size) {
 		if (!arraylist->cmp_func(current, value)) {
@@ -257,18 +1334,509 @@ int64_t arraylist_count(const arraylist_t *arraylist, const void *value) {
 	return count;
 }
 
+void arraylist_reverse(arraylist_t *arraylist, void *temp) {
+	PROFILE_FUNCTION();
+	if (!arraylist_unshare(arraylist)) return;
+	int8_t *a = arraylist->contents;
+	int8_t *b = ARRAYLIST_GET_UNCHECKED(arraylist, arraylist->len - 1);
+	while (a < b) {
+		memcpy(temp, a, arraylist->elem_size);
+		memcpy(a, b, arraylist->elem_size);
+		memcpy(b, temp, arraylist->elem_size);
+		a += arraylist->elem_size;
+		b -= arraylist->elem_size;
+	}
+}
+
+/* Pointer to the element at index `index` of the raw array `base` of elements
+   of size `elem_size` */
+#define ELEM_AT(base, elem_size, index) ((base) + (index) * (int64_t)(elem_size))
+
+/** Return whether `a` belongs above `b` in a heap ordered by `cmp_func`, which
+ * is a max-heap if `max` is true and a min-heap otherwise. */
+static bool heap_above(cmp_func_t cmp_func, const void *a, const void *b, bool max) {
+	int64_t cmp = cmp_func(a, b);
+	return max ? cmp > 0 : cmp < 0;
+}
+
+/** Move the element at index `root` of the heap made of the `len` elements of
+ * size `elem_size` at `base` down to its place. */
+static void heap_sift_down(int8_t *base, size_t elem_size, cmp_func_t cmp_func, int64_t len, int64_t root, bool max) {
+	for (;;) {
+		int64_t child = 2 * root + 1;
+		if (child >= len) return;
+		if (child + 1 < len && heap_above(cmp_func, ELEM_AT(base, elem_size, child + 1), ELEM_AT(base, elem_size, child), max)) {
+			child++;
+		}
+		if (!heap_above(cmp_func, ELEM_AT(base, elem_size, child), ELEM_AT(base, elem_size, root), max)) return;
+		swap_bytes(ELEM_AT(base, elem_size, root), ELEM_AT(base, elem_size, child), elem_size);
+		root = child;
+	}
+}
+
+/** Move the element at index `index` of the heap at `base` up to its place. */
+static void heap_sift_up(int8_t *base, size_t elem_size, cmp_func_t cmp_func, int64_t index, bool max) {
+	while (index > 0) {
+		int64_t parent = (index - 1) / 2;
+		if (!heap_above(cmp_func, ELEM_AT(base, elem_size, index), ELEM_AT(base, elem_size, parent), max)) return;
+		swap_bytes(ELEM_AT(base, elem_size, index), ELEM_AT(base, elem_size, parent), elem_size);
+		index = parent;
+	}
+}
+
+/** Arrange the `len` elements at `base` into a heap. */
+static void heap_make(int8_t *base, size_t elem_size, cmp_func_t cmp_func, int64_t len, bool max) {
+	for (int64_t root = len / 2 - 1; root >= 0; root--) {
+		heap_sift_down(base, elem_size, cmp_func, len, root, max);
+	}
+}
+
+/** Sort the heap made of the `len` elements at `base`, in ascending order for a
+ * max-heap and in descending order for a min-heap. */
+static void heap_sort(int8_t *base, size_t elem_size, cmp_func_t cmp_func, int64_t len, bool max) {
+	for (int64_t last = len - 1; last > 0; last--) {
+		swap_bytes(base, ELEM_AT(base, elem_size, last), elem_size);
+		heap_sift_down(base, elem_size, cmp_func, last, 0, max);
+	}
+}
+
+/** Swap the elements at indices `i` and `j` of `arraylist` if the first is
+ * greater than the second. */
+static void arraylist_order_pair(arraylist_t *arraylist, int64_t i, int64_t j) {
+	if (arraylist->cmp_func(ARRAYLIST_GET_UNCHECKED(arraylist, i), ARRAYLIST_GET_UNCHECKED(arraylist, j)) > 0) {
+		swap_bytes(ARRAYLIST_GET_UNCHECKED(arraylist, i), ARRAYLIST_GET_UNCHECKED(arraylist, j), arraylist->elem_size);
+	}
+}
+
+/** Partition the elements of `arraylist` from index `start` up to but not
+ * including index `end` around the median of the first, middle and last ones,
+ * and return the final index of that pivot. Elements before the pivot are not
+ * greater than it and elements after it are not less than it.
+ * Precondition: `end` - `start` >= 3 */
+static int64_t arraylist_partition_range(arraylist_t *arraylist, int64_t start, int64_t end) {
+	int64_t mid = start + (end - start) / 2;
+	arraylist_order_pair(arraylist, start, mid);
+	arraylist_order_pair(arraylist, mid, end - 1);
+	arraylist_order_pair(arraylist, start, mid);
+	swap_bytes(ARRAYLIST_GET_UNCHECKED(arraylist, start), ARRAYLIST_GET_UNCHECKED(arraylist, mid), arraylist->elem_size);
+	const int8_t *pivot = ARRAYLIST_GET_UNCHECKED(arraylist, start);
+	int64_t i = start, j = end;
+	for (;;) {
+		// both scans stop on elements equal to the pivot, which keeps
+		// partitions balanced in the presence of many duplicates
+		do i++; while (i < end && arraylist->cmp_func(ARRAYLIST_GET_UNCHECKED(arraylist, i), pivot) < 0);
+		do j--; while (arraylist->cmp_func(ARRAYLIST_GET_UNCHECKED(arraylist, j), pivot) > 0);
+		if (i >= j) break;
+		swap_bytes(ARRAYLIST_GET_UNCHECKED(arraylist, i), ARRAYLIST_GET_UNCHECKED(arraylist, j), arraylist->elem_size);
+	}
+	swap_bytes(ARRAYLIST_GET_UNCHECKED(arraylist, start), ARRAYLIST_GET_UNCHECKED(arraylist, j), arraylist->elem_size);
+	return j;
+}
+
+/** Move the element that belongs at index `n` in sorted order to that index,
+ * with no greater element before it and no smaller element after it, by
+ * introselect: quickselect that falls back to heap selection when partitions
+ * keep being unbalanced. */
+static void arraylist_select(arraylist_t *arraylist, int64_t n) {
+	int64_t start = 0, end = arraylist->len;
+	int64_t depth_limit = 0;
+	for (int64_t len = arraylist->len; len > 1; len >>= 1) depth_limit += 2;
+	while (end - start > 3) {
+		if (depth_limit-- == 0) {
+			// keep the n - start + 1 smallest elements of the range in a max-heap
+			int8_t *base = ARRAYLIST_GET_UNCHECKED(arraylist, start);
+			int64_t heap_len = n - start + 1;
+			heap_make(base, arraylist->elem_size, arraylist->cmp_func, heap_len, true);
+			for (int64_t i = n + 1; i < end; i++) {
+				int8_t *value = ARRAYLIST_GET_UNCHECKED(arraylist, i);
+				if (arraylist->cmp_func(value, base) < 0) {
+					swap_bytes(value, base, arraylist->elem_size);
+					heap_sift_down(base, arraylist->elem_size, arraylist->cmp_func, heap_len, 0, true);
+				}
+			}
+			swap_bytes(base, ARRAYLIST_GET_UNCHECKED(arraylist, n), arraylist->elem_size);
+			return;
+		}
+		int64_t pivot = arraylist_partition_range(arraylist, start, end);
+		if (pivot == n) return;
+		if (n < pivot) end = pivot;
+		else start = pivot + 1;
+	}
+	// sort the at most 3 remaining elements
+	for (int64_t i = start + 1; i < end; i++) {
+		for (int64_t j = i; j > start; j--) {
+			arraylist_order_pair(arraylist, j - 1, j);
+		}
+	}
+}
+
+void *arraylist_nth_element(arraylist_t *arraylist, int64_t n) {
+	PROFILE_FUNCTION();
+	if (n < -arraylist->len || n >= arraylist->len) return NULL;
+	if (n < 0) n += arraylist->len;
+	if (!arraylist_unshare(arraylist)) return NULL;
+	arraylist_select(arraylist, n);
+	return ARRAYLIST_GET_UNCHECKED(arraylist, n);
+}
+
+bool arraylist_partial_sort(arraylist_t *arraylist, int64_t k) {
+	PROFILE_FUNCTION();
+	k = MIN(MAX(k, 0), arraylist->len);
+	if (!arraylist_unshare(arraylist)) return false;
+	if (k == 0) return true;
+	if (k < arraylist->len) arraylist_select(arraylist, k - 1);
+	heap_make(arraylist->contents, arraylist->elem_size, arraylist->cmp_func, k, true);
+	heap_sort(arraylist->contents, arraylist->elem_size, arraylist->cmp_func, k, true);
+	return true;
+}
+
+bool arraylist_top_k(const arraylist_t *arraylist, int64_t k, arraylist_t *dest) {
+	PROFILE_FUNCTION();
+	k = MIN(MAX(k, 0), arraylist->len);
+	if (!arraylist_unshare(dest) || !arraylist_reserve(dest, MAX(k, 1))) return false;
+	// min-heap of the k greatest elements seen so far
+	dest->len = 0;
+	for (int8_t *value = arraylist->contents; value < arraylist->end && k; value += arraylist->elem_size) {
+		if (dest->len < k) {
+			memcpy(ARRAYLIST_GET_UNCHECKED(dest, dest->len), value, arraylist->elem_size);
+			heap_sift_up(dest->contents, arraylist->elem_size, arraylist->cmp_func, dest->len++, false);
+		} else if (arraylist->cmp_func(value, dest->contents) > 0) {
+			memcpy(dest->contents, value, arraylist->elem_size);
+			heap_sift_down(dest->contents, arraylist->elem_size, arraylist->cmp_func, k, 0, false);
+		}
+	}
+	heap_sort(dest->contents, arraylist->elem_size, arraylist->cmp_func, dest->len, false);
+	dest->end = ARRAYLIST_GET_UNCHECKED(dest, dest->len);
+	arraylist_bloom_invalidate(dest);
+	return true;
+}
+
+/* Number of keys looked up together by arraylist_find_many */
+#define ARRAYLIST_FIND_BATCH_SIZE 64
+
+/* Number of bytes of an arraylist that arraylist_find_many compares against
+   every key of a batch before moving on, small enough to stay in L1 cache */
+#define ARRAYLIST_FIND_BLOCK_SIZE (16 * 1024)
+
+/* Number of binary searches arraylist_lower_bound_many runs in lockstep */
+#define ARRAYLIST_SEARCH_BATCH_SIZE 16
+
+void arraylist_find_many(const arraylist_t *arraylist, const void *keys, int64_t num_keys, int64_t *out_indices) {
+	PROFILE_FUNCTION();
+	const int8_t *key_bytes = keys;
+	int64_t block_len = MAX((int64_t)(ARRAYLIST_FIND_BLOCK_SIZE / arraylist->elem_size), 1);
+	for (int64_t first = 0; first < num_keys; first += ARRAYLIST_FIND_BATCH_SIZE) {
+		// keys of the batch not found yet that the Bloom filter does not rule out
+		int64_t pending[ARRAYLIST_FIND_BATCH_SIZE];
+		int64_t num_pending = 0;
+		for (int64_t i = first; i < MIN(first + ARRAYLIST_FIND_BATCH_SIZE, num_keys); i++) {
+			out_indices[i] = -1;
+			if (!arraylist_bloom_excludes(arraylist, ELEM_AT(key_bytes, arraylist->elem_size, i))) pending[num_pending++] = i;
+		}
+		// scan the arraylist once per batch, comparing each block while it is
+		// in cache against every pending key, instead of once per key
+		for (int64_t start = 0; start < arraylist->len && num_pending; start += block_len) {
+			int64_t end = MIN(start + block_len, arraylist->len);
+			for (int64_t j = 0; j < num_pending;) {
+				const int8_t *key = ELEM_AT(key_bytes, arraylist->elem_size, pending[j]);
+				int64_t index = start;
+				while (index < end && arraylist->cmp_func(ARRAYLIST_GET_UNCHECKED(arraylist, index), key)) index++;
+				if (index < end) {
+					out_indices[pending[j]] = index;
+					pending[j] = pending[--num_pending];
+				} else {
+					j++;
+				}
+			}
+		}
+	}
+}
+
+void arraylist_lower_bound_many(const arraylist_t *arraylist, const void *keys, int64_t num_keys, int64_t *out_indices) {
+	PROFILE_FUNCTION();
+	const int8_t *key_bytes = keys;
+	for (int64_t first = 0; first < num_keys; first += ARRAYLIST_SEARCH_BATCH_SIZE) {
+		int64_t batch_len = MIN(ARRAYLIST_SEARCH_BATCH_SIZE, num_keys - first);
+		const int8_t *batch_keys = ELEM_AT(key_bytes, arraylist->elem_size, first);
+		int64_t base[ARRAYLIST_SEARCH_BATCH_SIZE] = { 0 };
+		// every search of the batch narrows a range of the same length, so
+		// each prefetches its next probe and the others are compared while it
+		// arrives
+		int64_t len = arraylist->len;
+		while (len > 1) {
+			int64_t half = len / 2;
+			len -= half;
+			for (int64_t k = 0; k < batch_len; k++) {
+				const int8_t *key = ELEM_AT(batch_keys, arraylist->elem_size, k);
+				base[k] = arraylist->cmp_func(ARRAYLIST_GET_UNCHECKED(arraylist, base[k] + half), key) < 0 ? base[k] + half : base[k];
+				ds_prefetch(ARRAYLIST_GET_UNCHECKED(arraylist, base[k] + len / 2));
+			}
+		}
+		for (int64_t k = 0; k < batch_len; k++) {
+			const int8_t *key = ELEM_AT(batch_keys, arraylist->elem_size, k);
+			out_indices[first + k] = arraylist->len &&
+				arraylist->cmp_func(ARRAYLIST_GET_UNCHECKED(arraylist, base[k]), key) < 0 ? base[k] + 1 : base[k];
+		}
+	}
+}
+
+/* Number of consecutive elements taken from the same input after which a
+   merge switches to galloping */
+#define MERGE_MIN_GALLOP 7
+
+/** Return the number of leading elements of the `len` sorted elements of size
+ * `elem_size` at `base` that are less than `key`, or less than or equal to
+ * `key` if `inclusive`. Searches exponentially from the start, then by
+ * bisection, so that short answers are found quickly. */
+static int64_t gallop(const int8_t *base, size_t elem_size, cmp_func_t cmp_func, int64_t len, const void *key, bool inclusive) {
+	int64_t lo = 0, hi = 1;
+	// find lo < answer <= hi
+	while (hi <= len) {
+		int64_t cmp = cmp_func(ELEM_AT(base, elem_size, hi - 1), key);
+		if (inclusive ? cmp > 0 : cmp >= 0) break;
+		lo = hi;
+		hi = 2 * hi + 1;
+	}
+	hi = MIN(hi, len);
+	while (lo < hi) {
+		int64_t m = lo + (hi - lo) / 2;
+		int64_t cmp = cmp_func(ELEM_AT(base, elem_size, m), key);
+		if (inclusive ? cmp <= 0 : cmp < 0) lo = m + 1;
+		else hi = m;
+	}
+	return lo;
+}
+
+/** Merge the `len_a` sorted elements at `a` and the `len_b` sorted elements at
+ * `b` into `dest`, which must not overlap either of them. Ties are taken from
+ * `a` first. After MERGE_MIN_GALLOP consecutive elements from the same input,
+ * the whole run of that input preceding the head of the other is copied at
+ * once. */
+static void merge_runs(int8_t *dest, const int8_t *a, int64_t len_a, const int8_t *b, int64_t len_b, size_t elem_size, cmp_func_t cmp_func) {
+	const int8_t *end_a = ELEM_AT(a, elem_size, len_a), *end_b = ELEM_AT(b, elem_size, len_b);
+	int64_t wins_a = 0, wins_b = 0;
+	while (a < end_a && b < end_b) {
+		if (cmp_func(b, a) < 0) {
+			memcpy(dest, b, elem_size);
+			dest += elem_size;
+			b += elem_size;
+			wins_a = 0;
+			if (++wins_b >= MERGE_MIN_GALLOP && b < end_b) {
+				int64_t n = gallop(b, elem_size, cmp_func, (end_b - b) / (int64_t)elem_size, a, false);
+				memcpy(dest, b, (size_t)n * elem_size);
+				dest += n * (int64_t)elem_size;
+				b += n * (int64_t)elem_size;
+				wins_b = 0;
+			}
+		} else {
+			memcpy(dest, a, elem_size);
+			dest += elem_size;
+			a += elem_size;
+			wins_b = 0;
+			if (++wins_a >= MERGE_MIN_GALLOP && a < end_a) {
+				int64_t n = gallop(a, elem_size, cmp_func, (end_a - a) / (int64_t)elem_size, b, true);
+				memcpy(dest, a, (size_t)n * elem_size);
+				dest += n * (int64_t)elem_size;
+				a += n * (int64_t)elem_size;
+				wins_a = 0;
+			}
+		}
+	}
+	memcpy(dest, a, (size_t)(end_a - a));
+	memcpy(dest + (end_a - a), b, (size_t)(end_b - b));
+}
+
+bool arraylist_merge(const arraylist_t *a, const arraylist_t *b, arraylist_t *dest) {
+	PROFILE_FUNCTION();
+	if (!arraylist_unshare(dest) || !arraylist_reserve(dest, MAX(a->len + b->len, 1))) return false;
+	merge_runs(dest->contents, a->contents, a->len, b->contents, b->len, a->elem_size, a->cmp_func);
+	dest->len = a->len + b->len;
+	dest->end = ARRAYLIST_GET_UNCHECKED(dest, dest->len);
+	arraylist_bloom_invalidate(dest);
+	return true;
+}
+
+/** Reverse the elements of `arraylist` from index `start` up to but not
+ * including index `end`. */
+static void arraylist_reverse_range(arraylist_t *arraylist, int64_t start, int64_t end) {
+	for (end--; start < end; start++, end--) {
+		swap_bytes(ARRAYLIST_GET_UNCHECKED(arraylist, start), ARRAYLIST_GET_UNCHECKED(arraylist, end), arraylist->elem_size);
+	}
+}
+
+/** Merge the adjacent sorted ranges [`start`, `mid`) and [`mid`, `end`) of
+ * `arraylist` without any buffer, by splitting both ranges around a pivot,
+ * rotating the middle parts and recursing, in O(n log n) time. */
+static void merge_without_buffer(arraylist_t *arraylist, int64_t start, int64_t mid, int64_t end) {
+	if (start == mid || mid == end) return;
+	if (end - start == 2) {
+		if (arraylist->cmp_func(ARRAYLIST_GET_UNCHECKED(arraylist, mid), ARRAYLIST_GET_UNCHECKED(arraylist, start)) < 0) {
+			swap_bytes(ARRAYLIST_GET_UNCHECKED(arraylist, start), ARRAYLIST_GET_UNCHECKED(arraylist, mid), arraylist->elem_size);
+		}
+		return;
+	}
+	int64_t cut1, cut2;
+	if (mid - start > end - mid) {
+		cut1 = start + (mid - start) / 2;
+		cut2 = mid + gallop(ARRAYLIST_GET_UNCHECKED(arraylist, mid), arraylist->elem_size, arraylist->cmp_func,
+			end - mid, ARRAYLIST_GET_UNCHECKED(arraylist, cut1), false);
+	} else {
+		cut2 = mid + (end - mid) / 2;
+		cut1 = start + gallop(ARRAYLIST_GET_UNCHECKED(arraylist, start), arraylist->elem_size, arraylist->cmp_func,
+			mid - start, ARRAYLIST_GET_UNCHECKED(arraylist, cut2), true);
+	}
+	// rotate [cut1, mid) and [mid, cut2)
+	arraylist_reverse_range(arraylist, cut1, mid);
+	arraylist_reverse_range(arraylist, mid, cut2);
+	arraylist_reverse_range(arraylist, cut1, cut2);
+	int64_t new_mid = cut1 + (cut2 - mid);
+	merge_without_buffer(arraylist, start, cut1, new_mid);
+	merge_without_buffer(arraylist, new_mid, cut2, end);
+}
+
+/** Merge the adjacent sorted ranges [`start`, `mid`) and [`mid`, `end`) of
+ * `arraylist` stably, through `buffer` if it can hold the smaller range of the
+ * two and without buffer otherwise.
+ * @param buffer: temporary space for `buffer_len` elements, NULL if none */
+static void merge_adjacent(arraylist_t *arraylist, int64_t start, int64_t mid, int64_t end, int8_t *buffer, int64_t buffer_len) {
+	size_t elem_size = arraylist->elem_size;
+	if (mid - start <= end - mid && mid - start <= buffer_len) {
+		// merge forward from a copy of the first range; the destination never
+		// overtakes the second range, so it can be read in place
+		memcpy(buffer, ARRAYLIST_GET_UNCHECKED(arraylist, start), (size_t)(mid - start) * elem_size);
+		int8_t *dest = ARRAYLIST_GET_UNCHECKED(arraylist, start);
+		int8_t *a = buffer, *end_a = ELEM_AT(buffer, elem_size, mid - start);
+		int8_t *b = ARRAYLIST_GET_UNCHECKED(arraylist, mid), *end_b = ARRAYLIST_GET_UNCHECKED(arraylist, end);
+		while (a < end_a && b < end_b) {
+			if (arraylist->cmp_func(b, a) < 0) {
+				memcpy(dest, b, elem_size);
+				b += elem_size;
+			} else {
+				memcpy(dest, a, elem_size);
+				a += elem_size;
+			}
+			dest += elem_size;
+		}
+		memcpy(dest, a, (size_t)(end_a - a));
+	} else if (end - mid <= buffer_len) {
+		// merge backward from a copy of the second range
+		memcpy(buffer, ARRAYLIST_GET_UNCHECKED(arraylist, mid), (size_t)(end - mid) * elem_size);
+		int8_t *dest = ARRAYLIST_GET_UNCHECKED(arraylist, end);
+		int8_t *a = ARRAYLIST_GET_UNCHECKED(arraylist, mid), *start_a = ARRAYLIST_GET_UNCHECKED(arraylist, start);
+		int8_t *b = ELEM_AT(buffer, elem_size, end - mid);
+		while (a > start_a && b > buffer) {
+			dest -= elem_size;
+			if (arraylist->cmp_func(b - elem_size, a - elem_size) < 0) {
+				a -= elem_size;
+				memcpy(dest, a, elem_size);
+			} else {
+				b -= elem_size;
+				memcpy(dest, b, elem_size);
+			}
+		}
+		memcpy(dest - (b - buffer), buffer, (size_t)(b - buffer));
+	} else {
+		merge_without_buffer(arraylist, start, mid, end);
+	}
+}
+
+bool arraylist_merge_inplace(arraylist_t *arraylist, int64_t start, int64_t mid, int64_t end) {
+	PROFILE_FUNCTION();
+	if (start < 0 || start > mid || mid > end || end > arraylist->len) return false;
+	int64_t buffer_len = MIN(mid - start, end - mid);
+	void *buffer = buffer_len ? malloc((size_t)buffer_len * arraylist->elem_size) : NULL;
+	bool merged = arraylist_merge_inplace_buffered(arraylist, start, mid, end, buffer, buffer ? buffer_len : 0);
+	free(buffer);
+	return merged;
+}
+
+bool arraylist_merge_inplace_buffered(arraylist_t *arraylist, int64_t start, int64_t mid, int64_t end, void *buffer, int64_t buffer_len) {
+	PROFILE_FUNCTION();
+	if (start < 0 || start > mid || mid > end || end > arraylist->len) return false;
+	if (!arraylist_unshare(arraylist)) return false;
+	if (start == mid || mid == end) return true;
+	merge_adjacent(arraylist, start, mid, end, buffer, buffer ? buffer_len : 0);
+	return true;
+}
+
+/** Return whether the head of list `x` comes before the head of list `y` in a
+ * k-way merge, where an exhausted list comes last and ties go to the list
+ * with the lower index to keep the merge stable. */
+static bool merge_k_before(const arraylist_t *const *lists, const int64_t *positions, int64_t x, int64_t y) {
+	if (positions[x] == lists[x]->len) return false;
+	if (positions[y] == lists[y]->len) return true;
+	int64_t cmp = lists[x]->cmp_func(ARRAYLIST_GET_UNCHECKED(lists[x], positions[x]), ARRAYLIST_GET_UNCHECKED(lists[y], positions[y]));
+	return cmp < 0 || (cmp == 0 && x < y);
+}
+
+/** Play the matches of the subtree of loser tree node `node` of a k-way merge
+ * of `k` lists, storing the loser of each match in `tree`, and return the
+ * winner. Nodes 1 to k - 1 are matches, and nodes k to 2k - 1 are the lists. */
+static int64_t merge_k_build(const arraylist_t *const *lists, const int64_t *positions, int64_t *tree, int64_t k, int64_t node) {
+	if (node >= k) return node - k;
+	int64_t left = merge_k_build(lists, positions, tree, k, 2 * node);
+	int64_t right = merge_k_build(lists, positions, tree, k, 2 * node + 1);
+	if (merge_k_before(lists, positions, right, left)) {
+		tree[node] = left;
+		return right;
+	}
+	tree[node] = right;
+	return left;
+}
+
+bool arraylist_merge_k(const arraylist_t *const *lists, int64_t k, arraylist_t *dest) {
+	PROFILE_FUNCTION();
+	int64_t total_len = 0;
+	for (int64_t i = 0; i < k; i++) {
+		total_len += lists[i]->len;
+	}
+	if (!arraylist_unshare(dest) || !arraylist_reserve(dest, MAX(total_len, 1))) return false;
+	int64_t *positions = calloc((size_t)MAX(k, 1), sizeof(int64_t));
+	int64_t *tree = malloc((size_t)MAX(k, 1) * sizeof(int64_t));
+	if (!positions || !tree) {
+		free(positions);
+		free(tree);
+		return false;
+	}
+	int8_t *out = dest->contents;
+	if (k) {
+		// tree[0] holds the overall winner, the other nodes the loser of their match
+		tree[0] = merge_k_build(lists, positions, tree, k, 1);
+		for (int64_t n = 0; n < total_len; n++) {
+			int64_t winner = tree[0];
+			memcpy(out, ARRAYLIST_GET_UNCHECKED(lists[winner], positions[winner]), dest->elem_size);
+			out += dest->elem_size;
+			positions[winner]++;
+			// replay the matches on the path from the winner's leaf to the root
+			for (int64_t node = (winner + k) / 2; node >= 1; node /= 2) {
+				if (merge_k_before(lists, positions, tree[node], winner)) {
+					int64_t loser = winner;
+					winner = tree[node];
+					tree[node] = loser;
+				}
+			}
+			tree[0] = winner;
+		}
+	}
+	free(positions);
+	free(tree);
+	dest->len = total_len;
+	dest->end = out;
+	arraylist_bloom_invalidate(dest);
+	return true;
+}
+
 /** Return the index of the inorder successor of `value` in the slice of
  * `arraylist` starting at index `start` and ending just before index `end`.
- * If all elements in the slice are less than `value`, then return the length of
- * `arraylist`.
+ * If no element in the slice is greater than `value`, then return `end`.
  * Precondition: Elements `start` up to but not including `end` are sorted from
  *     least to greatest.
  * @param arraylist: the arraylist
- * @param arraylist: index of first element in sorted slice
+ * @param start: index of first element in sorted slice
  * @param end: index of first element to the right of sorted slice
  * @param value: value for which the inorder successor is sought
  * @return: index of inorder successor of `value` in sorted part of `arraylist`,
- *     length of `arraylist` if one doesn't exist */
+ *     `end` if one doesn't exist */
 static int64_t binary_search_right(const arraylist_t *arraylist, int64_t start, int64_t end, const void *value) {
 	while (start < end) {
 		int64_t m = start + (end - start) / 2;
@@ -282,29 +1850,46 @@ static int64_t binary_search_right(const arraylist_t *arraylist, int64_t start,
 }
 
 /** Sort the elements of `arraylist` from least to greatest, starting at index
- * `start` and ending just before index `end`.
+ * `start` and ending just before index `end`, by binary insertion. The sort is
+ * stable.
  * Precondition: `start` <= `end`
  * @param arraylist: the arraylist to sort
- * @param start: pointer to first element to sort, <= end
- * @param end: pointer just past the last element to sort, >= start
- * @param temp: buffer to hold temporary data during sort, must be large enough
- *     to hold a single element */
-static void insertion_sort(const arraylist_t *arraylist, int64_t start, int64_t end, void *temp) {
+ * @param start: index of first element to sort
+ * @param end: index just past the last element to sort
+ * @param temp: buffer to hold temporary data during sort, large enough to hold
+ *     a single element, or NULL to rotate elements in place instead */
+static void insertion_sort(arraylist_t *arraylist, int64_t start, int64_t end, void *temp) {
 	for (int64_t current = start + 1; current < end; current++) {
 		// current is the index of the value we are pushing down to its sorted position
 		int8_t *current_value = ARRAYLIST_GET_UNCHECKED(arraylist, current);
-		int64_t insert_index = binary_search_right(arraylist, start, end, current_value);
-		if (insert_index != current) {
+		int64_t insert_index = binary_search_right(arraylist, start, current, current_value);
+		if (insert_index == current) continue;
+		if (temp) {
 			memcpy(temp, current_value, arraylist->elem_size);
 			memmove(ARRAYLIST_GET_UNCHECKED(arraylist, insert_index + 1),
 				ARRAYLIST_GET_UNCHECKED(arraylist, insert_index),
-				(size_t)end - (size_t)insert_index * arraylist->elem_size);
+				(size_t)(current - insert_index) * arraylist->elem_size);
 			memcpy(ARRAYLIST_GET_UNCHECKED(arraylist, insert_index), temp, arraylist->elem_size);
+		} else {
+			arraylist_reverse_range(arraylist, insert_index, current + 1);
+			arraylist_reverse_range(arraylist, insert_index + 1, current + 1);
 		}
 	}
 }
 
 void arraylist_sort(arraylist_t *arraylist) {
+	PROFILE_FUNCTION();
+	// the smaller of two merged runs is never longer than half the arraylist
+	int64_t buffer_len = MAX(arraylist->len / 2, 1);
+	void *buffer = malloc((size_t)buffer_len * arraylist->elem_size);
+	arraylist_sort_buffered(arraylist, buffer, buffer ? buffer_len : 0);
+	free(buffer);
+}
+
+void arraylist_sort_buffered(arraylist_t *arraylist, void *buffer, int64_t buffer_len) {
+	PROFILE_FUNCTION();
+	if (!arraylist_unshare(arraylist)) return;
+	if (!buffer) buffer_len = 0;
 	// minrun should be in the range [32,64] such that the number of minruns
 	// in the array is slightly less than or equal to a power of 2
 	int64_t minrun = arraylist->len;
@@ -314,30 +1899,111 @@ void arraylist_sort(arraylist_t *arraylist) {
 		minrun >>= 1;
 	}
 	minrun += remainder;
-	
+	for (int64_t start = 0; start < arraylist->len; start += minrun) {
+		insertion_sort(arraylist, start, MIN(start + minrun, arraylist->len), buffer_len ? buffer : NULL);
+	}
+	for (int64_t width = minrun; width < arraylist->len; width *= 2) {
+		for (int64_t start = 0; start + width < arraylist->len; start += 2 * width) {
+			merge_adjacent(arraylist, start, start + width, MIN(start + 2 * width, arraylist->len), buffer, buffer_len);
+		}
+	}
+}
 
+/** Return whether the element at index `a` of `arraylist` comes before the one
+ * at index `b`, with ties going to the lower index to keep argsort stable. */
+static inline bool argsort_before(const arraylist_t *arraylist, int64_t a, int64_t b) {
+	int64_t cmp = arraylist->cmp_func(ARRAYLIST_GET_UNCHECKED(arraylist, a), ARRAYLIST_GET_UNCHECKED(arraylist, b));
+	return cmp < 0 || (cmp == 0 && a < b);
 }
 
-void arraylist_reverse(arraylist_t *arraylist, void *temp) {
-	int8_t *a = arraylist->contents;
-	int8_t *b = ARRAYLIST_GET_UNCHECKED(arraylist, arraylist->len - 1);
-	while (a < b) {
-		memcpy(temp, a, arraylist->elem_size);
-		memcpy(a, b, arraylist->elem_size);
-		memcpy(b, temp, arraylist->elem_size);
-		a += arraylist->elem_size;
-		b -= arraylist->elem_size;
+bool arraylist_argsort(const arraylist_t *arraylist, arraylist_t *dest_indices) {
+	PROFILE_FUNCTION();
+	int64_t len = arraylist->len;
+	if (dest_indices->elem_size != sizeof(int64_t) || !arraylist_unshare(dest_indices) || !arraylist_reserve(dest_indices, MAX(len, 1))) return false;
+	int64_t *buffer = malloc((size_t)MAX(len, 1) * sizeof(int64_t));
+	if (!buffer) return false;
+	int64_t *indices = (int64_t *)dest_indices->contents;
+	// insertion sort blocks of indices, then merge them back and forth between
+	// the indices and the buffer; only indices move, never the elements
+	const int64_t block = 32;
+	for (int64_t start = 0; start < len; start += block) {
+		int64_t end = MIN(start + block, len);
+		for (int64_t i = start; i < end; i++) {
+			int64_t j = i;
+			for (; j > start && argsort_before(arraylist, i, indices[j - 1]); j--) {
+				indices[j] = indices[j - 1];
+			}
+			indices[j] = i;
+		}
+	}
+	int64_t *src = indices, *dst = buffer;
+	for (int64_t width = block; width < len; width *= 2) {
+		for (int64_t start = 0; start < len; start += 2 * width) {
+			int64_t mid = MIN(start + width, len), end = MIN(start + 2 * width, len);
+			int64_t a = start, b = mid, out = start;
+			while (a < mid && b < end) {
+				dst[out++] = argsort_before(arraylist, src[b], src[a]) ? src[b++] : src[a++];
+			}
+			memcpy(dst + out, src + a, (size_t)(mid - a) * sizeof(int64_t));
+			memcpy(dst + out + mid - a, src + b, (size_t)(end - b) * sizeof(int64_t));
+		}
+		int64_t *swap = src;
+		src = dst;
+		dst = swap;
+	}
+	if (src != indices) memcpy(indices, src, (size_t)len * sizeof(int64_t));
+	free(buffer);
+	dest_indices->len = len;
+	dest_indices->end = ARRAYLIST_GET_UNCHECKED(dest_indices, len);
+	arraylist_bloom_invalidate(dest_indices);
+	return true;
+}
+
+bool arraylist_apply_permutation(arraylist_t *arraylist, const arraylist_t *indices) {
+	PROFILE_FUNCTION();
+	if (indices->elem_size != sizeof(int64_t) || indices->len != arraylist->len) return false;
+	const int64_t *permutation = (const int64_t *)indices->contents;
+	bitset_t *visited = bitset_new(arraylist->len);
+	void *temp = malloc(arraylist->elem_size);
+	bool ok = visited && temp && arraylist_unshare(arraylist);
+	// check that every index appears exactly once before moving anything
+	for (int64_t i = 0; ok && i < arraylist->len; i++) {
+		ok = permutation[i] >= 0 && permutation[i] < arraylist->len && !bitset_test(visited, permutation[i]);
+		if (ok) bitset_set(visited, permutation[i]);
+	}
+	if (ok) {
+		bitset_fill(visited, false);
+		// follow each cycle, holding only its first element aside
+		for (int64_t start = 0; start < arraylist->len; start++) {
+			if (bitset_test(visited, start) || permutation[start] == start) continue;
+			memcpy(temp, ARRAYLIST_GET_UNCHECKED(arraylist, start), arraylist->elem_size);
+			int64_t current = start;
+			while (permutation[current] != start) {
+				bitset_set(visited, current);
+				memcpy(ARRAYLIST_GET_UNCHECKED(arraylist, current),
+					ARRAYLIST_GET_UNCHECKED(arraylist, permutation[current]), arraylist->elem_size);
+				current = permutation[current];
+			}
+			bitset_set(visited, current);
+			memcpy(ARRAYLIST_GET_UNCHECKED(arraylist, current), temp, arraylist->elem_size);
+		}
 	}
+	if (visited) bitset_free(visited);
+	free(temp);
+	return ok;
 }
 
 arraylist_t *arraylist_copy(const arraylist_t *arraylist) {
+	PROFILE_FUNCTION();
 	arraylist_t *copy = malloc(sizeof(arraylist_t));
 	if (!copy) return NULL;
 	copy->len = arraylist->len;
 	copy->elem_size = arraylist->elem_size;
-	if ((copy->contents = malloc((size_t)arraylist->phys_len * arraylist->elem_size)) != NULL) {
+	copy->alignment = arraylist->alignment;
+	copy->huge_pages = arraylist->huge_pages;
+	if ((copy->contents = contents_alloc(copy, arraylist->phys_len)) != NULL) {
 		copy->phys_len = arraylist->phys_len;
-	} else if ((copy->contents = malloc((size_t)MAX(arraylist->len, 1) * arraylist->elem_size)) != NULL) {
+	} else if ((copy->contents = contents_alloc(copy, MAX(arraylist->len, 1))) != NULL) {
 		copy->phys_len = MAX(arraylist->len, 1);
 	} else {
 		free(copy);
@@ -346,10 +2012,30 @@ arraylist_t *arraylist_copy(const arraylist_t *arraylist) {
 	memcpy(copy->contents, arraylist->contents, (size_t)arraylist->len * arraylist->elem_size);
 	copy->end = ARRAYLIST_GET_UNCHECKED(copy, copy->len);
 	copy->cmp_func = arraylist->cmp_func;
+	copy->refcount = NULL;
+	copy->bloom = NULL;
+	return copy;
+}
+
+arraylist_t *arraylist_cow_copy(arraylist_t *arraylist) {
+	PROFILE_FUNCTION();
+	arraylist_t *copy = malloc(sizeof(arraylist_t));
+	if (!copy) return NULL;
+	if (!arraylist->refcount) {
+		if (!(arraylist->refcount = malloc(sizeof(int64_t)))) {
+			free(copy);
+			return NULL;
+		}
+		*arraylist->refcount = 1;
+	}
+	ds_atomic_fetch_add(arraylist->refcount, 1);
+	*copy = *arraylist;
+	copy->bloom = NULL;
 	return copy;
 }
 
 int64_t arraylist_compare(const arraylist_t *arraylist1, const arraylist_t *arraylist2) {
+	PROFILE_FUNCTION();
 	int8_t *value1, *value2;
 	for (value1 = arraylist1->contents, value2 = arraylist2->contents;
 		value1 < arraylist1->end && value2 < arraylist2->end;
@@ -363,12 +2049,16 @@ int64_t arraylist_compare(const arraylist_t *arraylist1, const arraylist_t *arra
 }
 
 void arraylist_foreach(arraylist_t *arraylist, void(*func)(void*)) {
+	PROFILE_FUNCTION();
+	if (!arraylist_unshare(arraylist)) return;
 	for (int8_t *value = arraylist->contents; value < arraylist->end; value += arraylist->elem_size) {
 		func(value);
 	}
+	arraylist_bloom_invalidate(arraylist);
 }
 
 arraylist_iter_t *arraylist_iter_new(const arraylist_t *arraylist) {
+	PROFILE_FUNCTION();
 	arraylist_iter_t *iter = malloc(sizeof(arraylist_iter_t));
 	if (!iter) return NULL;
 	iter->arraylist = arraylist;
@@ -377,10 +2067,12 @@ arraylist_iter_t *arraylist_iter_new(const arraylist_t *arraylist) {
 }
 
 void arraylist_iter_free(arraylist_iter_t *iter) {
+	PROFILE_FUNCTION();
 	free(iter);
 }
 
 void *arraylist_iter_next(arraylist_iter_t *iter) {
+	PROFILE_FUNCTION();
 	if (iter->next == iter->arraylist->end) return NULL;
 	else {
 		void *next = iter->next;
@@ -390,45 +2082,3031 @@ void *arraylist_iter_next(arraylist_iter_t *iter) {
 }
 
 void arraylist_iter_reset(arraylist_iter_t *iter) {
+	PROFILE_FUNCTION();
 	iter->next = iter->arraylist->contents;
 }
 
+/* ---------------------------- arraylist views ---------------------------- */
 
-/* -------------------------- doubly linked list -------------------------- */
+/** Return a read-only arraylist aliasing the elements of `view`, for reuse of
+ * the arraylist read operations. The result must not be modified or freed. */
+static arraylist_t view_as_arraylist(const arraylist_view_t *view) {
+	arraylist_t arraylist;
+	arraylist.len = view->len;
+	arraylist.phys_len = view->len;
+	arraylist.elem_size = view->elem_size;
+	arraylist.contents = (int8_t *)view->contents;
+	arraylist.end = arraylist.contents + view->len * (int64_t)view->elem_size;
+	arraylist.cmp_func = view->cmp_func;
+	arraylist.alignment = 0;
+	arraylist.huge_pages = false;
+	arraylist.refcount = NULL;
+	arraylist.bloom = NULL;
+	return arraylist;
+}
 
-linkedlist_t *linkedlist_new(size_t elem_size, cmp_func_t cmp_func) {
-	linkedlist_t *linkedlist = malloc(sizeof(linkedlist_t));
-	if (!linkedlist) return NULL;
-	linkedlist->head = NULL;
-	linkedlist->tail = NULL;
-	linkedlist->value_in_node = elem_size <= NODE_VALUE_MAX_SIZE;
-	linkedlist->len = 0;
-	linkedlist->cmp_func = cmp_func;
-	return linkedlist;
+arraylist_view_t arraylist_view(const arraylist_t *arraylist, int64_t start, int64_t end) {
+	PROFILE_FUNCTION();
+	normalize_slice(arraylist->len, &start, &end);
+	arraylist_view_t view;
+	view.contents = arraylist->contents + MIN(start, end) * (int64_t)arraylist->elem_size;
+	view.len = MAX(end - start, 0);
+	view.elem_size = arraylist->elem_size;
+	view.cmp_func = arraylist->cmp_func;
+	return view;
 }
 
-void linkedlist_free(linkedlist_t *linkedlist) {
-	if (linkedlist->head) {
-		linkedlistnode_t *node = linkedlist->head;
-		if (linkedlist->value_in_node) {
-			while (node) {
-				linkedlistnode_t *prev_node = node;
-				node = node->next;
-				free(prev_node);
-			}
-		} else {
-			while (node) {
-				free(node->elem.ptr);
-				linkedlistnode_t *prev_node = node;
-				node = node->next;
-				free(prev_node);
-			}
+arraylist_view_t arraylist_view_slice(const arraylist_view_t *view, int64_t start, int64_t end) {
+	PROFILE_FUNCTION();
+	arraylist_t arraylist = view_as_arraylist(view);
+	return arraylist_view(&arraylist, start, end);
+}
+
+int64_t arraylist_view_len(const arraylist_view_t *view) {
+	PROFILE_FUNCTION();
+	return view->len;
+}
+
+const void *arraylist_view_get(const arraylist_view_t *view, int64_t index) {
+	PROFILE_FUNCTION();
+	arraylist_t arraylist = view_as_arraylist(view);
+	return arraylist_get(&arraylist, index);
+}
+
+bool arraylist_view_contains(const arraylist_view_t *view, const void *value) {
+	PROFILE_FUNCTION();
+	arraylist_t arraylist = view_as_arraylist(view);
+	return arraylist_contains(&arraylist, value);
+}
+
+int64_t arraylist_view_find(const arraylist_view_t *view, const void *value) {
+	PROFILE_FUNCTION();
+	arraylist_t arraylist = view_as_arraylist(view);
+	return arraylist_find(&arraylist, value);
+}
+
+int64_t arraylist_view_rfind(const arraylist_view_t *view, const void *value) {
+	PROFILE_FUNCTION();
+	arraylist_t arraylist = view_as_arraylist(view);
+	return arraylist_rfind(&arraylist, value);
+}
+
+int64_t arraylist_view_count(const arraylist_view_t *view, const void *value) {
+	PROFILE_FUNCTION();
+	arraylist_t arraylist = view_as_arraylist(view);
+	return arraylist_count(&arraylist, value);
+}
+
+int64_t arraylist_view_compare(const arraylist_view_t *view1, const arraylist_view_t *view2) {
+	PROFILE_FUNCTION();
+	arraylist_t arraylist1 = view_as_arraylist(view1);
+	arraylist_t arraylist2 = view_as_arraylist(view2);
+	return arraylist_compare(&arraylist1, &arraylist2);
+}
+
+void arraylist_view_foreach(const arraylist_view_t *view, void(*func)(const void*)) {
+	PROFILE_FUNCTION();
+	const int8_t *end = view->contents + view->len * (int64_t)view->elem_size;
+	for (const int8_t *value = view->contents; value < end; value += view->elem_size) {
+		func(value);
+	}
+}
+
+arraylist_t *arraylist_view_copy(const arraylist_view_t *view) {
+	PROFILE_FUNCTION();
+	if (!view->len) return arraylist_new(view->elem_size, view->cmp_func);
+	return arraylist_from_array(view->contents, view->len, view->elem_size, view->cmp_func);
+}
+
+/* --------------------------- columnar arraylist --------------------------- */
+
+/* Pointer to the field of row `index` in column `column` of `columnlist`. No
+   bounds checking is done. */
+#define COLUMNLIST_GET_UNCHECKED(columnlist, column, index) \
+	((columnlist)->columns[column] + (index) * (int64_t)(columnlist)->column_sizes[column])
+
+/** Resize every column of `columnlist` to hold `phys_len` rows. When growing,
+ * return false if there is insufficient memory, in which case the physical
+ * length is unchanged. Shrinking always succeeds, keeping any column that
+ * cannot be reallocated as it is. */
+static bool columnlist_resize(columnlist_t *columnlist, int64_t phys_len) {
+	for (int64_t column = 0; column < columnlist->num_columns; column++) {
+		int8_t *contents = realloc(columnlist->columns[column], MAX((size_t)phys_len * columnlist->column_sizes[column], 1));
+		if (contents) columnlist->columns[column] = contents;
+		else if (phys_len > columnlist->phys_len) return false;
+	}
+	columnlist->phys_len = phys_len;
+	return true;
+}
+
+/** Make room for one more row in `columnlist` as arraylist_grow does. Return
+ * false if there is insufficient memory. */
+static bool columnlist_grow(columnlist_t *columnlist) {
+	if (columnlist->phys_len != columnlist->len) return true;
+	return columnlist_resize(columnlist, MAX(ARRAYLIST_GROWTH_FACTOR * columnlist->phys_len, columnlist->phys_len + 1)) ||
+		columnlist_resize(columnlist, columnlist->phys_len + 1);
+}
+
+/** Shrink the columns of `columnlist` as arraylist_shrink does. */
+static void columnlist_shrink(columnlist_t *columnlist) {
+	if (columnlist->phys_len / ARRAYLIST_GROWTH_FACTOR >= ARRAYLIST_INIT_LEN &&
+		columnlist->len <= columnlist->phys_len / ARRAYLIST_SHRINK_THRESHOLD) {
+		columnlist_resize(columnlist, columnlist->phys_len / ARRAYLIST_GROWTH_FACTOR);
+	}
+}
+
+columnlist_t *columnlist_new(const size_t *column_sizes, int64_t num_columns) {
+	columnlist_t *columnlist = malloc(sizeof(columnlist_t));
+	if (!columnlist) return NULL;
+	columnlist->len = 0;
+	columnlist->phys_len = ARRAYLIST_INIT_LEN;
+	columnlist->num_columns = num_columns;
+	columnlist->row_size = 0;
+	columnlist->column_sizes = malloc((size_t)MAX(num_columns, 1) * sizeof(size_t));
+	columnlist->columns = calloc((size_t)MAX(num_columns, 1), sizeof(int8_t *));
+	if (!columnlist->column_sizes || !columnlist->columns) {
+		columnlist->num_columns = 0;
+		columnlist_free(columnlist);
+		return NULL;
+	}
+	for (int64_t column = 0; column < num_columns; column++) {
+		columnlist->column_sizes[column] = column_sizes[column];
+		columnlist->row_size += column_sizes[column];
+		if (!(columnlist->columns[column] = malloc(MAX(ARRAYLIST_INIT_LEN * column_sizes[column], 1)))) {
+			columnlist_free(columnlist);
+			return NULL;
 		}
 	}
-	free(linkedlist);
+	return columnlist;
 }
 
-int64_t linkedlist_len(linkedlist_t *linkedlist) {
-	return linkedlist->len;
+void columnlist_free(columnlist_t *columnlist) {
+	if (columnlist->columns) {
+		for (int64_t column = 0; column < columnlist->num_columns; column++) {
+			free(columnlist->columns[column]);
+		}
+	}
+	free(columnlist->columns);
+	free(columnlist->column_sizes);
+	free(columnlist);
+}
+
+int64_t columnlist_len(const columnlist_t *columnlist) {
+	return columnlist->len;
+}
+
+void *columnlist_column(const columnlist_t *columnlist, int64_t column) {
+	if (column < 0 || column >= columnlist->num_columns) return NULL;
+	return columnlist->columns[column];
+}
+
+void *columnlist_get(const columnlist_t *columnlist, int64_t column, int64_t index) {
+	if (column < 0 || column >= columnlist->num_columns) return NULL;
+	if (index < -columnlist->len || index >= columnlist->len) return NULL;
+	if (index < 0) index += columnlist->len;
+	return COLUMNLIST_GET_UNCHECKED(columnlist, column, index);
+}
+
+bool columnlist_get_row(const columnlist_t *columnlist, int64_t index, void *dest) {
+	if (index < -columnlist->len || index >= columnlist->len) return false;
+	if (index < 0) index += columnlist->len;
+	int8_t *field = dest;
+	for (int64_t column = 0; column < columnlist->num_columns; column++) {
+		memcpy(field, COLUMNLIST_GET_UNCHECKED(columnlist, column, index), columnlist->column_sizes[column]);
+		field += columnlist->column_sizes[column];
+	}
+	return true;
 }
 
+bool columnlist_set_row(columnlist_t *columnlist, int64_t index, const void *row) {
+	if (index < -columnlist->len || index >= columnlist->len) return false;
+	if (index < 0) index += columnlist->len;
+	const int8_t *field = row;
+	for (int64_t column = 0; column < columnlist->num_columns; column++) {
+		memmove(COLUMNLIST_GET_UNCHECKED(columnlist, column, index), field, columnlist->column_sizes[column]);
+		field += columnlist->column_sizes[column];
+	}
+	return true;
+}
+
+bool columnlist_append(columnlist_t *columnlist, const void *row) {
+	if (!columnlist_grow(columnlist)) return false;
+	columnlist->len++;
+	return columnlist_set_row(columnlist, columnlist->len - 1, row);
+}
+
+bool columnlist_delete(columnlist_t *columnlist, int64_t index) {
+	if (index < -columnlist->len || index >= columnlist->len) return false;
+	if (index < 0) index += columnlist->len;
+	for (int64_t column = 0; column < columnlist->num_columns; column++) {
+		memmove(COLUMNLIST_GET_UNCHECKED(columnlist, column, index),
+			COLUMNLIST_GET_UNCHECKED(columnlist, column, index + 1),
+			(size_t)(columnlist->len - index - 1) * columnlist->column_sizes[column]);
+	}
+	columnlist->len--;
+	columnlist_shrink(columnlist);
+	return true;
+}
+
+void columnlist_clear(columnlist_t *columnlist) {
+	columnlist->len = 0;
+	columnlist_resize(columnlist, ARRAYLIST_INIT_LEN);
+}
+
+/* --------------------------- segmented vector --------------------------- */
+
+segvec_t *segvec_new(size_t elem_size, int64_t first_segment_len) {
+	segvec_t *segvec = calloc(1, sizeof(segvec_t));
+	if (!segvec) return NULL;
+	segvec->elem_size = elem_size;
+	segvec->first_segment_bits = first_segment_len > 1 ? ds_msb64((uint64_t)first_segment_len - 1) + 1 : 0;
+	return segvec;
+}
+
+void segvec_free(segvec_t *segvec) {
+	for (int64_t i = 0; i < SEGVEC_MAX_SEGMENTS; i++) {
+		free(segvec->segments[i]);
+	}
+	free(segvec);
+}
+
+int64_t segvec_len(const segvec_t *segvec) {
+	return ds_atomic_load(&segvec->len);
+}
+
+/** Find the segment and the offset within it of the element at index `index`,
+ * which must be nonnegative. Return false if it is past the last segment. */
+static bool segvec_locate(const segvec_t *segvec, int64_t index, int64_t *segment, int64_t *offset) {
+	// shifting by the first segment length makes segment s start at 2^(s + bits)
+	uint64_t shifted = (uint64_t)index + ((uint64_t)1 << segvec->first_segment_bits);
+	int64_t msb = ds_msb64(shifted);
+	*segment = msb - segvec->first_segment_bits;
+	*offset = (int64_t)(shifted - ((uint64_t)1 << msb));
+	return *segment < SEGVEC_MAX_SEGMENTS;
+}
+
+/** Return the number of elements of segment `segment` of `segvec`. */
+static size_t segvec_segment_len(const segvec_t *segvec, int64_t segment) {
+	return (size_t)1 << (segment + segvec->first_segment_bits);
+}
+
+/** Return the offset, in bytes, of the bitmap that follows the elements of
+ * segment `segment` of `segvec`, with one bit per slot set once its element
+ * has been written. */
+static size_t segvec_bitmap_offset(const segvec_t *segvec, int64_t segment) {
+	size_t size = segvec_segment_len(segvec, segment) * segvec->elem_size;
+	return (size + sizeof(int64_t) - 1) / sizeof(int64_t) * sizeof(int64_t);
+}
+
+/** Return the bitmap of written slots of segment `segment` of `segvec`, whose
+ * elements are at `contents`. */
+static volatile int64_t *segvec_written(const segvec_t *segvec, int8_t *contents, int64_t segment) {
+	return (volatile int64_t *)(contents + segvec_bitmap_offset(segvec, segment));
+}
+
+void *segvec_append(segvec_t *segvec, const void *value) {
+	int64_t index = ds_atomic_fetch_add(&segvec->len, 1);
+	int64_t segment, offset;
+	if (!segvec_locate(segvec, index, &segment, &offset)) return NULL;
+	int8_t *contents = ds_atomic_load_ptr(&segvec->segments[segment]);
+	if (!contents) {
+		// install the segment unless another thread beat us to it
+		size_t segment_len = segvec_segment_len(segvec, segment);
+		size_t bitmap_size = (segment_len + 63) / 64 * sizeof(int64_t);
+		int8_t *new_contents = malloc(segvec_bitmap_offset(segvec, segment) + bitmap_size);
+		if (!new_contents) return NULL;
+		memset((void *)segvec_written(segvec, new_contents, segment), 0, bitmap_size);
+		if (ds_atomic_cas_ptr(&segvec->segments[segment], NULL, new_contents)) {
+			contents = new_contents;
+		} else {
+			free(new_contents);
+			contents = ds_atomic_load_ptr(&segvec->segments[segment]);
+		}
+	}
+	int8_t *elem = ELEM_AT(contents, segvec->elem_size, offset);
+	memcpy(elem, value, segvec->elem_size);
+	// publish the element; slots whose append failed are never marked
+	volatile int64_t *word = &segvec_written(segvec, contents, segment)[offset / 64];
+	int64_t old;
+	do {
+		old = ds_atomic_load(word);
+	} while (!ds_atomic_cas(word, old, old | (int64_t)((uint64_t)1 << (offset % 64))));
+	return elem;
+}
+
+void *segvec_get(const segvec_t *segvec, int64_t index) {
+	int64_t len = ds_atomic_load(&segvec->len);
+	if (index < 0) index += len;
+	int64_t segment, offset;
+	if (index < 0 || index >= len || !segvec_locate(segvec, index, &segment, &offset)) return NULL;
+	int8_t *contents = ds_atomic_load_ptr(&segvec->segments[segment]);
+	if (!contents) return NULL;
+	uint64_t written = (uint64_t)ds_atomic_load(&segvec_written(segvec, contents, segment)[offset / 64]);
+	return written >> (offset % 64) & 1 ? ELEM_AT(contents, segvec->elem_size, offset) : NULL;
+}
+
+/* ----------------------- variable-length arraylist ----------------------- */
+
+/* Initial number of bytes the arena of a variable-length arraylist can hold */
+#define VARLIST_INIT_ARENA_LEN 64
+
+/* Minimum number of bytes of garbage in the arena of a variable-length
+   arraylist before a deletion compacts it */
+#define VARLIST_MIN_GARBAGE 4096
+
+/** Make room in the table of `varlist` for `count` more entries. Return false
+ * if there is insufficient memory. */
+static bool varlist_reserve_entries(varlist_t *varlist, int64_t count) {
+	if (varlist->len + count <= varlist->phys_len) return true;
+	int64_t phys_len = MAX(ARRAYLIST_GROWTH_FACTOR * varlist->phys_len, varlist->len + count);
+	varlist_entry_t *entries = realloc(varlist->entries, (size_t)phys_len * sizeof(varlist_entry_t));
+	if (!entries) return false;
+	varlist->entries = entries;
+	varlist->phys_len = phys_len;
+	return true;
+}
+
+/** Make room in the arena of `varlist` for `size` more bytes. Return false if
+ * there is insufficient memory. */
+static bool varlist_reserve_bytes(varlist_t *varlist, int64_t size) {
+	if (varlist->arena_len + size <= varlist->arena_phys_len) return true;
+	int64_t phys_len = MAX(ARRAYLIST_GROWTH_FACTOR * varlist->arena_phys_len, varlist->arena_len + size);
+	int8_t *arena = realloc(varlist->arena, (size_t)phys_len);
+	if (!arena) return false;
+	varlist->arena = arena;
+	varlist->arena_phys_len = phys_len;
+	return true;
+}
+
+/** Append an element whose room was already reserved. */
+static void varlist_append_unchecked(varlist_t *varlist, const void *value, int64_t len) {
+	memcpy(varlist->arena + varlist->arena_len, value, (size_t)len);
+	varlist->entries[varlist->len++] = (varlist_entry_t){ varlist->arena_len, len };
+	varlist->arena_len += len;
+}
+
+/** Compare the elements of `varlist` at entries `a` and `b`. */
+static int64_t varlist_compare(const varlist_t *varlist, const varlist_entry_t *a, const varlist_entry_t *b) {
+	const int8_t *value_a = varlist->arena + a->offset, *value_b = varlist->arena + b->offset;
+	if (varlist->cmp_func) return varlist->cmp_func(value_a, (size_t)a->len, value_b, (size_t)b->len);
+	int cmp = memcmp(value_a, value_b, (size_t)MIN(a->len, b->len));
+	return cmp ? cmp : a->len - b->len;
+}
+
+varlist_t *varlist_new(varlist_cmp_func_t cmp_func) {
+	varlist_t *varlist = malloc(sizeof(varlist_t));
+	if (!varlist) return NULL;
+	varlist->len = 0;
+	varlist->phys_len = ARRAYLIST_INIT_LEN;
+	varlist->arena_len = 0;
+	varlist->arena_phys_len = VARLIST_INIT_ARENA_LEN;
+	varlist->garbage = 0;
+	varlist->cmp_func = cmp_func;
+	varlist->entries = malloc((size_t)varlist->phys_len * sizeof(varlist_entry_t));
+	varlist->arena = malloc((size_t)varlist->arena_phys_len);
+	if (!varlist->entries || !varlist->arena) {
+		varlist_free(varlist);
+		return NULL;
+	}
+	return varlist;
+}
+
+void varlist_free(varlist_t *varlist) {
+	free(varlist->entries);
+	free(varlist->arena);
+	free(varlist);
+}
+
+int64_t varlist_len(const varlist_t *varlist) {
+	return varlist->len;
+}
+
+bool varlist_append(varlist_t *varlist, const void *value, size_t len) {
+	if (!varlist_reserve_entries(varlist, 1) || !varlist_reserve_bytes(varlist, (int64_t)len)) return false;
+	varlist_append_unchecked(varlist, value, (int64_t)len);
+	return true;
+}
+
+const void *varlist_get(const varlist_t *varlist, int64_t index, size_t *len) {
+	if (index < 0) index += varlist->len;
+	if (index < 0 || index >= varlist->len) return NULL;
+	if (len) *len = (size_t)varlist->entries[index].len;
+	return varlist->arena + varlist->entries[index].offset;
+}
+
+bool varlist_delete(varlist_t *varlist, int64_t index) {
+	if (index < 0) index += varlist->len;
+	if (index < 0 || index >= varlist->len) return false;
+	varlist->garbage += varlist->entries[index].len;
+	memmove(varlist->entries + index, varlist->entries + index + 1, (size_t)(varlist->len - index - 1) * sizeof(varlist_entry_t));
+	varlist->len--;
+	if (varlist->garbage >= VARLIST_MIN_GARBAGE && varlist->garbage > varlist->arena_len / 2) {
+		// failing to compact only leaves the garbage in place
+		varlist_compact(varlist);
+	}
+	return true;
+}
+
+void varlist_clear(varlist_t *varlist) {
+	varlist->len = 0;
+	varlist->arena_len = 0;
+	varlist->garbage = 0;
+}
+
+bool varlist_compact(varlist_t *varlist) {
+	int64_t arena_phys_len = MAX(varlist->arena_len - varlist->garbage, VARLIST_INIT_ARENA_LEN);
+	int8_t *arena = malloc((size_t)arena_phys_len);
+	if (!arena) return false;
+	int64_t arena_len = 0;
+	for (int64_t i = 0; i < varlist->len; i++) {
+		varlist_entry_t *entry = &varlist->entries[i];
+		memcpy(arena + arena_len, varlist->arena + entry->offset, (size_t)entry->len);
+		entry->offset = arena_len;
+		arena_len += entry->len;
+	}
+	free(varlist->arena);
+	varlist->arena = arena;
+	varlist->arena_len = arena_len;
+	varlist->arena_phys_len = arena_phys_len;
+	varlist->garbage = 0;
+	return true;
+}
+
+bool varlist_sort(varlist_t *varlist) {
+	int64_t len = varlist->len;
+	varlist_entry_t *buffer = malloc((size_t)MAX(len, 1) * sizeof(varlist_entry_t));
+	if (!buffer) return false;
+	// insertion sort blocks of entries, then merge them back and forth between
+	// the table and the buffer, as arraylist_argsort does
+	const int64_t block = 32;
+	varlist_entry_t *entries = varlist->entries;
+	for (int64_t start = 0; start < len; start += block) {
+		int64_t end = MIN(start + block, len);
+		for (int64_t i = start + 1; i < end; i++) {
+			varlist_entry_t entry = entries[i];
+			int64_t j = i;
+			for (; j > start && varlist_compare(varlist, &entry, &entries[j - 1]) < 0; j--) {
+				entries[j] = entries[j - 1];
+			}
+			entries[j] = entry;
+		}
+	}
+	varlist_entry_t *src = entries, *dst = buffer;
+	for (int64_t width = block; width < len; width *= 2) {
+		for (int64_t start = 0; start < len; start += 2 * width) {
+			int64_t mid = MIN(start + width, len), end = MIN(start + 2 * width, len);
+			int64_t a = start, b = mid, out = start;
+			while (a < mid && b < end) {
+				dst[out++] = varlist_compare(varlist, &src[b], &src[a]) < 0 ? src[b++] : src[a++];
+			}
+			memcpy(dst + out, src + a, (size_t)(mid - a) * sizeof(varlist_entry_t));
+			memcpy(dst + out + mid - a, src + b, (size_t)(end - b) * sizeof(varlist_entry_t));
+		}
+		varlist_entry_t *swap = src;
+		src = dst;
+		dst = swap;
+	}
+	if (src != entries) memcpy(entries, src, (size_t)len * sizeof(varlist_entry_t));
+	free(buffer);
+	return true;
+}
+
+bool varlist_import_delimited(varlist_t *varlist, const void *buffer, size_t size, char delimiter) {
+	const int8_t *start = buffer, *end = start + size;
+	// count the elements first so that the table and arena grow only once
+	int64_t count = 0;
+	for (const int8_t *p = start; p < end; count++) {
+		const int8_t *next = memchr(p, delimiter, (size_t)(end - p));
+		if (!next) break;
+		p = next + 1;
+	}
+	if (!varlist_reserve_entries(varlist, count + 1) || !varlist_reserve_bytes(varlist, (int64_t)size)) return false;
+	while (start < end) {
+		const int8_t *next = memchr(start, delimiter, (size_t)(end - start));
+		if (!next) next = end;
+		varlist_append_unchecked(varlist, start, next - start);
+		start = next + 1;
+	}
+	return true;
+}
+
+bool varlist_import_length_prefixed(varlist_t *varlist, const void *buffer, size_t size) {
+	const int8_t *start = buffer, *end = start + size;
+	// validate the lengths and count the elements before appending any
+	int64_t count = 0;
+	for (const int8_t *p = start; p < end; count++) {
+		uint32_t len;
+		if ((size_t)(end - p) < sizeof(len)) return false;
+		memcpy(&len, p, sizeof(len));
+		p += sizeof(len);
+		if ((size_t)(end - p) < len) return false;
+		p += len;
+	}
+	if (!varlist_reserve_entries(varlist, count) || !varlist_reserve_bytes(varlist, (int64_t)size)) return false;
+	while (start < end) {
+		uint32_t len;
+		memcpy(&len, start, sizeof(len));
+		varlist_append_unchecked(varlist, start + sizeof(len), len);
+		start += sizeof(len) + len;
+	}
+	return true;
+}
+
+/* ----------------------------- search index ----------------------------- */
+
+/* Number of levels below the current node of a search index whose first node
+   is prefetched while searching, so that 16 small elements share a cache line */
+#define SEARCHINDEX_PREFETCH_LEVELS 4
+
+/** Copy the elements of the sorted `arraylist` starting at index `*next` into
+ * the subtree of `index` rooted at slot `slot`, in order. */
+static void searchindex_fill(searchindex_t *index, const arraylist_t *arraylist, int64_t slot, int64_t *next) {
+	if (slot > index->len) return;
+	searchindex_fill(index, arraylist, 2 * slot, next);
+	memcpy(ELEM_AT(index->elements, index->elem_size, slot), ARRAYLIST_GET_UNCHECKED(arraylist, *next), index->elem_size);
+	index->indices[slot] = (*next)++;
+	searchindex_fill(index, arraylist, 2 * slot + 1, next);
+}
+
+searchindex_t *arraylist_build_search_index(const arraylist_t *arraylist) {
+	PROFILE_FUNCTION();
+	searchindex_t *index = malloc(sizeof(searchindex_t));
+	if (!index) return NULL;
+	index->len = arraylist->len;
+	index->elem_size = arraylist->elem_size;
+	index->cmp_func = arraylist->cmp_func;
+	// slot 0 is unused so that the children of slot k are 2k and 2k + 1
+	size_t size = (size_t)(index->len + 1) * index->elem_size;
+#ifdef _WIN32
+	index->elements = _aligned_malloc(MAX(size, 1), CACHE_LINE_SIZE);
+#else
+	if (posix_memalign((void **)&index->elements, CACHE_LINE_SIZE, MAX(size, 1))) index->elements = NULL;
+#endif
+	index->indices = malloc((size_t)(index->len + 1) * sizeof(int64_t));
+	if (!index->elements || !index->indices) {
+		searchindex_free(index);
+		return NULL;
+	}
+	int64_t next = 0;
+	searchindex_fill(index, arraylist, 1, &next);
+	return index;
+}
+
+void searchindex_free(searchindex_t *index) {
+#ifdef _WIN32
+	_aligned_free(index->elements);
+#else
+	free(index->elements);
+#endif
+	free(index->indices);
+	free(index);
+}
+
+int64_t searchindex_len(const searchindex_t *index) {
+	return index->len;
+}
+
+int64_t searchindex_lower_bound(const searchindex_t *index, const void *value) {
+	int64_t slot = 1;
+	while (slot <= index->len) {
+		if (slot << SEARCHINDEX_PREFETCH_LEVELS <= index->len) {
+			ds_prefetch(ELEM_AT(index->elements, index->elem_size, slot << SEARCHINDEX_PREFETCH_LEVELS));
+		}
+		slot = 2 * slot + (index->cmp_func(ELEM_AT(index->elements, index->elem_size, slot), value) < 0);
+	}
+	// the answer is the last node where the search went left, so drop the
+	// trailing right turns and that left turn
+	slot >>= ds_ctz64(~(uint64_t)slot) + 1;
+	return slot ? index->indices[slot] : index->len;
+}
+
+/* ------------------------ compressed integer list ------------------------ */
+
+/* Number of packed deltas in a block of a compressed integer list, one for each
+   value after the first */
+#define INTLIST_NUM_DELTAS (INTLIST_BLOCK_LEN - 1)
+
+/** Return the number of words holding the packed deltas of a block whose
+ * deltas are `width` bits wide. */
+static int64_t intlist_block_words(int64_t width) {
+	return (INTLIST_NUM_DELTAS * width + 63) / 64;
+}
+
+/** Pack the INTLIST_NUM_DELTAS values at `src`, each less than 2^`width`, into
+ * the zeroed words at `dest`, least significant bits first. */
+static void intlist_pack(uint64_t *dest, const uint64_t *src, int64_t width) {
+	if (!width) return;
+	for (int64_t i = 0; i < INTLIST_NUM_DELTAS; i++) {
+		int64_t bit = i * width;
+		int64_t word = bit >> 6, shift = bit & 63;
+		dest[word] |= src[i] << shift;
+		if (shift + width > 64) dest[word + 1] |= src[i] >> (64 - shift);
+	}
+}
+
+/** Unpack the INTLIST_NUM_DELTAS values of `width` bits packed at `src` into
+ * `dest`. */
+static void intlist_unpack(uint64_t *dest, const uint64_t *src, int64_t width) {
+	if (!width) {
+		memset(dest, 0, INTLIST_NUM_DELTAS * sizeof(uint64_t));
+		return;
+	}
+	uint64_t mask = width == 64 ? ~(uint64_t)0 : ((uint64_t)1 << width) - 1;
+	for (int64_t i = 0; i < INTLIST_NUM_DELTAS; i++) {
+		int64_t bit = i * width;
+		int64_t word = bit >> 6, shift = bit & 63;
+		uint64_t value = src[word] >> shift;
+		if (shift + width > 64) value |= src[word + 1] << (64 - shift);
+		dest[i] = value & mask;
+	}
+}
+
+/** Decode the values of block `block` of `intlist` into `dest`. The deltas are
+ * unpacked in one loop and summed in another. Both loops are scalar: the word
+ * and shift of each delta depend on the width at run time, so compilers do
+ * not vectorize the unpack, and a branch-free variant was no faster. */
+static void intlist_decode(const intlist_t *intlist, int64_t block, int64_t *dest) {
+	const intlist_block_t *header = &intlist->blocks[block];
+	uint64_t deltas[INTLIST_NUM_DELTAS];
+	intlist_unpack(deltas, intlist->words + header->offset, header->width);
+	// unsigned arithmetic wraps around like the encoding did
+	uint64_t value = (uint64_t)header->first;
+	dest[0] = header->first;
+	for (int64_t i = 0; i < INTLIST_NUM_DELTAS; i++) {
+		value += deltas[i] + (uint64_t)header->min_delta;
+		dest[i + 1] = (int64_t)value;
+	}
+}
+
+/** Compress the full tail of `intlist` into a new block. Return false if there
+ * is insufficient memory. */
+static bool intlist_flush(intlist_t *intlist) {
+	uint64_t deltas[INTLIST_NUM_DELTAS];
+	int64_t min_delta = INT64_MAX;
+	for (int64_t i = 0; i < INTLIST_NUM_DELTAS; i++) {
+		int64_t delta = (int64_t)((uint64_t)intlist->tail[i + 1] - (uint64_t)intlist->tail[i]);
+		deltas[i] = (uint64_t)delta;
+		min_delta = MIN(min_delta, delta);
+	}
+	uint64_t max_offset = 0;
+	for (int64_t i = 0; i < INTLIST_NUM_DELTAS; i++) {
+		deltas[i] -= (uint64_t)min_delta;
+		max_offset = MAX(max_offset, deltas[i]);
+	}
+	int64_t width = max_offset ? ds_msb64(max_offset) + 1 : 0;
+	int64_t num_words = intlist_block_words(width);
+	if (intlist->num_blocks == intlist->phys_blocks) {
+		int64_t phys_blocks = MAX(ARRAYLIST_GROWTH_FACTOR * intlist->phys_blocks, ARRAYLIST_INIT_LEN);
+		intlist_block_t *blocks = realloc(intlist->blocks, (size_t)phys_blocks * sizeof(intlist_block_t));
+		if (!blocks) return false;
+		intlist->blocks = blocks;
+		intlist->phys_blocks = phys_blocks;
+	}
+	if (intlist->num_words + num_words > intlist->phys_words) {
+		int64_t phys_words = MAX(ARRAYLIST_GROWTH_FACTOR * intlist->phys_words, intlist->num_words + num_words);
+		uint64_t *words = realloc(intlist->words, (size_t)phys_words * sizeof(uint64_t));
+		if (!words) return false;
+		intlist->words = words;
+		intlist->phys_words = phys_words;
+	}
+	// blocks of equal deltas take no words, and `words` may still be NULL
+	if (num_words) {
+		memset(intlist->words + intlist->num_words, 0, (size_t)num_words * sizeof(uint64_t));
+		intlist_pack(intlist->words + intlist->num_words, deltas, width);
+	}
+	intlist->blocks[intlist->num_blocks++] = (intlist_block_t){ intlist->tail[0], min_delta, intlist->num_words, width };
+	intlist->num_words += num_words;
+	return true;
+}
+
+intlist_t *intlist_new(void) {
+	return calloc(1, sizeof(intlist_t));
+}
+
+void intlist_free(intlist_t *intlist) {
+	free(intlist->blocks);
+	free(intlist->words);
+	free(intlist);
+}
+
+int64_t intlist_len(const intlist_t *intlist) {
+	return intlist->len;
+}
+
+int64_t intlist_size(const intlist_t *intlist) {
+	return (int64_t)sizeof(intlist_t) + intlist->phys_blocks * (int64_t)sizeof(intlist_block_t) +
+		intlist->phys_words * (int64_t)sizeof(uint64_t);
+}
+
+bool intlist_append(intlist_t *intlist, int64_t value) {
+	int64_t tail_len = intlist->len - intlist->num_blocks * INTLIST_BLOCK_LEN;
+	intlist->tail[tail_len] = value;
+	if (tail_len + 1 == INTLIST_BLOCK_LEN && !intlist_flush(intlist)) return false;
+	intlist->len++;
+	return true;
+}
+
+bool intlist_get(const intlist_t *intlist, int64_t index, int64_t *dest) {
+	if (index < 0) index += intlist->len;
+	if (index < 0 || index >= intlist->len) return false;
+	int64_t block = index / INTLIST_BLOCK_LEN;
+	if (block == intlist->num_blocks) {
+		*dest = intlist->tail[index % INTLIST_BLOCK_LEN];
+		return true;
+	}
+	int64_t values[INTLIST_BLOCK_LEN];
+	intlist_decode(intlist, block, values);
+	*dest = values[index % INTLIST_BLOCK_LEN];
+	return true;
+}
+
+/** Return the first value of block `block` of `intlist`, where the block after
+ * the last full one is the tail. */
+static int64_t intlist_block_first(const intlist_t *intlist, int64_t block) {
+	return block < intlist->num_blocks ? intlist->blocks[block].first : intlist->tail[0];
+}
+
+int64_t intlist_lower_bound(const intlist_t *intlist, int64_t value) {
+	// find the first block starting at or after `value`; the answer is in the
+	// block before it or is its first value
+	int64_t num_blocks = (intlist->len + INTLIST_BLOCK_LEN - 1) / INTLIST_BLOCK_LEN;
+	int64_t lo = 0, hi = num_blocks;
+	while (lo < hi) {
+		int64_t mid = lo + (hi - lo) / 2;
+		if (intlist_block_first(intlist, mid) < value) lo = mid + 1;
+		else hi = mid;
+	}
+	if (!lo) return 0;
+	int64_t block = lo - 1;
+	int64_t values[INTLIST_BLOCK_LEN];
+	const int64_t *block_values = intlist->tail;
+	int64_t block_len = intlist->len - block * INTLIST_BLOCK_LEN;
+	if (block < intlist->num_blocks) {
+		intlist_decode(intlist, block, values);
+		block_values = values;
+		block_len = INTLIST_BLOCK_LEN;
+	}
+	int64_t i = 1;
+	while (i < block_len && block_values[i] < value) i++;
+	return block * INTLIST_BLOCK_LEN + i;
+}
+
+intlist_t *intlist_from_arraylist(const arraylist_t *arraylist) {
+	if (arraylist->elem_size != sizeof(int64_t)) return NULL;
+	intlist_t *intlist = intlist_new();
+	if (!intlist) return NULL;
+	for (const int64_t *value = (const int64_t *)arraylist->contents; value < (const int64_t *)arraylist->end; value++) {
+		if (!intlist_append(intlist, *value)) {
+			intlist_free(intlist);
+			return NULL;
+		}
+	}
+	return intlist;
+}
+
+bool intlist_to_arraylist(const intlist_t *intlist, arraylist_t *dest) {
+	if (dest->elem_size != sizeof(int64_t) || !arraylist_unshare(dest) || !arraylist_reserve(dest, MAX(intlist->len, 1))) return false;
+	int64_t *values = (int64_t *)dest->contents;
+	for (int64_t block = 0; block < intlist->num_blocks; block++) {
+		intlist_decode(intlist, block, values + block * INTLIST_BLOCK_LEN);
+	}
+	memcpy(values + intlist->num_blocks * INTLIST_BLOCK_LEN, intlist->tail,
+		(size_t)(intlist->len - intlist->num_blocks * INTLIST_BLOCK_LEN) * sizeof(int64_t));
+	dest->len = intlist->len;
+	dest->end = ARRAYLIST_GET_UNCHECKED(dest, dest->len);
+	arraylist_bloom_invalidate(dest);
+	return true;
+}
+
+intlist_iter_t *intlist_iter_new(const intlist_t *intlist) {
+	intlist_iter_t *iter = malloc(sizeof(intlist_iter_t));
+	if (!iter) return NULL;
+	iter->intlist = intlist;
+	iter->index = 0;
+	return iter;
+}
+
+void intlist_iter_free(intlist_iter_t *iter) {
+	free(iter);
+}
+
+const int64_t *intlist_iter_next(intlist_iter_t *iter) {
+	const intlist_t *intlist = iter->intlist;
+	if (iter->index >= intlist->len) return NULL;
+	int64_t block = iter->index / INTLIST_BLOCK_LEN, offset = iter->index++ % INTLIST_BLOCK_LEN;
+	if (block == intlist->num_blocks) return &intlist->tail[offset];
+	if (!offset) intlist_decode(intlist, block, iter->values);
+	return &iter->values[offset];
+}
+
+void intlist_iter_reset(intlist_iter_t *iter) {
+	iter->index = 0;
+}
+
+/* -------------------------------- bitset -------------------------------- */
+
+/* Number of bits in a word of a bitset */
+#define BITSET_WORD_BITS 64
+
+/* Initial number of words a bitset can hold */
+#define BITSET_INIT_WORDS 1
+
+/* Number of words needed to hold `len` bits */
+#define BITSET_NUM_WORDS(len) (((len) + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS)
+
+/* Mask of bit `index` within its word */
+#define BITSET_MASK(index) ((uint64_t)1 << ((index) % BITSET_WORD_BITS))
+
+/* Number of bits per rank directory entry, one cache line of words */
+#define BITSET_RANK_BLOCK_BITS 512
+
+/** Clear the bits of the last word of `bitset` past its length, which every
+ * operation relies on being 0. */
+static void bitset_trim(bitset_t *bitset) {
+	if (bitset->len % BITSET_WORD_BITS) {
+		bitset->words[bitset->len / BITSET_WORD_BITS] &= BITSET_MASK(bitset->len) - 1;
+	}
+}
+
+/** Record that the bit at `index` of `bitset` may have changed, so rank
+ * directory entries of later blocks are no longer up to date. */
+static void bitset_invalidate_rank(bitset_t *bitset, int64_t index) {
+	int64_t block = index / BITSET_RANK_BLOCK_BITS;
+	if (block < bitset->rank_blocks) bitset->rank_blocks = block + 1;
+}
+
+bitset_t *bitset_new(int64_t len) {
+	bitset_t *bitset = malloc(sizeof(bitset_t));
+	if (!bitset) return NULL;
+	bitset->phys_words = MAX(BITSET_NUM_WORDS(len), BITSET_INIT_WORDS);
+	if (!(bitset->words = calloc((size_t)bitset->phys_words, sizeof(uint64_t)))) {
+		free(bitset);
+		return NULL;
+	}
+	bitset->len = len;
+	bitset->rank_dir = NULL;
+	bitset->rank_blocks = 0;
+	return bitset;
+}
+
+void bitset_free(bitset_t *bitset) {
+	free(bitset->words);
+	free(bitset->rank_dir);
+	free(bitset);
+}
+
+int64_t bitset_len(const bitset_t *bitset) {
+	return bitset->len;
+}
+
+bool bitset_resize(bitset_t *bitset, int64_t len) {
+	int64_t num_words = BITSET_NUM_WORDS(len);
+	if (num_words > bitset->phys_words) {
+		int64_t phys_words = MAX(num_words, ARRAYLIST_GROWTH_FACTOR * bitset->phys_words);
+		uint64_t *words = realloc(bitset->words, (size_t)phys_words * sizeof(uint64_t));
+		if (!words) return false;
+		memset(words + bitset->phys_words, 0, (size_t)(phys_words - bitset->phys_words) * sizeof(uint64_t));
+		bitset->words = words;
+		bitset->phys_words = phys_words;
+	}
+	if (len < bitset->len) {
+		int64_t old_num_words = BITSET_NUM_WORDS(bitset->len);
+		memset(bitset->words + num_words, 0, (size_t)(old_num_words - num_words) * sizeof(uint64_t));
+		bitset_invalidate_rank(bitset, len);
+	}
+	bitset->len = len;
+	bitset_trim(bitset);
+	return true;
+}
+
+bool bitset_append(bitset_t *bitset, bool value) {
+	if (!bitset_resize(bitset, bitset->len + 1)) return false;
+	if (value) {
+		bitset->words[(bitset->len - 1) / BITSET_WORD_BITS] |= BITSET_MASK(bitset->len - 1);
+		bitset_invalidate_rank(bitset, bitset->len - 1);
+	}
+	return true;
+}
+
+bool bitset_set(bitset_t *bitset, int64_t index) {
+	if (index < 0 || index >= bitset->len) return false;
+	bitset->words[index / BITSET_WORD_BITS] |= BITSET_MASK(index);
+	bitset_invalidate_rank(bitset, index);
+	return true;
+}
+
+bool bitset_clear(bitset_t *bitset, int64_t index) {
+	if (index < 0 || index >= bitset->len) return false;
+	bitset->words[index / BITSET_WORD_BITS] &= ~BITSET_MASK(index);
+	bitset_invalidate_rank(bitset, index);
+	return true;
+}
+
+bool bitset_test(const bitset_t *bitset, int64_t index) {
+	if (index < 0 || index >= bitset->len) return false;
+	return (bitset->words[index / BITSET_WORD_BITS] & BITSET_MASK(index)) != 0;
+}
+
+void bitset_fill(bitset_t *bitset, bool value) {
+	memset(bitset->words, value ? 0xFF : 0, (size_t)BITSET_NUM_WORDS(bitset->len) * sizeof(uint64_t));
+	bitset_trim(bitset);
+	bitset_invalidate_rank(bitset, 0);
+}
+
+int64_t bitset_count(const bitset_t *bitset, int64_t start, int64_t end) {
+	normalize_slice(bitset->len, &start, &end);
+	if (start >= end) return 0;
+	int64_t first = start / BITSET_WORD_BITS, last = (end - 1) / BITSET_WORD_BITS;
+	uint64_t first_mask = ~(BITSET_MASK(start) - 1);
+	uint64_t last_mask = end % BITSET_WORD_BITS ? BITSET_MASK(end) - 1 : ~(uint64_t)0;
+	if (first == last) return ds_popcount64(bitset->words[first] & first_mask & last_mask);
+	int64_t count = ds_popcount64(bitset->words[first] & first_mask) + ds_popcount64(bitset->words[last] & last_mask);
+	for (int64_t i = first + 1; i < last; i++) {
+		count += ds_popcount64(bitset->words[i]);
+	}
+	return count;
+}
+
+bool bitset_build_rank(bitset_t *bitset) {
+	int64_t num_blocks = (bitset->len + BITSET_RANK_BLOCK_BITS - 1) / BITSET_RANK_BLOCK_BITS;
+	int64_t *rank_dir = realloc(bitset->rank_dir, (size_t)MAX(num_blocks, 1) * sizeof(int64_t));
+	if (!rank_dir) return false;
+	int64_t count = 0;
+	for (int64_t block = 0; block < num_blocks; block++) {
+		rank_dir[block] = count;
+		count += bitset_count(bitset, block * BITSET_RANK_BLOCK_BITS, MIN((block + 1) * BITSET_RANK_BLOCK_BITS, bitset->len));
+	}
+	bitset->rank_dir = rank_dir;
+	bitset->rank_blocks = num_blocks;
+	return true;
+}
+
+int64_t bitset_rank(const bitset_t *bitset, int64_t index) {
+	index = MIN(MAX(index, 0), bitset->len);
+	// start from the entry of the block holding `index`, or the last valid one
+	int64_t block = MIN(index / BITSET_RANK_BLOCK_BITS, bitset->rank_blocks - 1);
+	if (block < 0) return bitset_count(bitset, 0, index);
+	return bitset->rank_dir[block] + bitset_count(bitset, block * BITSET_RANK_BLOCK_BITS, index);
+}
+
+int64_t bitset_select(const bitset_t *bitset, int64_t rank) {
+	if (rank < 0) return -1;
+	int64_t num_words = BITSET_NUM_WORDS(bitset->len), i = 0;
+	if (bitset->rank_blocks > 0) {
+		// find the last valid block with at most `rank` set bits before it
+		int64_t low = 0, high = bitset->rank_blocks;
+		while (high - low > 1) {
+			int64_t mid = low + (high - low) / 2;
+			if (bitset->rank_dir[mid] <= rank) low = mid;
+			else high = mid;
+		}
+		rank -= bitset->rank_dir[low];
+		i = low * (BITSET_RANK_BLOCK_BITS / BITSET_WORD_BITS);
+	}
+	for (; i < num_words; i++) {
+		int64_t count = ds_popcount64(bitset->words[i]);
+		if (rank < count) {
+			uint64_t word = bitset->words[i];
+			for (; rank; rank--) word &= word - 1;
+			return i * BITSET_WORD_BITS + ds_ctz64(word);
+		}
+		rank -= count;
+	}
+	return -1;
+}
+
+int64_t bitset_next_set(const bitset_t *bitset, int64_t index) {
+	if (index < 0) index = 0;
+	if (index >= bitset->len) return -1;
+	int64_t i = index / BITSET_WORD_BITS, num_words = BITSET_NUM_WORDS(bitset->len);
+	uint64_t word = bitset->words[i] & ~(BITSET_MASK(index) - 1);
+	while (!word) {
+		if (++i == num_words) return -1;
+		word = bitset->words[i];
+	}
+	return i * BITSET_WORD_BITS + ds_ctz64(word);
+}
+
+int64_t bitset_next_clear(const bitset_t *bitset, int64_t index) {
+	if (index < 0) index = 0;
+	if (index >= bitset->len) return -1;
+	int64_t i = index / BITSET_WORD_BITS, num_words = BITSET_NUM_WORDS(bitset->len);
+	uint64_t word = ~bitset->words[i] & ~(BITSET_MASK(index) - 1);
+	while (!word) {
+		if (++i == num_words) return -1;
+		word = ~bitset->words[i];
+	}
+	index = i * BITSET_WORD_BITS + ds_ctz64(word);
+	return index < bitset->len ? index : -1;
+}
+
+/* Apply `dest->words[i] = dest->words[i] OP src->words[i]` over the words of
+   `dest`, treating words past the end of `src` as 0. Written as plain word
+   loops so that compilers vectorize them. */
+#define BITSET_COMBINE(dest, src, OP) \
+	do { \
+		uint64_t *dest_words = (dest)->words; \
+		const uint64_t *src_words = (src)->words; \
+		int64_t num_words = BITSET_NUM_WORDS((dest)->len); \
+		int64_t common = MIN(num_words, BITSET_NUM_WORDS((src)->len)); \
+		for (int64_t i = 0; i < common; i++) { \
+			dest_words[i] = dest_words[i] OP src_words[i]; \
+		} \
+		for (int64_t i = common; i < num_words; i++) { \
+			dest_words[i] = dest_words[i] OP 0; \
+		} \
+		bitset_trim(dest); \
+		bitset_invalidate_rank(dest, 0); \
+	} while (0)
+
+void bitset_and(bitset_t *dest, const bitset_t *src) {
+	BITSET_COMBINE(dest, src, &);
+}
+
+void bitset_or(bitset_t *dest, const bitset_t *src) {
+	BITSET_COMBINE(dest, src, |);
+}
+
+void bitset_xor(bitset_t *dest, const bitset_t *src) {
+	BITSET_COMBINE(dest, src, ^);
+}
+
+void bitset_andnot(bitset_t *dest, const bitset_t *src) {
+	BITSET_COMBINE(dest, src, & ~);
+}
+
+/* --------------------------- persistent vector --------------------------- */
+
+/* Number of index bits consumed by each level of a persistent vector tree */
+#define PVECTOR_BITS 5
+
+/* Number of children of a branch node and of elements of a leaf node */
+#define PVECTOR_WIDTH (1 << PVECTOR_BITS)
+
+#define PVECTOR_MASK (PVECTOR_WIDTH - 1)
+
+struct pvector_node_t {
+	volatile int64_t refcount;	// number of references from versions and parent nodes
+	int64_t owner;				// id of the transient that may modify the node in place, 0 if none
+	int8_t data[];				// PVECTOR_WIDTH child pointers for a branch, PVECTOR_WIDTH elements for a leaf
+};
+
+/* Array of child pointers of branch node `node` */
+#define PVECTOR_CHILDREN(node) ((pvector_node_t **)(node)->data)
+
+/* Pointer to element `i` of leaf node `node` of `pvector`. No bounds checking
+   is done. */
+#define PVECTOR_VALUE(pvector, node, i) ((node)->data + (i) * (int64_t)(pvector)->elem_size)
+
+/* Last transient id handed out */
+static volatile int64_t pvector_last_owner = 0;
+
+/** Return a new branch node with no children owned by `owner`, NULL if there
+ * is insufficient memory. */
+static pvector_node_t *pvector_branch_new(int64_t owner) {
+	pvector_node_t *node = calloc(1, sizeof(pvector_node_t) + PVECTOR_WIDTH * sizeof(pvector_node_t *));
+	if (!node) return NULL;
+	node->refcount = 1;
+	node->owner = owner;
+	return node;
+}
+
+/** Return a new uninitialized leaf node of `pvector` owned by `owner`, NULL if
+ * there is insufficient memory. */
+static pvector_node_t *pvector_leaf_new(const pvector_t *pvector, int64_t owner) {
+	pvector_node_t *node = malloc(sizeof(pvector_node_t) + PVECTOR_WIDTH * pvector->elem_size);
+	if (!node) return NULL;
+	node->refcount = 1;
+	node->owner = owner;
+	return node;
+}
+
+static void pvector_node_retain(pvector_node_t *node) {
+	if (node) ds_atomic_fetch_add(&node->refcount, 1);
+}
+
+/** Drop a reference to `node`, which is at height `level` in the tree (0 for a
+ * leaf). Free the node and release its children if it was the last one. */
+static void pvector_node_release(pvector_node_t *node, int level) {
+	if (!node || ds_atomic_fetch_add(&node->refcount, -1) > 1) return;
+	if (level > 0) {
+		for (int i = 0; i < PVECTOR_WIDTH; i++) {
+			pvector_node_release(PVECTOR_CHILDREN(node)[i], level - PVECTOR_BITS);
+		}
+	}
+	free(node);
+}
+
+/** Return `node` itself if the transient `owner` may modify it in place.
+ * Otherwise return a copy of `node` owned by `owner` holding its own reference
+ * to each child, NULL if there is insufficient memory. Persistent operations
+ * pass an `owner` of 0 and always get a copy. */
+static pvector_node_t *pvector_node_editable(const pvector_t *pvector, pvector_node_t *node, int level, int64_t owner) {
+	if (owner && node->owner == owner) return node;
+	pvector_node_t *copy;
+	if (level > 0) {
+		if (!(copy = pvector_branch_new(owner))) return NULL;
+		memcpy(PVECTOR_CHILDREN(copy), PVECTOR_CHILDREN(node), PVECTOR_WIDTH * sizeof(pvector_node_t *));
+		for (int i = 0; i < PVECTOR_WIDTH; i++) {
+			pvector_node_retain(PVECTOR_CHILDREN(copy)[i]);
+		}
+	} else {
+		if (!(copy = pvector_leaf_new(pvector, owner))) return NULL;
+		memcpy(copy->data, node->data, PVECTOR_WIDTH * pvector->elem_size);
+	}
+	return copy;
+}
+
+/** Store `child` as child `index` of the editable branch `node`, releasing the
+ * child it replaces. */
+static void pvector_node_replace_child(pvector_node_t *node, int64_t index, pvector_node_t *child, int child_level) {
+	if (PVECTOR_CHILDREN(node)[index] == child) return;
+	pvector_node_release(PVECTOR_CHILDREN(node)[index], child_level);
+	PVECTOR_CHILDREN(node)[index] = child;
+}
+
+/** Return the index of the first element of `pvector` stored in its tail. */
+static int64_t pvector_tailoff(const pvector_t *pvector) {
+	return pvector->len < PVECTOR_WIDTH ? 0 : ((pvector->len - 1) >> PVECTOR_BITS) << PVECTOR_BITS;
+}
+
+/** Return the leaf node of `pvector` holding element `index`, which must be a
+ * valid non-negative index. */
+static pvector_node_t *pvector_leaf_for(const pvector_t *pvector, int64_t index) {
+	if (index >= pvector_tailoff(pvector)) return pvector->tail;
+	pvector_node_t *node = pvector->root;
+	for (int level = pvector->shift; level > 0; level -= PVECTOR_BITS) {
+		node = PVECTOR_CHILDREN(node)[(index >> level) & PVECTOR_MASK];
+	}
+	return node;
+}
+
+/** Return `node` at height `level`, modified in place or copied for `owner`,
+ * with element `index` of its subtree set to `value`. Return NULL if there is
+ * insufficient memory, in which case nothing is modified. */
+static pvector_node_t *pvector_do_set(const pvector_t *pvector, pvector_node_t *node, int level, int64_t index, const void *value, int64_t owner) {
+	pvector_node_t *result = pvector_node_editable(pvector, node, level, owner);
+	if (!result) return NULL;
+	if (level == 0) {
+		memmove(PVECTOR_VALUE(pvector, result, index & PVECTOR_MASK), value, pvector->elem_size);
+		return result;
+	}
+	int64_t sub = (index >> level) & PVECTOR_MASK;
+	pvector_node_t *child = pvector_do_set(pvector, PVECTOR_CHILDREN(result)[sub], level - PVECTOR_BITS, index, value, owner);
+	if (!child) {
+		if (result != node) pvector_node_release(result, level);
+		return NULL;
+	}
+	pvector_node_replace_child(result, sub, child, level - PVECTOR_BITS);
+	return result;
+}
+
+/** Return a chain of new branch nodes owned by `owner` from height `level`
+ * down to the leaf `leaf`, which gains a reference. Return NULL if there is
+ * insufficient memory. */
+static pvector_node_t *pvector_new_path(pvector_node_t *leaf, int level, int64_t owner) {
+	if (level == 0) {
+		pvector_node_retain(leaf);
+		return leaf;
+	}
+	pvector_node_t *branch = pvector_branch_new(owner);
+	if (!branch) return NULL;
+	if (!(PVECTOR_CHILDREN(branch)[0] = pvector_new_path(leaf, level - PVECTOR_BITS, owner))) {
+		free(branch);
+		return NULL;
+	}
+	return branch;
+}
+
+/** Return `node` at height `level`, modified in place or copied for `owner`,
+ * with the full tail of `pvector` added as the leaf after the last one. Return
+ * NULL if there is insufficient memory, in which case nothing is modified. */
+static pvector_node_t *pvector_push_tail(const pvector_t *pvector, pvector_node_t *node, int level, int64_t owner) {
+	pvector_node_t *result = pvector_node_editable(pvector, node, level, owner);
+	if (!result) return NULL;
+	int64_t sub = ((pvector->len - 1) >> level) & PVECTOR_MASK;
+	pvector_node_t *child = PVECTOR_CHILDREN(result)[sub];
+	pvector_node_t *insert;
+	if (level == PVECTOR_BITS) {
+		insert = pvector->tail;
+		pvector_node_retain(insert);
+	} else if (child) {
+		insert = pvector_push_tail(pvector, child, level - PVECTOR_BITS, owner);
+	} else {
+		insert = pvector_new_path(pvector->tail, level - PVECTOR_BITS, owner);
+	}
+	if (!insert) {
+		if (result != node) pvector_node_release(result, level);
+		return NULL;
+	}
+	pvector_node_replace_child(result, sub, insert, level - PVECTOR_BITS);
+	return result;
+}
+
+/** Return the root of the tree of `pvector` after adding its full tail to it,
+ * modified in place or copied for `owner`, and store the new shift in
+ * `shift`. Return NULL if there is insufficient memory, in which case nothing
+ * is modified. */
+static pvector_node_t *pvector_root_with_tail(const pvector_t *pvector, int *shift, int64_t owner) {
+	if ((pvector->len >> PVECTOR_BITS) > ((int64_t)1 << pvector->shift)) {
+		// the tree is full, so add a level above the root
+		pvector_node_t *root = pvector_branch_new(owner);
+		if (!root) return NULL;
+		if (!(PVECTOR_CHILDREN(root)[1] = pvector_new_path(pvector->tail, pvector->shift, owner))) {
+			free(root);
+			return NULL;
+		}
+		PVECTOR_CHILDREN(root)[0] = pvector->root;
+		pvector_node_retain(pvector->root);
+		*shift = pvector->shift + PVECTOR_BITS;
+		return root;
+	}
+	*shift = pvector->shift;
+	return pvector_push_tail(pvector, pvector->root, pvector->shift, owner);
+}
+
+/** Return a new version handle of `pvector` taking ownership of one reference
+ * to each of `root` and `tail`. On failure, release them and return NULL. */
+static pvector_t *pvector_version(const pvector_t *pvector, int64_t len, int shift, pvector_node_t *root, pvector_node_t *tail) {
+	pvector_t *version = malloc(sizeof(pvector_t));
+	if (!version) {
+		pvector_node_release(root, shift);
+		pvector_node_release(tail, 0);
+		return NULL;
+	}
+	version->len = len;
+	version->elem_size = pvector->elem_size;
+	version->shift = shift;
+	version->owner = 0;
+	version->root = root;
+	version->tail = tail;
+	version->cmp_func = pvector->cmp_func;
+	return version;
+}
+
+pvector_t *pvector_new(size_t elem_size, cmp_func_t cmp_func) {
+	pvector_t *pvector = malloc(sizeof(pvector_t));
+	if (!pvector) return NULL;
+	pvector->len = 0;
+	pvector->elem_size = elem_size;
+	pvector->shift = PVECTOR_BITS;
+	pvector->owner = 0;
+	pvector->cmp_func = cmp_func;
+	pvector->root = pvector_branch_new(0);
+	pvector->tail = pvector_leaf_new(pvector, 0);
+	if (!pvector->root || !pvector->tail) {
+		free(pvector->root);
+		free(pvector->tail);
+		free(pvector);
+		return NULL;
+	}
+	return pvector;
+}
+
+void pvector_free(pvector_t *pvector) {
+	pvector_node_release(pvector->root, pvector->shift);
+	pvector_node_release(pvector->tail, 0);
+	free(pvector);
+}
+
+int64_t pvector_len(const pvector_t *pvector) {
+	return pvector->len;
+}
+
+const void *pvector_get(const pvector_t *pvector, int64_t index) {
+	if (index < -pvector->len || index >= pvector->len) return NULL;
+	if (index < 0) index += pvector->len;
+	return PVECTOR_VALUE(pvector, pvector_leaf_for(pvector, index), index & PVECTOR_MASK);
+}
+
+pvector_t *pvector_set(const pvector_t *pvector, int64_t index, const void *value) {
+	if (index < -pvector->len || index >= pvector->len) return NULL;
+	if (index < 0) index += pvector->len;
+	pvector_node_t *root = pvector->root, *tail = pvector->tail;
+	if (index >= pvector_tailoff(pvector)) {
+		if (!(tail = pvector_do_set(pvector, tail, 0, index, value, 0))) return NULL;
+		pvector_node_retain(root);
+	} else {
+		if (!(root = pvector_do_set(pvector, root, pvector->shift, index, value, 0))) return NULL;
+		pvector_node_retain(tail);
+	}
+	return pvector_version(pvector, pvector->len, pvector->shift, root, tail);
+}
+
+pvector_t *pvector_append(const pvector_t *pvector, const void *value) {
+	int shift = pvector->shift;
+	pvector_node_t *root = pvector->root, *tail;
+	if (pvector->len - pvector_tailoff(pvector) < PVECTOR_WIDTH) {
+		if (!(tail = pvector_node_editable(pvector, pvector->tail, 0, 0))) return NULL;
+		pvector_node_retain(root);
+	} else {
+		if (!(tail = pvector_leaf_new(pvector, 0))) return NULL;
+		if (!(root = pvector_root_with_tail(pvector, &shift, 0))) {
+			free(tail);
+			return NULL;
+		}
+	}
+	memmove(PVECTOR_VALUE(pvector, tail, pvector->len & PVECTOR_MASK), value, pvector->elem_size);
+	return pvector_version(pvector, pvector->len + 1, shift, root, tail);
+}
+
+pvector_t *pvector_transient(const pvector_t *pvector) {
+	pvector_node_retain(pvector->root);
+	pvector_node_retain(pvector->tail);
+	pvector_t *transient = pvector_version(pvector, pvector->len, pvector->shift, pvector->root, pvector->tail);
+	if (!transient) return NULL;
+	transient->owner = ds_atomic_fetch_add(&pvector_last_owner, 1) + 1;
+	return transient;
+}
+
+bool pvector_transient_set(pvector_t *transient, int64_t index, const void *value) {
+	if (index < -transient->len || index >= transient->len) return false;
+	if (index < 0) index += transient->len;
+	if (index >= pvector_tailoff(transient)) {
+		pvector_node_t *tail = pvector_do_set(transient, transient->tail, 0, index, value, transient->owner);
+		if (!tail) return false;
+		if (tail != transient->tail) pvector_node_release(transient->tail, 0);
+		transient->tail = tail;
+	} else {
+		pvector_node_t *root = pvector_do_set(transient, transient->root, transient->shift, index, value, transient->owner);
+		if (!root) return false;
+		if (root != transient->root) pvector_node_release(transient->root, transient->shift);
+		transient->root = root;
+	}
+	return true;
+}
+
+bool pvector_transient_append(pvector_t *transient, const void *value) {
+	if (transient->len - pvector_tailoff(transient) < PVECTOR_WIDTH) {
+		pvector_node_t *tail = pvector_node_editable(transient, transient->tail, 0, transient->owner);
+		if (!tail) return false;
+		if (tail != transient->tail) pvector_node_release(transient->tail, 0);
+		transient->tail = tail;
+	} else {
+		int shift;
+		pvector_node_t *tail = pvector_leaf_new(transient, transient->owner);
+		if (!tail) return false;
+		pvector_node_t *root = pvector_root_with_tail(transient, &shift, transient->owner);
+		if (!root) {
+			free(tail);
+			return false;
+		}
+		if (root != transient->root) pvector_node_release(transient->root, transient->shift);
+		// the tree now holds its own reference to the old tail
+		pvector_node_release(transient->tail, 0);
+		transient->root = root;
+		transient->shift = shift;
+		transient->tail = tail;
+	}
+	memmove(PVECTOR_VALUE(transient, transient->tail, transient->len & PVECTOR_MASK), value, transient->elem_size);
+	transient->len++;
+	return true;
+}
+
+void pvector_persistent(pvector_t *transient) {
+	transient->owner = 0;
+}
+
+pvector_t *pvector_from_arraylist(const arraylist_t *arraylist) {
+	pvector_t *empty = pvector_new(arraylist->elem_size, arraylist->cmp_func);
+	if (!empty) return NULL;
+	pvector_t *pvector = pvector_transient(empty);
+	pvector_free(empty);
+	if (!pvector) return NULL;
+	for (int8_t *value = arraylist->contents; value < arraylist->end; value += arraylist->elem_size) {
+		if (!pvector_transient_append(pvector, value)) {
+			pvector_free(pvector);
+			return NULL;
+		}
+	}
+	pvector_persistent(pvector);
+	return pvector;
+}
+
+arraylist_t *pvector_to_arraylist(const pvector_t *pvector) {
+	arraylist_t *arraylist = arraylist_new(pvector->elem_size, pvector->cmp_func);
+	if (!arraylist) return NULL;
+	if (!arraylist_reserve(arraylist, MAX(pvector->len, 1))) {
+		arraylist_free(arraylist);
+		return NULL;
+	}
+	for (int64_t i = 0; i < pvector->len; i += PVECTOR_WIDTH) {
+		int64_t n = MIN(PVECTOR_WIDTH, pvector->len - i);
+		memcpy(arraylist->end, pvector_leaf_for(pvector, i)->data, (size_t)n * pvector->elem_size);
+		arraylist->len += n;
+		arraylist->end += n * (int64_t)pvector->elem_size;
+	}
+	return arraylist;
+}
+
+/* ---------------------- epoch-based memory reclamation ---------------------- */
+
+/* Number of nodes a thread retires between attempts to advance the epoch */
+#define EBR_RETIRE_THRESHOLD 64
+
+/* Number of epochs whose retired nodes are kept. A node retired in epoch e is
+   freed when the global epoch advances from e + 2 to e + 3, at which point no
+   thread can be in a critical section begun in epoch e + 1 or earlier. */
+#define EBR_NUM_EPOCHS 3
+
+/** Header of a node that can be retired, must be the first member */
+typedef struct ebr_node_t {
+	struct ebr_node_t *next;	// next node in the same limbo list
+} ebr_node_t;
+
+/** Per-thread epoch record */
+typedef struct ebr_record_t {
+	volatile int64_t active;	// nonzero while the owner is in a critical section
+	volatile int64_t epoch;		// global epoch observed when the critical section began
+	volatile int64_t in_use;	// nonzero while the record is owned by a thread
+	int64_t depth;				// critical section nesting depth, owner only
+	int64_t retired;			// number of nodes retired by the owner, owner only
+	uint64_t rng;				// random number state of the owner
+	struct ebr_record_t *next;	// next record in ebr_records
+} ebr_record_t;
+
+/* Records of all threads that ever entered a critical section. Records are
+   recycled when their thread exits and are never freed. */
+static ebr_record_t *volatile ebr_records = NULL;
+
+/* Global epoch */
+static volatile int64_t ebr_epoch = 0;
+
+/* Nonzero while a thread is trying to advance the global epoch */
+static volatile int64_t ebr_advancing = 0;
+
+/* Nodes retired in each epoch modulo EBR_NUM_EPOCHS */
+static ebr_node_t *volatile ebr_limbo[EBR_NUM_EPOCHS] = { NULL };
+
+/* Record owned by the calling thread, NULL if it has none yet */
+static DS_THREAD_LOCAL ebr_record_t *ebr_current = NULL;
+
+#ifdef _WIN32
+static DWORD ebr_key;
+static INIT_ONCE ebr_key_once = INIT_ONCE_STATIC_INIT;
+
+/** Release the record of an exiting thread. */
+static void WINAPI ebr_thread_exit(void *record) {
+	if (record) ds_atomic_store(&((ebr_record_t *)record)->in_use, 0);
+}
+
+static BOOL CALLBACK ebr_key_init(PINIT_ONCE once, PVOID param, PVOID *context) {
+	ebr_key = FlsAlloc(ebr_thread_exit);
+	return TRUE;
+}
+#else
+static pthread_key_t ebr_key;
+static pthread_once_t ebr_key_once = PTHREAD_ONCE_INIT;
+
+/** Release the record of an exiting thread. */
+static void ebr_thread_exit(void *record) {
+	ds_atomic_store(&((ebr_record_t *)record)->in_use, 0);
+}
+
+static void ebr_key_init(void) {
+	pthread_key_create(&ebr_key, ebr_thread_exit);
+}
+#endif
+
+/** Return the record of the calling thread, claiming a free record or creating
+ * one if the thread has none. Return NULL if there is insufficient memory. */
+static ebr_record_t *ebr_record_get(void) {
+	if (ebr_current) return ebr_current;
+	ebr_record_t *record;
+	for (record = ds_atomic_load_ptr((void *const volatile *)&ebr_records); record; record = record->next) {
+		if (!ds_atomic_load(&record->in_use) && ds_atomic_cas(&record->in_use, 0, 1)) break;
+	}
+	if (!record) {
+		if (!(record = calloc(1, sizeof(ebr_record_t)))) return NULL;
+		record->in_use = 1;
+		do {
+			record->next = ds_atomic_load_ptr((void *const volatile *)&ebr_records);
+		} while (!ds_atomic_cas_ptr((void *volatile *)&ebr_records, record->next, record));
+	}
+	record->rng = 0x9E3779B97F4A7C15ull ^ (uint64_t)(uintptr_t)record;
+#ifdef _WIN32
+	InitOnceExecuteOnce(&ebr_key_once, ebr_key_init, NULL, NULL);
+	FlsSetValue(ebr_key, record);
+#else
+	pthread_once(&ebr_key_once, ebr_key_init);
+	pthread_setspecific(ebr_key, record);
+#endif
+	ebr_current = record;
+	return record;
+}
+
+/** Enter a critical section of the calling thread, during which nodes it can
+ * reach are not freed. Critical sections may nest. Return the record of the
+ * calling thread, or NULL if there is insufficient memory. */
+static ebr_record_t *ebr_enter(void) {
+	ebr_record_t *record = ebr_record_get();
+	if (!record) return NULL;
+	if (record->depth++ == 0) {
+		ds_atomic_store(&record->active, 1);
+		ds_atomic_fence();
+		ds_atomic_store(&record->epoch, ds_atomic_load(&ebr_epoch));
+		ds_atomic_fence();
+	}
+	return record;
+}
+
+/** Leave a critical section entered with ebr_enter. */
+static void ebr_exit(ebr_record_t *record) {
+	if (--record->depth == 0) ds_atomic_store(&record->active, 0);
+}
+
+/** Advance the global epoch and free the nodes retired three epochs ago if
+ * every thread in a critical section has observed the current epoch. */
+static void ebr_try_advance(void) {
+	if (!ds_atomic_cas(&ebr_advancing, 0, 1)) return;
+	int64_t epoch = ds_atomic_load(&ebr_epoch);
+	ebr_record_t *record;
+	for (record = ds_atomic_load_ptr((void *const volatile *)&ebr_records); record; record = record->next) {
+		if (ds_atomic_load(&record->active) && ds_atomic_load(&record->epoch) != epoch) break;
+	}
+	ebr_node_t *node = NULL;
+	if (!record) {
+		node = ds_atomic_exchange_ptr((void *volatile *)&ebr_limbo[(epoch + 1) % EBR_NUM_EPOCHS], NULL);
+		ds_atomic_store(&ebr_epoch, epoch + 1);
+	}
+	ds_atomic_store(&ebr_advancing, 0);
+	while (node) {
+		ebr_node_t *next = node->next;
+		free(node);
+		node = next;
+	}
+}
+
+/** Retire `node`, which must be unreachable from shared memory, so that it is
+ * freed once no thread can still hold a reference to it. Must be called inside
+ * a critical section of `record`. */
+static void ebr_retire(ebr_record_t *record, ebr_node_t *node) {
+	ebr_node_t *volatile *limbo = &ebr_limbo[record->epoch % EBR_NUM_EPOCHS];
+	do {
+		node->next = ds_atomic_load_ptr((void *const volatile *)limbo);
+	} while (!ds_atomic_cas_ptr((void *volatile *)limbo, node->next, node));
+	if (++record->retired % EBR_RETIRE_THRESHOLD == 0) ebr_try_advance();
+}
+
+/* -------------------------- concurrent skip list -------------------------- */
+
+/* Maximum height of a skip list node */
+#define SKIPLIST_MAX_HEIGHT 16
+
+/* Each node of height h has height > h with probability 1 / SKIPLIST_BRANCHING */
+#define SKIPLIST_BRANCHING 4
+
+/* Whether link `ptr` is marked, meaning that the node containing it is being
+   deleted */
+#define SKIPLIST_MARKED(ptr) (((uintptr_t)(ptr)) & 1)
+#define SKIPLIST_MARK(ptr) ((skiplist_node_t *)((uintptr_t)(ptr) | 1))
+#define SKIPLIST_UNMARK(ptr) ((skiplist_node_t *)((uintptr_t)(ptr) & ~(uintptr_t)1))
+
+struct skiplist_node_t {
+	ebr_node_t ebr;				// header for epoch-based reclamation, must be first
+	volatile int64_t pending;	// number of the inserting and deleting threads yet to finish linking
+	int64_t height;				// number of levels the node is linked into
+	struct skiplist_node_t *volatile next[];	// possibly marked successor at each level, followed by the value
+};
+
+/* Pointer to the value stored in skip list node `node` */
+#define SKIPLIST_VALUE(node) ((int8_t *)&(node)->next[(node)->height])
+
+/** Load link `level` of `node`. */
+static skiplist_node_t *skiplist_load(skiplist_node_t *node, int64_t level) {
+	return ds_atomic_load_ptr((void *const volatile *)&node->next[level]);
+}
+
+/** If link `level` of `node` equals `expected`, set it to `desired` and return
+ * true. Otherwise return false. */
+static bool skiplist_cas(skiplist_node_t *node, int64_t level, skiplist_node_t *expected, skiplist_node_t *desired) {
+	return ds_atomic_cas_ptr((void *volatile *)&node->next[level], expected, desired);
+}
+
+/** Return a new unlinked node of `skiplist` of height `height` containing a
+ * copy of `value`, NULL if there is insufficient memory. */
+static skiplist_node_t *skiplist_node_new(const skiplist_t *skiplist, int64_t height, const void *value) {
+	skiplist_node_t *node = malloc(sizeof(skiplist_node_t) + (size_t)height * sizeof(skiplist_node_t *) + skiplist->elem_size);
+	if (!node) return NULL;
+	node->pending = 2;
+	node->height = height;
+	if (value) memcpy(SKIPLIST_VALUE(node), value, skiplist->elem_size);
+	return node;
+}
+
+/** Return a random node height using the random state of `record`. */
+static int64_t skiplist_random_height(ebr_record_t *record) {
+	int64_t height = 1;
+	for (;;) {
+		// xorshift64
+		record->rng ^= record->rng << 13;
+		record->rng ^= record->rng >> 7;
+		record->rng ^= record->rng << 17;
+		if (height >= SKIPLIST_MAX_HEIGHT || record->rng % SKIPLIST_BRANCHING) return height;
+		height++;
+	}
+}
+
+/** Find the position of `value` in `skiplist`. At each level, store in
+ * `preds` the last node whose value is less than `value` and in `succs` the
+ * node after it. Nodes being deleted are unlinked along the way. Return
+ * whether succs[0] contains `value`. Must be called in a critical section. */
+static bool skiplist_find(const skiplist_t *skiplist, const void *value, skiplist_node_t **preds, skiplist_node_t **succs) {
+retry:;
+	skiplist_node_t *pred = skiplist->head, *curr = NULL;
+	for (int64_t level = SKIPLIST_MAX_HEIGHT - 1; level >= 0; level--) {
+		curr = SKIPLIST_UNMARK(skiplist_load(pred, level));
+		while (curr) {
+			skiplist_node_t *succ = skiplist_load(curr, level);
+			while (SKIPLIST_MARKED(succ)) {
+				// curr is being deleted, unlink it at this level
+				if (!skiplist_cas(pred, level, curr, SKIPLIST_UNMARK(succ))) goto retry;
+				if (!(curr = SKIPLIST_UNMARK(succ))) break;
+				succ = skiplist_load(curr, level);
+			}
+			if (!curr || skiplist->cmp_func(SKIPLIST_VALUE(curr), value) >= 0) break;
+			pred = curr;
+			curr = SKIPLIST_UNMARK(succ);
+		}
+		preds[level] = pred;
+		succs[level] = curr;
+	}
+	return curr && !skiplist->cmp_func(SKIPLIST_VALUE(curr), value);
+}
+
+/** Return the first node of `skiplist` not being deleted whose value is
+ * greater than or equal to `value`, or the first such node at all if `value`
+ * is NULL. Return NULL if there is none. Unlike skiplist_find, this never
+ * writes to shared memory. Must be called in a critical section. */
+static skiplist_node_t *skiplist_seek(const skiplist_t *skiplist, const void *value) {
+	skiplist_node_t *pred = skiplist->head, *curr = NULL;
+	for (int64_t level = value ? SKIPLIST_MAX_HEIGHT - 1 : 0; level >= 0; level--) {
+		curr = SKIPLIST_UNMARK(skiplist_load(pred, level));
+		while (curr) {
+			skiplist_node_t *succ = skiplist_load(curr, level);
+			if (SKIPLIST_MARKED(succ)) {
+				curr = SKIPLIST_UNMARK(succ);
+			} else if (value && skiplist->cmp_func(SKIPLIST_VALUE(curr), value) < 0) {
+				pred = curr;
+				curr = SKIPLIST_UNMARK(succ);
+			} else {
+				break;
+			}
+		}
+	}
+	return curr;
+}
+
+/** Called once by the inserting thread of `node` when it has finished linking
+ * the node and once by the thread that deleted it when it has marked all its
+ * links. The second call, which only happens once the node is marked at every
+ * level and no more links to it will be made, unlinks the node everywhere and
+ * retires it. */
+static void skiplist_node_done(const skiplist_t *skiplist, skiplist_node_t *node, ebr_record_t *record) {
+	if (ds_atomic_fetch_add(&node->pending, -1) != 1) return;
+	skiplist_node_t *preds[SKIPLIST_MAX_HEIGHT], *succs[SKIPLIST_MAX_HEIGHT];
+	skiplist_find(skiplist, SKIPLIST_VALUE(node), preds, succs);
+	ebr_retire(record, &node->ebr);
+}
+
+skiplist_t *skiplist_new(size_t elem_size, cmp_func_t cmp_func) {
+	skiplist_t *skiplist = malloc(sizeof(skiplist_t));
+	if (!skiplist) return NULL;
+	skiplist->elem_size = elem_size;
+	skiplist->cmp_func = cmp_func;
+	skiplist->len = 0;
+	if (!(skiplist->head = skiplist_node_new(skiplist, SKIPLIST_MAX_HEIGHT, NULL))) {
+		free(skiplist);
+		return NULL;
+	}
+	for (int64_t level = 0; level < SKIPLIST_MAX_HEIGHT; level++) {
+		skiplist->head->next[level] = NULL;
+	}
+	return skiplist;
+}
+
+void skiplist_free(skiplist_t *skiplist) {
+	skiplist_node_t *node = skiplist->head;
+	while (node) {
+		skiplist_node_t *next = SKIPLIST_UNMARK(node->next[0]);
+		free(node);
+		node = next;
+	}
+	free(skiplist);
+	// give nodes retired while the skip list was in use a chance to be freed
+	for (int i = 0; i < EBR_NUM_EPOCHS; i++) {
+		ebr_try_advance();
+	}
+}
+
+int64_t skiplist_len(const skiplist_t *skiplist) {
+	return ds_atomic_load(&skiplist->len);
+}
+
+bool skiplist_insert(skiplist_t *skiplist, const void *value) {
+	ebr_record_t *record = ebr_enter();
+	if (!record) return false;
+	skiplist_node_t *preds[SKIPLIST_MAX_HEIGHT], *succs[SKIPLIST_MAX_HEIGHT];
+	skiplist_node_t *node = NULL;
+	for (;;) {
+		if (skiplist_find(skiplist, value, preds, succs)) {
+			free(node);
+			ebr_exit(record);
+			return false;
+		}
+		if (!node && !(node = skiplist_node_new(skiplist, skiplist_random_height(record), value))) {
+			ebr_exit(record);
+			return false;
+		}
+		for (int64_t level = 0; level < node->height; level++) {
+			node->next[level] = succs[level];
+		}
+		// linking the node at level 0 inserts it
+		if (skiplist_cas(preds[0], 0, succs[0], node)) break;
+	}
+	ds_atomic_fetch_add(&skiplist->len, 1);
+	for (int64_t level = 1; level < node->height; level++) {
+		for (;;) {
+			skiplist_node_t *next = skiplist_load(node, level);
+			if (SKIPLIST_MARKED(next)) goto done;	// deleted while being inserted
+			skiplist_node_t *succ = succs[level];
+			// never link in front of a node being deleted, or a final unlinking
+			// pass stopping at our node could miss it
+			if ((!succ || !SKIPLIST_MARKED(skiplist_load(succ, level))) &&
+				(next == succ || skiplist_cas(node, level, next, succ)) &&
+				skiplist_cas(preds[level], level, succ, node)) {
+				break;
+			}
+			skiplist_find(skiplist, value, preds, succs);
+		}
+	}
+done:
+	skiplist_node_done(skiplist, node, record);
+	ebr_exit(record);
+	return true;
+}
+
+bool skiplist_erase(skiplist_t *skiplist, const void *value) {
+	ebr_record_t *record = ebr_enter();
+	if (!record) return false;
+	skiplist_node_t *preds[SKIPLIST_MAX_HEIGHT], *succs[SKIPLIST_MAX_HEIGHT];
+	if (!skiplist_find(skiplist, value, preds, succs)) {
+		ebr_exit(record);
+		return false;
+	}
+	skiplist_node_t *node = succs[0];
+	for (int64_t level = node->height - 1; level >= 1; level--) {
+		skiplist_node_t *next = skiplist_load(node, level);
+		while (!SKIPLIST_MARKED(next)) {
+			skiplist_cas(node, level, next, SKIPLIST_MARK(next));
+			next = skiplist_load(node, level);
+		}
+	}
+	// marking level 0 deletes the node; only one thread can do so
+	for (;;) {
+		skiplist_node_t *next = skiplist_load(node, 0);
+		if (SKIPLIST_MARKED(next)) {
+			ebr_exit(record);
+			return false;
+		}
+		if (skiplist_cas(node, 0, next, SKIPLIST_MARK(next))) break;
+	}
+	ds_atomic_fetch_add(&skiplist->len, -1);
+	skiplist_node_done(skiplist, node, record);
+	ebr_exit(record);
+	return true;
+}
+
+bool skiplist_contains(const skiplist_t *skiplist, const void *value) {
+	ebr_record_t *record = ebr_enter();
+	if (!record) return false;
+	skiplist_node_t *node = skiplist_seek(skiplist, value);
+	bool found = node && !skiplist->cmp_func(SKIPLIST_VALUE(node), value);
+	ebr_exit(record);
+	return found;
+}
+
+/** Create an iterator over `skiplist` starting at the first node whose value
+ * is greater than or equal to `value`, or at the first node if `value` is
+ * NULL. */
+static skiplist_iter_t *skiplist_iter_at(const skiplist_t *skiplist, const void *value) {
+	skiplist_iter_t *iter = malloc(sizeof(skiplist_iter_t));
+	if (!iter) return NULL;
+	if (!(iter->record = ebr_enter())) {
+		free(iter);
+		return NULL;
+	}
+	iter->skiplist = skiplist;
+	iter->next = skiplist_seek(skiplist, value);
+	return iter;
+}
+
+skiplist_iter_t *skiplist_iter_new(const skiplist_t *skiplist) {
+	return skiplist_iter_at(skiplist, NULL);
+}
+
+skiplist_iter_t *skiplist_lower_bound(const skiplist_t *skiplist, const void *value) {
+	return skiplist_iter_at(skiplist, value);
+}
+
+void skiplist_iter_free(skiplist_iter_t *iter) {
+	ebr_exit(iter->record);
+	free(iter);
+}
+
+const void *skiplist_iter_next(skiplist_iter_t *iter) {
+	skiplist_node_t *node = iter->next;
+	// skip nodes deleted since the previous call
+	while (node && SKIPLIST_MARKED(skiplist_load(node, 0))) {
+		node = SKIPLIST_UNMARK(skiplist_load(node, 0));
+	}
+	if (!node) return NULL;
+	iter->next = SKIPLIST_UNMARK(skiplist_load(node, 0));
+	return SKIPLIST_VALUE(node);
+}
+
+/* ------------------------------ thread pool ------------------------------ */
+
+/* Initial capacity of each worker's deque. Must be a power of 2. */
+#define WORK_DEQUE_INIT_SIZE 256
+
+/* Number of failed attempts to find a task before an idle worker sleeps */
+#define THREADPOOL_SPIN_LIMIT 64
+
+/** Circular array of tasks backing a work-stealing deque */
+typedef struct work_array_t {
+	int64_t size;						// capacity, a power of 2
+	struct work_array_t *retired_next;	// next array retired by the same deque
+	threadpool_task_t *volatile tasks[];
+} work_array_t;
+
+/** Worker thread with its Chase-Lev work-stealing deque. The owner pushes and
+ * takes tasks at the bottom, thieves steal from the top. */
+typedef struct {
+	volatile int64_t top;			// index of the oldest task, advanced by thieves
+	int8_t padding1[CACHE_LINE_SIZE - sizeof(int64_t)];
+	volatile int64_t bottom;		// index just past the newest task, owned by the worker
+	work_array_t *volatile array;	// current task array
+	work_array_t *retired;			// arrays replaced by growth, freed with the pool
+	threadpool_t *pool;				// pool this worker belongs to
+	int64_t index;					// index of this worker in the pool
+	uint64_t rng;					// state for choosing steal victims
+	ds_thread_t thread;				// worker thread
+	volatile int64_t spawned;		// statistics, see threadpool_stats_t
+	volatile int64_t executed;
+	volatile int64_t steals;
+	volatile int64_t failed_steals;
+	int8_t padding2[CACHE_LINE_SIZE];
+} worker_t;
+
+struct threadpool_t {
+	worker_t *workers;				// array of workers
+	int64_t num_workers;			// number of workers
+	int64_t num_started;			// number of worker threads actually running
+	ds_mutex_t mutex;				// protects the submission queue and sleeping
+	ds_cond_t cond;					// signalled when work arrives or on shutdown
+	threadpool_task_t *queue_head;	// tasks submitted by non-worker threads
+	threadpool_task_t *queue_tail;
+	volatile int64_t queue_len;		// number of tasks in the submission queue
+	volatile int64_t sleeping;		// number of workers waiting on `cond`
+	volatile int64_t epoch;			// incremented whenever work is made available
+	volatile int64_t shutdown;		// nonzero when the pool is being freed
+	volatile int64_t external_spawned;	// number of tasks spawned by non-worker threads
+};
+
+/* Worker run by the calling thread, NULL if the thread is not a worker */
+static DS_THREAD_LOCAL worker_t *current_worker = NULL;
+
+/* Pool returned by threadpool_default, created on first use */
+static threadpool_t *volatile default_pool = NULL;
+
+/** Push `task` on the bottom of the deque of `worker`, which must be owned by
+ * the calling thread. Return false if the deque is full and cannot grow. */
+static bool work_deque_push(worker_t *worker, threadpool_task_t *task) {
+	int64_t bottom = ds_atomic_load(&worker->bottom);
+	int64_t top = ds_atomic_load(&worker->top);
+	work_array_t *array = worker->array;
+	if (bottom - top >= array->size) {
+		work_array_t *array_new = malloc(sizeof(work_array_t) + 2 * (size_t)array->size * sizeof(threadpool_task_t *));
+		if (!array_new) return false;
+		array_new->size = 2 * array->size;
+		for (int64_t i = top; i < bottom; i++) {
+			array_new->tasks[i & (array_new->size - 1)] = ds_atomic_load_ptr((void *const volatile *)&array->tasks[i & (array->size - 1)]);
+		}
+		// thieves may still be reading the old array, so free it with the pool
+		array->retired_next = worker->retired;
+		worker->retired = array;
+		ds_atomic_store_ptr((void *volatile *)&worker->array, array_new);
+		array = array_new;
+	}
+	ds_atomic_store_ptr((void *volatile *)&array->tasks[bottom & (array->size - 1)], task);
+	ds_atomic_store(&worker->bottom, bottom + 1);
+	return true;
+}
+
+/** Take the newest task from the bottom of the deque of `worker`, which must be
+ * owned by the calling thread. Return NULL if the deque is empty. */
+static threadpool_task_t *work_deque_take(worker_t *worker) {
+	int64_t bottom = ds_atomic_load(&worker->bottom) - 1;
+	work_array_t *array = worker->array;
+	ds_atomic_store(&worker->bottom, bottom);
+	ds_atomic_fence();
+	int64_t top = ds_atomic_load(&worker->top);
+	threadpool_task_t *task = NULL;
+	if (top <= bottom) {
+		task = ds_atomic_load_ptr((void *const volatile *)&array->tasks[bottom & (array->size - 1)]);
+		if (top == bottom) {
+			// last task, race against thieves for it
+			if (!ds_atomic_cas(&worker->top, top, top + 1)) task = NULL;
+			ds_atomic_store(&worker->bottom, bottom + 1);
+		}
+	} else {
+		ds_atomic_store(&worker->bottom, bottom + 1);
+	}
+	return task;
+}
+
+/** Steal the oldest task from the top of the deque of `victim`. Return NULL if
+ * the deque is empty or another thread won the race for the task. */
+static threadpool_task_t *work_deque_steal(worker_t *victim) {
+	int64_t top = ds_atomic_load(&victim->top);
+	ds_atomic_fence();
+	int64_t bottom = ds_atomic_load(&victim->bottom);
+	if (top >= bottom) return NULL;
+	work_array_t *array = ds_atomic_load_ptr((void *const volatile *)&victim->array);
+	threadpool_task_t *task = ds_atomic_load_ptr((void *const volatile *)&array->tasks[top & (array->size - 1)]);
+	if (!ds_atomic_cas(&victim->top, top, top + 1)) return NULL;
+	return task;
+}
+
+/** Remove and return the oldest task of the submission queue of `pool`, NULL
+ * if it is empty. */
+static threadpool_task_t *threadpool_dequeue(threadpool_t *pool) {
+	if (!ds_atomic_load(&pool->queue_len)) return NULL;
+	ds_mutex_lock(&pool->mutex);
+	threadpool_task_t *task = pool->queue_head;
+	if (task) {
+		pool->queue_head = task->next;
+		if (!pool->queue_head) pool->queue_tail = NULL;
+		ds_atomic_fetch_add(&pool->queue_len, -1);
+	}
+	ds_mutex_unlock(&pool->mutex);
+	return task;
+}
+
+/** Return a task for worker `self`, run by the calling thread, or NULL if none
+ * was found. The worker's own deque is tried first, then a steal from each
+ * other worker starting at a random victim, then the submission queue. */
+static threadpool_task_t *threadpool_find_task(threadpool_t *pool, worker_t *self) {
+	threadpool_task_t *task;
+	if ((task = work_deque_take(self)) != NULL) return task;
+	// xorshift64
+	self->rng ^= self->rng << 13;
+	self->rng ^= self->rng >> 7;
+	self->rng ^= self->rng << 17;
+	int64_t start = (int64_t)(self->rng % (uint64_t)pool->num_workers);
+	for (int64_t i = 0; i < pool->num_workers; i++) {
+		worker_t *victim = &pool->workers[(start + i) % pool->num_workers];
+		if (victim == self) continue;
+		if ((task = work_deque_steal(victim)) != NULL) {
+			ds_atomic_store(&self->steals, self->steals + 1);
+			return task;
+		}
+	}
+	if (pool->num_workers > 1) ds_atomic_store(&self->failed_steals, self->failed_steals + 1);
+	return threadpool_dequeue(pool);
+}
+
+/** Run `task` on worker `self`, run by the calling thread, and mark the task as
+ * done. */
+static void threadpool_run_task(threadpool_task_t *task, worker_t *self) {
+	task->func(task->arg);
+	ds_atomic_store(&self->executed, self->executed + 1);
+	// the joining thread may free the task as soon as this store is visible
+	ds_atomic_store(&task->done, 1);
+}
+
+/** Wake a sleeping worker of `pool` after work was made available. */
+static void threadpool_notify(threadpool_t *pool) {
+	ds_atomic_fetch_add(&pool->epoch, 1);
+	if (ds_atomic_load(&pool->sleeping)) {
+		ds_mutex_lock(&pool->mutex);
+		ds_cond_signal(&pool->cond);
+		ds_mutex_unlock(&pool->mutex);
+	}
+}
+
+/** Main loop of a worker thread. `arg` is the worker_t. */
+static DS_THREAD_FUNC threadpool_worker_main(void *arg) {
+	worker_t *self = arg;
+	threadpool_t *pool = self->pool;
+	current_worker = self;
+	int64_t failures = 0;
+	while (!ds_atomic_load(&pool->shutdown)) {
+		int64_t epoch = ds_atomic_load(&pool->epoch);
+		threadpool_task_t *task = threadpool_find_task(pool, self);
+		if (task) {
+			threadpool_run_task(task, self);
+			failures = 0;
+		} else if (++failures < THREADPOOL_SPIN_LIMIT) {
+			ds_thread_yield();
+		} else {
+			// sleep until work arrives; rechecking the epoch after announcing
+			// that we sleep ensures that no notification is missed
+			ds_mutex_lock(&pool->mutex);
+			ds_atomic_fetch_add(&pool->sleeping, 1);
+			while (ds_atomic_load(&pool->epoch) == epoch && !ds_atomic_load(&pool->shutdown)) {
+				ds_cond_wait(&pool->cond, &pool->mutex);
+			}
+			ds_atomic_fetch_add(&pool->sleeping, -1);
+			ds_mutex_unlock(&pool->mutex);
+			failures = 0;
+		}
+	}
+	current_worker = NULL;
+	return DS_THREAD_RETURN;
+}
+
+threadpool_t *threadpool_new(int64_t num_workers, bool pin_workers) {
+	if (num_workers <= 0) num_workers = ds_cpu_count();
+	threadpool_t *pool = calloc(1, sizeof(threadpool_t));
+	if (!pool) return NULL;
+	if (!(pool->workers = calloc((size_t)num_workers, sizeof(worker_t)))) {
+		free(pool);
+		return NULL;
+	}
+	pool->num_workers = num_workers;
+	ds_mutex_init(&pool->mutex);
+	ds_cond_init(&pool->cond);
+	for (int64_t i = 0; i < num_workers; i++) {
+		worker_t *worker = &pool->workers[i];
+		worker->pool = pool;
+		worker->index = i;
+		worker->rng = 0x9E3779B97F4A7C15ull * (uint64_t)(i + 1);
+		worker->array = malloc(sizeof(work_array_t) + WORK_DEQUE_INIT_SIZE * sizeof(threadpool_task_t *));
+		if (!worker->array) {
+			threadpool_free(pool);
+			return NULL;
+		}
+		worker->array->size = WORK_DEQUE_INIT_SIZE;
+	}
+	for (int64_t i = 0; i < num_workers; i++) {
+		if (!ds_thread_create(&pool->workers[i].thread, threadpool_worker_main, &pool->workers[i])) {
+			threadpool_free(pool);
+			return NULL;
+		}
+		pool->num_started++;
+		if (pin_workers) ds_thread_pin(pool->workers[i].thread, i);
+	}
+	return pool;
+}
+
+void threadpool_free(threadpool_t *pool) {
+	ds_mutex_lock(&pool->mutex);
+	ds_atomic_store(&pool->shutdown, 1);
+	ds_cond_broadcast(&pool->cond);
+	ds_mutex_unlock(&pool->mutex);
+	for (int64_t i = 0; i < pool->num_started; i++) {
+		ds_thread_join(pool->workers[i].thread);
+	}
+	for (int64_t i = 0; i < pool->num_workers; i++) {
+		work_array_t *array = pool->workers[i].retired;
+		while (array) {
+			work_array_t *next = array->retired_next;
+			free(array);
+			array = next;
+		}
+		free(pool->workers[i].array);
+	}
+	ds_cond_destroy(&pool->cond);
+	ds_mutex_destroy(&pool->mutex);
+	free(pool->workers);
+	free(pool);
+}
+
+int64_t threadpool_num_workers(const threadpool_t *pool) {
+	return pool->num_workers;
+}
+
+threadpool_t *threadpool_default(void) {
+	threadpool_t *pool = ds_atomic_load_ptr((void *const volatile *)&default_pool);
+	if (pool) return pool;
+	if (!(pool = threadpool_new(0, false))) return NULL;
+	if (!ds_atomic_cas_ptr((void *volatile *)&default_pool, NULL, pool)) {
+		// another thread created the default pool first
+		threadpool_free(pool);
+		pool = ds_atomic_load_ptr((void *const volatile *)&default_pool);
+	}
+	return pool;
+}
+
+void threadpool_spawn(threadpool_t *pool, threadpool_task_t *task, void(*func)(void*), void *arg) {
+	task->func = func;
+	task->arg = arg;
+	task->done = 0;
+	task->next = NULL;
+	worker_t *self = current_worker;
+	if (self && self->pool == pool) {
+		if (!work_deque_push(self, task)) {
+			threadpool_run_task(task, self);
+			return;
+		}
+		ds_atomic_store(&self->spawned, self->spawned + 1);
+	} else {
+		ds_atomic_fetch_add(&pool->external_spawned, 1);
+		ds_mutex_lock(&pool->mutex);
+		if (pool->queue_tail) pool->queue_tail->next = task;
+		else pool->queue_head = task;
+		pool->queue_tail = task;
+		ds_atomic_fetch_add(&pool->queue_len, 1);
+		ds_mutex_unlock(&pool->mutex);
+	}
+	threadpool_notify(pool);
+}
+
+void threadpool_join(threadpool_t *pool, threadpool_task_t *task) {
+	worker_t *self = current_worker;
+	// Only workers help while waiting. A thread without a deque of its own
+	// would queue the subtasks of whatever it stole behind unrelated work and
+	// then steal again to wait for them, nesting stolen tasks without bound.
+	if (!self || self->pool != pool) {
+		while (!ds_atomic_load(&task->done)) ds_thread_yield();
+		return;
+	}
+	while (!ds_atomic_load(&task->done)) {
+		threadpool_task_t *other = threadpool_find_task(pool, self);
+		if (other) threadpool_run_task(other, self);
+		else ds_thread_yield();
+	}
+}
+
+void threadpool_get_stats(const threadpool_t *pool, threadpool_stats_t *stats) {
+	stats->spawned = ds_atomic_load(&pool->external_spawned);
+	stats->executed = 0;
+	stats->steals = 0;
+	stats->failed_steals = 0;
+	for (int64_t i = 0; i < pool->num_workers; i++) {
+		const worker_t *worker = &pool->workers[i];
+		stats->spawned += ds_atomic_load(&worker->spawned);
+		stats->executed += ds_atomic_load(&worker->executed);
+		stats->steals += ds_atomic_load(&worker->steals);
+		stats->failed_steals += ds_atomic_load(&worker->failed_steals);
+	}
+}
+
+/* ---------------------- parallel arraylist operations ---------------------- */
+
+/* Target size, in bytes, of the chunks an arraylist is split into for parallel
+   operations. Chunk lengths are rounded up so that each chunk spans a whole
+   number of cache lines. */
+#define PARALLEL_CHUNK_BYTES (64 * 1024)
+
+/** Chunk body called by parallel_for for each chunk index */
+typedef void (*parallel_body_t)(void *ctx, int64_t chunk);
+
+/** Shared state of a parallel_for call */
+typedef struct {
+	parallel_body_t body;		// function to run on each chunk
+	void *ctx;					// context passed to `body`
+	int64_t num_chunks;			// number of chunks
+	volatile int64_t next;		// next chunk to be claimed
+} parallel_job_t;
+
+/** Claim and run chunks of `arg`, a parallel_job_t, until none remain. */
+static void parallel_worker(void *arg) {
+	parallel_job_t *job = arg;
+	int64_t chunk;
+	while ((chunk = ds_atomic_fetch_add(&job->next, 1)) < job->num_chunks) {
+		job->body(job->ctx, chunk);
+	}
+}
+
+/** Call `body(ctx, chunk)` once for each chunk in [0, num_chunks), spreading
+ * the calls over the workers of the default thread pool. The calling thread
+ * takes part in the work. If the pool is unavailable, all chunks are run by the
+ * calling thread. Return once all chunks are done. */
+static void parallel_for(int64_t num_chunks, parallel_body_t body, void *ctx) {
+	parallel_job_t job = { body, ctx, num_chunks, 0 };
+	threadpool_t *pool = num_chunks > 1 ? threadpool_default() : NULL;
+	int64_t num_tasks = pool ? MIN(threadpool_num_workers(pool), num_chunks - 1) : 0;
+	threadpool_task_t *tasks = num_tasks > 0 ? malloc((size_t)num_tasks * sizeof(threadpool_task_t)) : NULL;
+	if (tasks) {
+		for (int64_t i = 0; i < num_tasks; i++) {
+			threadpool_spawn(pool, &tasks[i], parallel_worker, &job);
+		}
+	}
+	parallel_worker(&job);
+	if (tasks) {
+		for (int64_t i = 0; i < num_tasks; i++) {
+			threadpool_join(pool, &tasks[i]);
+		}
+	}
+	free(tasks);
+}
+
+/** Return the greatest common divisor of `a` and `b`. */
+static size_t gcd(size_t a, size_t b) {
+	while (b) {
+		size_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/** Return the number of elements of `arraylist` in each parallel chunk. The
+ * result only depends on the element size, so chunk boundaries (and hence the
+ * combine order of arraylist_parallel_reduce) do not depend on the number of
+ * threads. */
+static int64_t parallel_chunk_len(const arraylist_t *arraylist) {
+	int64_t line_elems = (int64_t)(CACHE_LINE_SIZE / gcd(arraylist->elem_size, CACHE_LINE_SIZE));
+	int64_t chunk_len = MAX((int64_t)(PARALLEL_CHUNK_BYTES / arraylist->elem_size), 1);
+	return (chunk_len + line_elems - 1) / line_elems * line_elems;
+}
+
+/** State of arraylist_parallel_foreach, arraylist_parallel_map and
+ * arraylist_parallel_reduce */
+typedef struct {
+	const arraylist_t *source;	// arraylist being read
+	arraylist_t *dest;			// arraylist being written by map, NULL otherwise
+	int64_t chunk_len;			// number of elements per chunk
+	void (*foreach_func)(void *);
+	void (*map_func)(void *, const void *, void *);
+	void (*combine)(void *, const void *, void *);
+	void *ctx;					// context passed to map_func or combine
+	const void *identity;		// identity value of combine
+	int8_t *partials;			// one partial result of combine per chunk
+} parallel_arraylist_ctx_t;
+
+static void parallel_foreach_body(void *ctx, int64_t chunk) {
+	parallel_arraylist_ctx_t *p = ctx;
+	int64_t start = chunk * p->chunk_len;
+	int64_t end = MIN(start + p->chunk_len, p->source->len);
+	int8_t *last = ARRAYLIST_GET_UNCHECKED(p->source, end);
+	for (int8_t *value = ARRAYLIST_GET_UNCHECKED(p->source, start); value < last; value += p->source->elem_size) {
+		p->foreach_func(value);
+	}
+}
+
+static void parallel_map_body(void *ctx, int64_t chunk) {
+	parallel_arraylist_ctx_t *p = ctx;
+	int64_t start = chunk * p->chunk_len;
+	int64_t end = MIN(start + p->chunk_len, p->source->len);
+	for (int64_t i = start; i < end; i++) {
+		p->map_func(ARRAYLIST_GET_UNCHECKED(p->dest, i), ARRAYLIST_GET_UNCHECKED(p->source, i), p->ctx);
+	}
+}
+
+static void parallel_reduce_body(void *ctx, int64_t chunk) {
+	parallel_arraylist_ctx_t *p = ctx;
+	int64_t start = chunk * p->chunk_len;
+	int64_t end = MIN(start + p->chunk_len, p->source->len);
+	int8_t *accumulator = p->partials + chunk * (int64_t)p->source->elem_size;
+	int8_t *last = ARRAYLIST_GET_UNCHECKED(p->source, end);
+	memcpy(accumulator, p->identity, p->source->elem_size);
+	for (int8_t *value = ARRAYLIST_GET_UNCHECKED(p->source, start); value < last; value += p->source->elem_size) {
+		p->combine(accumulator, value, p->ctx);
+	}
+}
+
+/** Return the number of chunks of length `chunk_len` needed to cover `len`
+ * elements. */
+static int64_t parallel_num_chunks(int64_t len, int64_t chunk_len) {
+	return (len + chunk_len - 1) / chunk_len;
+}
+
+void arraylist_parallel_foreach(arraylist_t *arraylist, void(*func)(void*)) {
+	PROFILE_FUNCTION();
+	if (!arraylist_unshare(arraylist)) return;
+	parallel_arraylist_ctx_t p = { 0 };
+	p.source = arraylist;
+	p.chunk_len = parallel_chunk_len(arraylist);
+	p.foreach_func = func;
+	parallel_for(parallel_num_chunks(arraylist->len, p.chunk_len), parallel_foreach_body, &p);
+	arraylist_bloom_invalidate(arraylist);
+}
+
+bool arraylist_parallel_map(const arraylist_t *source, arraylist_t *dest, void(*func)(void*, const void*, void*), void *ctx) {
+	PROFILE_FUNCTION();
+	if (!arraylist_unshare(dest) || !arraylist_reserve(dest, MAX(source->len, 1))) return false;
+	dest->len = source->len;
+	dest->end = ARRAYLIST_GET_UNCHECKED(dest, dest->len);
+	parallel_arraylist_ctx_t p = { 0 };
+	p.source = source;
+	p.dest = dest;
+	p.chunk_len = parallel_chunk_len(source);
+	p.map_func = func;
+	p.ctx = ctx;
+	parallel_for(parallel_num_chunks(source->len, p.chunk_len), parallel_map_body, &p);
+	arraylist_bloom_invalidate(dest);
+	return true;
+}
+
+bool arraylist_parallel_reduce(const arraylist_t *arraylist, const void *identity, void(*combine)(void*, const void*, void*), void *ctx, void *dest) {
+	PROFILE_FUNCTION();
+	parallel_arraylist_ctx_t p = { 0 };
+	p.source = arraylist;
+	p.chunk_len = parallel_chunk_len(arraylist);
+	p.combine = combine;
+	p.ctx = ctx;
+	p.identity = identity;
+	int64_t num_chunks = parallel_num_chunks(arraylist->len, p.chunk_len);
+	if (num_chunks && !(p.partials = malloc((size_t)num_chunks * arraylist->elem_size))) return false;
+	parallel_for(num_chunks, parallel_reduce_body, &p);
+	memmove(dest, identity, arraylist->elem_size);
+	for (int64_t chunk = 0; chunk < num_chunks; chunk++) {
+		combine(dest, p.partials + chunk * (int64_t)arraylist->elem_size, ctx);
+	}
+	free(p.partials);
+	return true;
+}
+
+/* ------------------------- external merge sort ------------------------- */
+
+/* Maximum number of runs merged at once */
+#define EXTSORT_MAX_FAN_IN 64
+
+/* Minimum size, in bytes, of the buffer of each run when choosing how many
+   runs to merge at once */
+#define EXTSORT_MIN_BUFFER_SIZE (64 * 1024)
+
+struct extsort_run_t {
+	FILE *file;			// temporary file holding the run
+	int64_t remaining;	// number of elements in the file not yet read into the buffer
+	int8_t *buffer;		// elements read from the file
+	int64_t capacity;	// number of elements the buffer can hold
+	int64_t buffer_len;	// number of elements in the buffer
+	int64_t pos;		// index in the buffer of the first element not yet merged
+};
+
+/** Return the number of elements of the in-memory run of `extsort`. Two
+ * thirds of the memory budget are used by the run and the rest by the buffer
+ * of arraylist_sort. */
+static int64_t extsort_run_capacity(const extsort_t *extsort) {
+	return MAX((int64_t)(extsort->memory_budget / extsort->elem_size) * 2 / 3, 1);
+}
+
+/** Return the number of runs `extsort` merges at once. */
+static int64_t extsort_fan_in(const extsort_t *extsort) {
+	return MIN(MAX((int64_t)(extsort->memory_budget / EXTSORT_MIN_BUFFER_SIZE) - 1, 2), EXTSORT_MAX_FAN_IN);
+}
+
+/** Return the number of elements of each buffer when merging `num_runs` runs,
+ * leaving room for an output buffer of the same size. */
+static int64_t extsort_buffer_capacity(const extsort_t *extsort, int64_t num_runs) {
+	return MAX((int64_t)(extsort->memory_budget / (size_t)(num_runs + 1) / extsort->elem_size), 1);
+}
+
+static void extsort_run_free(extsort_run_t *run) {
+	if (run->file) fclose(run->file);
+	free(run->buffer);
+	free(run);
+}
+
+/** Return a new run holding the `len` elements at `contents` in a new
+ * temporary file, NULL if an I/O error occurred or there is insufficient
+ * memory. */
+static extsort_run_t *extsort_run_new(const extsort_t *extsort, const int8_t *contents, int64_t len) {
+	extsort_run_t *run = calloc(1, sizeof(extsort_run_t));
+	if (!run) return NULL;
+	if (!(run->file = ds_tmpfile()) || fwrite(contents, extsort->elem_size, (size_t)len, run->file) != (size_t)len) {
+		extsort_run_free(run);
+		return NULL;
+	}
+	run->remaining = len;
+	return run;
+}
+
+/** Prepare `run` to be read back from its start with a buffer of `capacity`
+ * elements. Return false if there is insufficient memory. */
+static bool extsort_run_open(const extsort_t *extsort, extsort_run_t *run, int64_t capacity) {
+	rewind(run->file);
+	free(run->buffer);
+	run->capacity = capacity;
+	run->buffer_len = run->pos = 0;
+	return (run->buffer = malloc((size_t)capacity * extsort->elem_size)) != NULL;
+}
+
+/** Return a pointer to the first element of `run` not yet merged, reading more
+ * of the run into its buffer if needed. Return NULL if the run is exhausted or
+ * an I/O error occurred, in which case `failed` is set. */
+static const int8_t *extsort_run_head(extsort_t *extsort, extsort_run_t *run) {
+	if (run->pos == run->buffer_len) {
+		if (!run->remaining) return NULL;
+		int64_t n = MIN(run->capacity, run->remaining);
+		run->pos = 0;
+		if (fread(run->buffer, extsort->elem_size, (size_t)n, run->file) != (size_t)n) {
+			extsort->failed = true;
+			run->remaining = run->buffer_len = 0;
+			return NULL;
+		}
+		run->remaining -= n;
+		run->buffer_len = n;
+	}
+	return ELEM_AT(run->buffer, extsort->elem_size, run->pos);
+}
+
+/** Sort the in-memory run of `extsort` and spill it to a temporary file.
+ * Return false if an I/O error occurred or there is insufficient memory. */
+static bool extsort_spill(extsort_t *extsort) {
+	if (!extsort->run->len) return true;
+	extsort_run_t **runs = realloc(extsort->runs, (size_t)(extsort->num_runs + 1) * sizeof(extsort_run_t *));
+	if (!runs) return false;
+	extsort->runs = runs;
+	arraylist_sort(extsort->run);
+	if (!(runs[extsort->num_runs] = extsort_run_new(extsort, extsort->run->contents, extsort->run->len))) return false;
+	extsort->num_runs++;
+	extsort->run->len = 0;
+	extsort->run->end = extsort->run->contents;
+	return true;
+}
+
+/** Return whether the head of run `x` comes before the head of run `y` in a
+ * merge, where an exhausted run comes last and ties go to the run with the
+ * lower index to keep the sort stable. */
+static bool extsort_before(extsort_t *extsort, extsort_run_t **runs, int64_t x, int64_t y) {
+	const int8_t *head_x = extsort_run_head(extsort, runs[x]);
+	if (!head_x) return false;
+	const int8_t *head_y = extsort_run_head(extsort, runs[y]);
+	if (!head_y) return true;
+	int64_t cmp = extsort->cmp_func(head_x, head_y);
+	return cmp < 0 || (cmp == 0 && x < y);
+}
+
+/** Play the matches of the subtree of node `node` of the loser tree `tree`
+ * merging the `num_runs` runs `runs`, as merge_k_build does, and return the
+ * winner. */
+static int64_t extsort_build(extsort_t *extsort, extsort_run_t **runs, int64_t *tree, int64_t num_runs, int64_t node) {
+	if (node >= num_runs) return node - num_runs;
+	int64_t left = extsort_build(extsort, runs, tree, num_runs, 2 * node);
+	int64_t right = extsort_build(extsort, runs, tree, num_runs, 2 * node + 1);
+	if (extsort_before(extsort, runs, right, left)) {
+		tree[node] = left;
+		return right;
+	}
+	tree[node] = right;
+	return left;
+}
+
+/** Copy the next element of the merge of the `num_runs` runs `runs` with loser
+ * tree `tree` into `dest` and advance the merge. Return false if every run is
+ * exhausted or an I/O error occurred. */
+static bool extsort_merge_next(extsort_t *extsort, extsort_run_t **runs, int64_t *tree, int64_t num_runs, void *dest) {
+	int64_t winner = tree[0];
+	const int8_t *head = extsort_run_head(extsort, runs[winner]);
+	if (!head) return false;
+	memcpy(dest, head, extsort->elem_size);
+	runs[winner]->pos++;
+	for (int64_t node = (winner + num_runs) / 2; node >= 1; node /= 2) {
+		if (extsort_before(extsort, runs, tree[node], winner)) {
+			int64_t loser = winner;
+			winner = tree[node];
+			tree[node] = loser;
+		}
+	}
+	tree[0] = winner;
+	return true;
+}
+
+/** Open the `num_runs` runs `runs` for merging and build their loser tree
+ * into `tree`. Return false if there is insufficient memory. */
+static bool extsort_merge_start(extsort_t *extsort, extsort_run_t **runs, int64_t *tree, int64_t num_runs) {
+	int64_t capacity = extsort_buffer_capacity(extsort, num_runs);
+	for (int64_t i = 0; i < num_runs; i++) {
+		if (!extsort_run_open(extsort, runs[i], capacity)) return false;
+	}
+	tree[0] = extsort_build(extsort, runs, tree, num_runs, 1);
+	return !extsort->failed;
+}
+
+/** Merge the `num_runs` runs `runs` into a single run, which replaces the
+ * first of them. Every other run is freed and its slot set to NULL. Return
+ * false if an I/O error occurred or there is insufficient memory. */
+static bool extsort_merge_pass(extsort_t *extsort, extsort_run_t **runs, int64_t num_runs) {
+	int64_t capacity = extsort_buffer_capacity(extsort, num_runs);
+	int64_t *tree = malloc((size_t)num_runs * sizeof(int64_t));
+	int8_t *output = malloc((size_t)capacity * extsort->elem_size);
+	extsort_run_t *merged = calloc(1, sizeof(extsort_run_t));
+	bool ok = tree && output && merged && (merged->file = ds_tmpfile()) && extsort_merge_start(extsort, runs, tree, num_runs);
+	// write the merge through the output buffer in large sequential writes
+	int64_t output_len = 0;
+	while (ok) {
+		bool more = extsort_merge_next(extsort, runs, tree, num_runs, ELEM_AT(output, extsort->elem_size, output_len));
+		if (more) output_len++;
+		if (output_len == capacity || (!more && output_len)) {
+			ok = fwrite(output, extsort->elem_size, (size_t)output_len, merged->file) == (size_t)output_len;
+			merged->remaining += output_len;
+			output_len = 0;
+		}
+		if (!more) break;
+	}
+	ok = ok && !extsort->failed;
+	for (int64_t i = 0; i < num_runs; i++) {
+		extsort_run_free(runs[i]);
+		runs[i] = NULL;
+	}
+	if (ok) runs[0] = merged;
+	else if (merged) extsort_run_free(merged);
+	free(tree);
+	free(output);
+	return ok;
+}
+
+extsort_t *extsort_new(size_t elem_size, cmp_func_t cmp_func, size_t memory_budget) {
+	extsort_t *extsort = calloc(1, sizeof(extsort_t));
+	if (!extsort) return NULL;
+	extsort->elem_size = elem_size;
+	extsort->cmp_func = cmp_func;
+	extsort->memory_budget = memory_budget;
+	if (!(extsort->run = arraylist_new(elem_size, cmp_func)) ||
+		!arraylist_reserve(extsort->run, extsort_run_capacity(extsort)) ||
+		!(extsort->current = malloc(elem_size))) {
+		extsort_free(extsort);
+		return NULL;
+	}
+	return extsort;
+}
+
+void extsort_free(extsort_t *extsort) {
+	if (extsort->run) arraylist_free(extsort->run);
+	for (int64_t i = 0; i < extsort->num_runs; i++) {
+		if (extsort->runs[i]) extsort_run_free(extsort->runs[i]);
+	}
+	free(extsort->runs);
+	free(extsort->tree);
+	free(extsort->current);
+	free(extsort);
+}
+
+bool extsort_add(extsort_t *extsort, const void *value) {
+	if (extsort->finished || extsort->failed) return false;
+	arraylist_append(extsort->run, value);
+	extsort->len++;
+	if (extsort->run->len == extsort_run_capacity(extsort) && !extsort_spill(extsort)) {
+		extsort->failed = true;
+		return false;
+	}
+	return true;
+}
+
+bool extsort_finish(extsort_t *extsort) {
+	if (extsort->finished || extsort->failed) return !extsort->failed;
+	extsort->finished = true;
+	if (!extsort->num_runs) {
+		// everything fit in memory
+		arraylist_sort(extsort->run);
+		return true;
+	}
+	if (!extsort_spill(extsort)) {
+		extsort->failed = true;
+		return false;
+	}
+	arraylist_free(extsort->run);
+	extsort->run = NULL;
+	// merge consecutive groups of runs until they can all be merged at once
+	int64_t fan_in = extsort_fan_in(extsort);
+	while (extsort->num_runs > fan_in) {
+		int64_t num_merged = 0;
+		for (int64_t first = 0; first < extsort->num_runs; first += fan_in) {
+			int64_t n = MIN(fan_in, extsort->num_runs - first);
+			if (n > 1 && !extsort_merge_pass(extsort, extsort->runs + first, n)) {
+				extsort->failed = true;
+				return false;
+			}
+			extsort_run_t *merged = extsort->runs[first];
+			extsort->runs[first] = NULL;
+			extsort->runs[num_merged++] = merged;
+		}
+		extsort->num_runs = num_merged;
+	}
+	if (!(extsort->tree = malloc((size_t)extsort->num_runs * sizeof(int64_t))) ||
+		!extsort_merge_start(extsort, extsort->runs, extsort->tree, extsort->num_runs)) {
+		extsort->failed = true;
+		return false;
+	}
+	return true;
+}
+
+const void *extsort_next(extsort_t *extsort) {
+	if (!extsort->finished || extsort->failed) return NULL;
+	if (extsort->run) {
+		if (extsort->next == extsort->run->len) return NULL;
+		return ARRAYLIST_GET_UNCHECKED(extsort->run, extsort->next++);
+	}
+	if (!extsort_merge_next(extsort, extsort->runs, extsort->tree, extsort->num_runs, extsort->current)) return NULL;
+	return extsort->current;
+}
+
+bool extsort_write(extsort_t *extsort, const char *path) {
+	if (!extsort->finished || extsort->failed) return false;
+	FILE *file = ds_fopen(path, "wb");
+	if (!file) return false;
+	bool ok;
+	if (extsort->run) {
+		// write the sorted in-memory run at once
+		int64_t n = extsort->run->len - extsort->next;
+		ok = fwrite(ARRAYLIST_GET_UNCHECKED(extsort->run, extsort->next), extsort->elem_size, (size_t)n, file) == (size_t)n;
+		extsort->next = extsort->run->len;
+	} else {
+		int64_t capacity = extsort_buffer_capacity(extsort, extsort->num_runs);
+		int8_t *output = malloc((size_t)capacity * extsort->elem_size);
+		ok = output != NULL;
+		int64_t output_len = 0;
+		while (ok) {
+			bool more = extsort_merge_next(extsort, extsort->runs, extsort->tree, extsort->num_runs,
+				ELEM_AT(output, extsort->elem_size, output_len));
+			if (more) output_len++;
+			if (output_len == capacity || (!more && output_len)) {
+				ok = fwrite(output, extsort->elem_size, (size_t)output_len, file) == (size_t)output_len;
+				output_len = 0;
+			}
+			if (!more) break;
+		}
+		free(output);
+		ok = ok && !extsort->failed;
+	}
+	return fclose(file) == 0 && ok;
+}
+
+/* -------------------------- doubly linked list -------------------------- */
+
+linkedlist_t *linkedlist_new(size_t elem_size, cmp_func_t cmp_func) {
+	PROFILE_FUNCTION();
+	linkedlist_t *linkedlist = malloc(sizeof(linkedlist_t));
+	if (!linkedlist) return NULL;
+	linkedlist->head = NULL;
+	linkedlist->tail = NULL;
+	linkedlist->elem_size = elem_size;
+	linkedlist->len = 0;
+	linkedlist->cmp_func = cmp_func;
+	linkedlist->slab = NULL;
+	linkedlist->slab_len = 0;
+	return linkedlist;
+}
+
+/* Alignment of nodes in the slab, that of blocks returned by malloc on 64-bit
+   platforms */
+#define LINKEDLIST_NODE_ALIGN 16
+
+/** Return the distance between consecutive nodes in the slab of `linkedlist`,
+ * a multiple of LINKEDLIST_NODE_ALIGN so that each node is aligned like one
+ * returned by malloc. */
+static size_t linkedlist_node_stride(const linkedlist_t *linkedlist) {
+	size_t size = sizeof(linkedlistnode_t) + linkedlist->elem_size;
+	return (size + LINKEDLIST_NODE_ALIGN - 1) / LINKEDLIST_NODE_ALIGN * LINKEDLIST_NODE_ALIGN;
+}
+
+/** Return whether `node` lies in the slab of `linkedlist` rather than in an
+ * allocation of its own. */
+static bool linkedlist_in_slab(const linkedlist_t *linkedlist, const linkedlistnode_t *node) {
+	uintptr_t start = (uintptr_t)linkedlist->slab;
+	return (uintptr_t)node - start < (uintptr_t)linkedlist->slab_len * linkedlist_node_stride(linkedlist);
+}
+
+/** Free every node of `linkedlist` that has an allocation of its own, and the
+ * slab. */
+static void linkedlist_free_nodes(linkedlist_t *linkedlist) {
+	linkedlistnode_t *node = linkedlist->head;
+	while (node) {
+		linkedlistnode_t *prev_node = node;
+		node = node->next;
+		if (!linkedlist_in_slab(linkedlist, prev_node)) free(prev_node);
+	}
+	free(linkedlist->slab);
+}
+
+void linkedlist_free(linkedlist_t *linkedlist) {
+	PROFILE_FUNCTION();
+	linkedlist_free_nodes(linkedlist);
+	free(linkedlist);
+}
+
+int64_t linkedlist_len(linkedlist_t *linkedlist) {
+	PROFILE_FUNCTION();
+	return linkedlist->len;
+}
+
+/** Return a new node holding a copy of `value`, NULL if there is insufficient
+ * memory. */
+static linkedlistnode_t *linkedlist_node_new(const linkedlist_t *linkedlist, const void *value) {
+	linkedlistnode_t *node = malloc(sizeof(linkedlistnode_t) + linkedlist->elem_size);
+	if (!node) return NULL;
+	memcpy(node->value, value, linkedlist->elem_size);
+	return node;
+}
+
+linkedlistnode_t *linkedlist_append(linkedlist_t *linkedlist, const void *value) {
+	PROFILE_FUNCTION();
+	linkedlistnode_t *node = linkedlist_node_new(linkedlist, value);
+	if (!node) return NULL;
+	node->prev = linkedlist->tail;
+	node->next = NULL;
+	if (linkedlist->tail) linkedlist->tail->next = node;
+	else linkedlist->head = node;
+	linkedlist->tail = node;
+	linkedlist->len++;
+	return node;
+}
+
+linkedlistnode_t *linkedlist_prepend(linkedlist_t *linkedlist, const void *value) {
+	PROFILE_FUNCTION();
+	linkedlistnode_t *node = linkedlist_node_new(linkedlist, value);
+	if (!node) return NULL;
+	node->prev = NULL;
+	node->next = linkedlist->head;
+	if (linkedlist->head) linkedlist->head->prev = node;
+	else linkedlist->tail = node;
+	linkedlist->head = node;
+	linkedlist->len++;
+	return node;
+}
+
+void linkedlist_delete(linkedlist_t *linkedlist, linkedlistnode_t *node) {
+	PROFILE_FUNCTION();
+	if (node->prev) node->prev->next = node->next;
+	else linkedlist->head = node->next;
+	if (node->next) node->next->prev = node->prev;
+	else linkedlist->tail = node->prev;
+	linkedlist->len--;
+	// nodes in the slab are reclaimed by the next compaction
+	if (!linkedlist_in_slab(linkedlist, node)) free(node);
+}
+
+bool linkedlist_compact(linkedlist_t *linkedlist) {
+	PROFILE_FUNCTION();
+	size_t stride = linkedlist_node_stride(linkedlist);
+	int8_t *slab = malloc((size_t)MAX(linkedlist->len, 1) * stride);
+	if (!slab) return false;
+	linkedlistnode_t *prev = NULL;
+	int8_t *dest = slab;
+	for (linkedlistnode_t *node = linkedlist->head; node; node = node->next, dest += stride) {
+		linkedlistnode_t *copy = (linkedlistnode_t *)dest;
+		memcpy(copy->value, node->value, linkedlist->elem_size);
+		copy->prev = prev;
+		copy->next = NULL;
+		if (prev) prev->next = copy;
+		prev = copy;
+	}
+	linkedlist_free_nodes(linkedlist);
+	linkedlist->slab = slab;
+	linkedlist->slab_len = linkedlist->len;
+	linkedlist->head = linkedlist->len ? (linkedlistnode_t *)slab : NULL;
+	linkedlist->tail = prev;
+	return true;
+}
+
+void linkedlist_foreach(linkedlist_t *linkedlist, void(*func)(void*)) {
+	PROFILE_FUNCTION();
+	for (linkedlistnode_t *node = linkedlist->head; node; node = node->next) {
+		func(node->value);
+	}
+}
+
+linkedlistnode_t *linkedlist_find(const linkedlist_t *linkedlist, const void *value) {
+	PROFILE_FUNCTION();
+	for (linkedlistnode_t *node = linkedlist->head; node; node = node->next) {
+		if (!linkedlist->cmp_func(node->value, value)) return node;
+	}
+	return NULL;
+}
+
+int64_t linkedlist_count(const linkedlist_t *linkedlist, const void *value) {
+	PROFILE_FUNCTION();
+	int64_t count = 0;
+	for (const linkedlistnode_t *node = linkedlist->head; node; node = node->next) {
+		if (!linkedlist->cmp_func(node->value, value)) count++;
+	}
+	return count;
+}
+
+/* ------------------------- intrusive linked list ------------------------- */
+
+void ds_link_init(ds_link_t *link) {
+	link->prev = link;
+	link->next = link;
+}
+
+bool ds_link_is_linked(const ds_link_t *link) {
+	return link->next != link;
+}
+
+void ds_link_insert_before(ds_link_t *pos, ds_link_t *link) {
+	link->prev = pos->prev;
+	link->next = pos;
+	pos->prev->next = link;
+	pos->prev = link;
+}
+
+void ds_link_insert_after(ds_link_t *pos, ds_link_t *link) {
+	ds_link_insert_before(pos->next, link);
+}
+
+void ds_link_unlink(ds_link_t *link) {
+	link->prev->next = link->next;
+	link->next->prev = link->prev;
+	ds_link_init(link);
+}
+
+void ds_link_splice(ds_link_t *pos, ds_link_t *head) {
+	if (!ds_link_is_linked(head)) return;
+	ds_link_t *first = head->next, *last = head->prev;
+	first->prev = pos->prev;
+	last->next = pos;
+	pos->prev->next = first;
+	pos->prev = last;
+	ds_link_init(head);
+}
+
+void ds_link_move_to_front(ds_link_t *head, ds_link_t *link) {
+	if (head->next == link) return;
+	ds_link_unlink(link);
+	ds_link_insert_after(head, link);
+}
+
+/* --------------------------------- cache --------------------------------- */
+
+/* Alignment of the keys and values in the entries of a cache */
+#define CACHE_ENTRY_ALIGN 8
+
+/* Round `size` up to a multiple of CACHE_ENTRY_ALIGN */
+#define CACHE_ALIGN_UP(size) (((size) + CACHE_ENTRY_ALIGN - 1) / CACHE_ENTRY_ALIGN * CACHE_ENTRY_ALIGN)
+
+/* Header of an entry of a cache, followed by its key and then its value */
+struct cache_entry_t {
+	ds_link_t link;		// position in the recency list when used with LRU, in the free list when unused
+	int64_t next;		// index of the next entry in the same bucket, -1 if last
+	bool used;			// whether the entry holds a key
+	bool referenced;	// whether the entry was hit since the clock hand last passed it
+};
+
+/* Offset of the key in an entry of a cache */
+#define CACHE_KEY_OFFSET CACHE_ALIGN_UP(sizeof(cache_entry_t))
+
+/** Return the entry at index `index` of `cache`. */
+static cache_entry_t *cache_entry(const cache_t *cache, int64_t index) {
+	return (cache_entry_t *)ELEM_AT(cache->entries, cache->entry_size, index);
+}
+
+/** Return the index of `entry` in `cache`. */
+static int64_t cache_entry_index(const cache_t *cache, const cache_entry_t *entry) {
+	return ((const int8_t *)entry - cache->entries) / (int64_t)cache->entry_size;
+}
+
+static void *cache_entry_key(const cache_entry_t *entry) {
+	return (int8_t *)entry + CACHE_KEY_OFFSET;
+}
+
+static void *cache_entry_value(const cache_t *cache, const cache_entry_t *entry) {
+	return (int8_t *)entry + CACHE_KEY_OFFSET + CACHE_ALIGN_UP(cache->key_size);
+}
+
+/** Return the bucket of `cache` that holds `key`. */
+static int64_t *cache_bucket(const cache_t *cache, const void *key) {
+	return &cache->buckets[ds_mix64(cache->hash_func(key)) & (uint64_t)(cache->num_buckets - 1)];
+}
+
+/** Return the index of the entry of `cache` holding `key`, -1 if there is none.
+ * Store in `link` the location of the index of that entry in its chain. */
+static int64_t cache_find(const cache_t *cache, const void *key, int64_t **link) {
+	*link = cache_bucket(cache, key);
+	while (**link != -1) {
+		cache_entry_t *entry = cache_entry(cache, **link);
+		if (!cache->cmp_func(cache_entry_key(entry), key)) return **link;
+		*link = &entry->next;
+	}
+	return -1;
+}
+
+/** Remove the entry of `cache` whose index is stored at `link` from its bucket
+ * and the recency list and put it on the free list. */
+static void cache_release(cache_t *cache, int64_t *link) {
+	cache_entry_t *entry = cache_entry(cache, *link);
+	*link = entry->next;
+	if (cache->policy == CACHE_LRU) ds_link_unlink(&entry->link);
+	entry->used = false;
+	ds_link_insert_after(&cache->free, &entry->link);
+	cache->len--;
+}
+
+/** Evict an entry of the full `cache` chosen by its policy. */
+static void cache_evict(cache_t *cache) {
+	cache_entry_t *victim;
+	if (cache->policy == CACHE_LRU) {
+		victim = DS_CONTAINER_OF(cache->recency.prev, cache_entry_t, link);
+	} else {
+		// give every referenced entry the hand passes a second chance
+		for (;;) {
+			victim = cache_entry(cache, cache->hand);
+			cache->hand = (cache->hand + 1) % cache->capacity;
+			if (!victim->referenced) break;
+			victim->referenced = false;
+		}
+	}
+	if (cache->evict_func) cache->evict_func(cache_entry_key(victim), cache_entry_value(cache, victim), cache->evict_ctx);
+	int64_t *link;
+	cache_find(cache, cache_entry_key(victim), &link);
+	cache_release(cache, link);
+	cache->evictions++;
+}
+
+/** Record a hit on `entry` of `cache`. */
+static void cache_touch(cache_t *cache, cache_entry_t *entry) {
+	if (cache->policy == CACHE_LRU) ds_link_move_to_front(&cache->recency, &entry->link);
+	else entry->referenced = true;
+}
+
+cache_t *cache_new(int64_t capacity, size_t key_size, size_t value_size, hash_func_t hash_func, cmp_func_t cmp_func, cache_policy_t policy) {
+	cache_t *cache = malloc(sizeof(cache_t));
+	if (!cache) return NULL;
+	cache->capacity = MAX(capacity, 1);
+	cache->len = 0;
+	cache->key_size = key_size;
+	cache->value_size = value_size;
+	cache->entry_size = CACHE_KEY_OFFSET + CACHE_ALIGN_UP(key_size) + CACHE_ALIGN_UP(value_size);
+	cache->hash_func = hash_func;
+	cache->cmp_func = cmp_func;
+	cache->policy = policy;
+	cache->evict_func = NULL;
+	cache->evict_ctx = NULL;
+	cache->hand = 0;
+	cache->hits = cache->misses = cache->evictions = 0;
+	cache->num_buckets = (int64_t)1 << (cache->capacity > 1 ? ds_msb64((uint64_t)cache->capacity - 1) + 1 : 0);
+	cache->entries = malloc((size_t)cache->capacity * cache->entry_size);
+	cache->buckets = malloc((size_t)cache->num_buckets * sizeof(int64_t));
+	if (!cache->entries || !cache->buckets) {
+		cache_free(cache);
+		return NULL;
+	}
+	for (int64_t i = 0; i < cache->num_buckets; i++) {
+		cache->buckets[i] = -1;
+	}
+	ds_link_init(&cache->recency);
+	ds_link_init(&cache->free);
+	for (int64_t i = 0; i < cache->capacity; i++) {
+		cache_entry_t *entry = cache_entry(cache, i);
+		entry->used = false;
+		entry->referenced = false;
+		ds_link_insert_before(&cache->free, &entry->link);
+	}
+	return cache;
+}
+
+void cache_free(cache_t *cache) {
+	free(cache->entries);
+	free(cache->buckets);
+	free(cache);
+}
+
+int64_t cache_len(const cache_t *cache) {
+	return cache->len;
+}
+
+void cache_on_evict(cache_t *cache, cache_evict_func_t evict_func, void *ctx) {
+	cache->evict_func = evict_func;
+	cache->evict_ctx = ctx;
+}
+
+void *cache_get(cache_t *cache, const void *key) {
+	int64_t *link;
+	int64_t index = cache_find(cache, key, &link);
+	if (index == -1) {
+		cache->misses++;
+		return NULL;
+	}
+	cache->hits++;
+	cache_entry_t *entry = cache_entry(cache, index);
+	cache_touch(cache, entry);
+	return cache_entry_value(cache, entry);
+}
+
+void *cache_put(cache_t *cache, const void *key, const void *value) {
+	int64_t *link;
+	int64_t index = cache_find(cache, key, &link);
+	cache_entry_t *entry;
+	if (index != -1) {
+		entry = cache_entry(cache, index);
+		cache_touch(cache, entry);
+	} else {
+		if (!ds_link_is_linked(&cache->free)) cache_evict(cache);
+		entry = DS_CONTAINER_OF(cache->free.next, cache_entry_t, link);
+		ds_link_unlink(&entry->link);
+		entry->used = true;
+		entry->referenced = false;
+		memcpy(cache_entry_key(entry), key, cache->key_size);
+		int64_t *bucket = cache_bucket(cache, key);
+		entry->next = *bucket;
+		*bucket = cache_entry_index(cache, entry);
+		if (cache->policy == CACHE_LRU) ds_link_insert_after(&cache->recency, &entry->link);
+		cache->len++;
+	}
+	memcpy(cache_entry_value(cache, entry), value, cache->value_size);
+	return cache_entry_value(cache, entry);
+}
+
+bool cache_remove(cache_t *cache, const void *key) {
+	int64_t *link;
+	int64_t index = cache_find(cache, key, &link);
+	if (index == -1) return false;
+	cache_release(cache, link);
+	return true;
+}
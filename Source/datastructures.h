@@ -3,6 +3,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdio.h>
 
 #ifdef _WIN32
 	#ifdef DATASTRUCTURES_EXPORTS
@@ -19,6 +21,99 @@
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))
 #define COUNTOF(arr) (sizeof(arr) / sizeof((arr)[0]))
 
+/* ------------------------------- profiling ------------------------------- */
+
+/* Building the library with DS_PROFILE defined records the latency of every
+   call of a public arraylist or linkedlist function in a log-bucketed
+   histogram per function, and on Linux optionally hardware counters read with
+   perf_event_open. Only the outermost profiled call on a thread is recorded:
+   public functions called by another one, such as arraylist_append from
+   arraylist_extend or from a callback of arraylist_foreach, count as part of
+   the outer call. Without DS_PROFILE the functions below report nothing. */
+
+/** Statistics of a profiled function */
+typedef struct {
+	const char *name;		// name of the function
+	int64_t count;			// number of calls recorded
+	int64_t p50;			// median latency, in nanoseconds
+	int64_t p99;			// 99th percentile latency, in nanoseconds
+	int64_t p999;			// 99.9th percentile latency, in nanoseconds
+	int64_t max;			// greatest latency, in nanoseconds
+	double cycles;			// average CPU cycles per call, 0 if not measured
+	double cache_misses;	// average cache misses per call, 0 if not measured
+	double branch_misses;	// average branch mispredictions per call, 0 if not measured
+} ds_profile_stats_t;
+
+/** Start or stop reading the cycle, cache miss and branch miss counters around
+ * every profiled call, which costs two system calls per call. Only supported
+ * on Linux. Return false if the counters cannot be read, such as when
+ * perf_event_paranoid forbids it.
+ * @param enable: whether to read the counters
+ * @return: whether the setting was applied */
+DS_API bool ds_profile_enable_counters(bool enable);
+
+/** Store the statistics of up to `max_stats` profiled functions in `stats`.
+ * Latencies are rounded up to the bucket holding them, at most 1/16 too high.
+ * Return the number of functions profiled, which may exceed `max_stats`.
+ * @param stats: array that receives the statistics
+ * @param max_stats: length of `stats`
+ * @return: number of functions profiled */
+DS_API int64_t ds_profile_snapshot(ds_profile_stats_t *stats, int64_t max_stats);
+
+/** Write a table of the statistics of every profiled function to `file`.
+ * @param file: the file to write to */
+DS_API void ds_profile_report(FILE *file);
+
+/** Discard every statistic recorded so far. Calls in progress in other threads
+ * may still be recorded afterwards. */
+DS_API void ds_profile_reset(void);
+
+/* ----------------------------- Bloom filter ----------------------------- */
+
+/** Hash function type. Elements that compare equal must have equal hashes. */
+typedef uint64_t (*hash_func_t)(const void*);
+
+/** Blocked Bloom filter type. A Bloom filter is a set that answers membership
+ * queries with no false negatives and a small rate of false positives. Each
+ * element sets 8 bits within a single cache-line-sized block, so a query
+ * touches one cache line. */
+typedef struct {
+	uint64_t *blocks;		// bits of the filter, cache line aligned
+	int64_t num_blocks;		// number of blocks of 8 words
+	int64_t capacity;		// number of elements the filter was sized for
+	int64_t count;			// number of elements added since the filter was cleared
+	int64_t bits_per_elem;	// number of bits per element at capacity
+	hash_func_t hash_func;	// hash function
+} bloom_t;
+
+/** Create and return a new, empty Bloom filter sized for `capacity` elements.
+ * With 12 bits per element, the false positive rate at capacity is about 0.5%.
+ * Return NULL if there is insufficient memory.
+ * @param capacity: expected number of elements, >=0
+ * @param bits_per_elem: number of bits per element at capacity, >0
+ * @param hash_func: hash function of the elements
+ * @return: the Bloom filter created */
+DS_API bloom_t *bloom_new(int64_t capacity, int64_t bits_per_elem, hash_func_t hash_func);
+
+/** Free a Bloom filter.
+ * @param bloom: the Bloom filter to free */
+DS_API void bloom_free(bloom_t *bloom);
+
+/** Add `value` to a Bloom filter.
+ * @param bloom: the Bloom filter
+ * @param value: the value to add */
+DS_API void bloom_add(bloom_t *bloom, const void *value);
+
+/** Return false if `value` was definitely not added to a Bloom filter since it
+ * was last cleared, true if it may have been.
+ * @param bloom: the Bloom filter
+ * @param value: the value to search for */
+DS_API bool bloom_may_contain(const bloom_t *bloom, const void *value);
+
+/** Remove all elements from a Bloom filter.
+ * @param bloom: the Bloom filter */
+DS_API void bloom_clear(bloom_t *bloom);
+
 /* -------------------------- variable size array -------------------------- */
 
 /** Comparison function type */
@@ -32,8 +127,22 @@ typedef struct {
 	int8_t *contents;		// raw contents of array, must be able to hold at least 1 element
 	int8_t *end;			// pointer just past last element of array, = contents + len * elem_size
 	cmp_func_t cmp_func;	// comparison function
+	size_t alignment;		// alignment of contents in bytes, 0 for the default alignment of malloc
+	bool huge_pages;		// whether large contents are mapped with huge pages where supported
+	volatile int64_t *refcount;	// number of arraylists sharing contents, NULL if contents are not shared
+	bloom_t *bloom;			// Bloom filter of the elements, NULL if none is attached
 } arraylist_t;
 
+/** Read-only view of a range of elements of an arraylist. A view does not own
+ * its elements; it is invalidated by any operation that modifies or reallocates
+ * the contents of the arraylist it was created from. */
+typedef struct {
+	const int8_t *contents;	// first element of the view
+	int64_t len;			// number of elements in the view
+	size_t elem_size;		// size of each element, in bytes
+	cmp_func_t cmp_func;	// comparison function
+} arraylist_view_t;
+
 /** Arraylist iterator type */
 typedef struct {
 	const arraylist_t *arraylist;	// arraylist over which we are iterating
@@ -47,6 +156,21 @@ typedef struct {
  * @return: the arraylist created */
 DS_API arraylist_t *arraylist_new(size_t elem_size, cmp_func_t cmp_func);
 
+/** Create and return a new empty arraylist whose contents are aligned to
+ * `alignment` bytes, for example 32 or 64 for SIMD loads. If `huge_pages` is
+ * true, then on Linux contents of at least 2 MiB are allocated with mmap and
+ * advised to use transparent huge pages, reducing TLB misses on very large
+ * arraylists. Both options are kept whenever the contents
+ * are reallocated and by arraylist_copy. Return NULL if there is insufficient
+ * memory.
+ * @param elem_size: size, in bytes, of each element of array.
+ * @param cmp_func: comparison function
+ * @param alignment: alignment of contents in bytes, a power of 2, or 0 for the
+ *   default alignment
+ * @param huge_pages: whether to use huge pages for large contents
+ * @return: the arraylist created */
+DS_API arraylist_t *arraylist_new_aligned(size_t elem_size, cmp_func_t cmp_func, size_t alignment, bool huge_pages);
+
 /** Create and return a new arraylist from a given array by copying its
  * contents. If `array_len` is 0, an empty arraylist is returned. Return NULL
  * if there is insufficient memory.
@@ -68,7 +192,9 @@ DS_API int64_t arraylist_len(const arraylist_t *arraylist);
  * Bytes are copied from `value` into the array.
  * If `index` is greater than or equal to the size, return NULL. If `index` is
  * negative, then read backward from the right end of the arraylist. If `index`
- * is less than the negative of the size of the arraylist, return NULL.
+ * is less than the negative of the size of the arraylist, return NULL. Also
+ * return NULL if there is insufficient memory to unshare the contents of a
+ * copy-on-write copy.
  * @param arraylist: the arraylist
  * @param index: the index in the arraylist
  * @param value: the value to assign
@@ -76,7 +202,9 @@ DS_API int64_t arraylist_len(const arraylist_t *arraylist);
 DS_API void *arraylist_set(arraylist_t *arraylist, int64_t index, const void *value);
 
 /** Return a pointer to an element of an arraylist. Return NULL if `index` is
- * out of bounds. Negative indices are supported as in array_set.
+ * out of bounds. Negative indices are supported as in array_set. While the
+ * contents are shared with a copy-on-write copy, the element must not be
+ * modified through the returned pointer.
  * @param arraylist: the arraylist
  * @param index: index of the element to get
  * @return: pointer to the requested element */
@@ -117,6 +245,26 @@ DS_API int64_t arraylist_extend(arraylist_t *dest, const arraylist_t *source);
  * @param value: value to insert */
 DS_API void *arraylist_insert(arraylist_t *arraylist, int64_t index, const void *value);
 
+/** Attach a Bloom filter to `arraylist` so that arraylist_contains,
+ * arraylist_find, arraylist_rfind, arraylist_count and arraylist_remove return
+ * without scanning for most values that are not in the arraylist. Any filter
+ * already attached is replaced. The filter is kept up to date by the functions
+ * that add elements and is rebuilt when the arraylist outgrows it, when it
+ * shrinks to a fraction of it, and after functions that may modify every
+ * element, such as arraylist_foreach. Elements modified through pointers
+ * returned by other functions are not tracked; attach the filter again
+ * afterwards. The filter is not shared with copies of the arraylist. Return
+ * false if there is insufficient memory.
+ * @param arraylist: the arraylist
+ * @param hash_func: hash function of the elements, consistent with the
+ *   comparison function
+ * @return: whether the filter was attached */
+DS_API bool arraylist_attach_bloom(arraylist_t *arraylist, hash_func_t hash_func);
+
+/** Detach and free the Bloom filter of `arraylist`, if any.
+ * @param arraylist: the arraylist */
+DS_API void arraylist_detach_bloom(arraylist_t *arraylist);
+
 /** Determine whether `arraylist` contains `value` using the comparison function.
  * @param arraylist: the arraylist
  * @param value: value to search for */
@@ -130,6 +278,44 @@ DS_API bool arraylist_contains(const arraylist_t *arraylist, const void *value);
 * @return: whether removal was successful */
 DS_API bool arraylist_remove(arraylist_t *arraylist, const void *value);
 
+/** Remove every element of `arraylist` for which `pred` returns true in a
+ * single pass, keeping the order of the other elements, and shrink the
+ * arraylist at most once. Return the number of elements removed, 0 if there is
+ * insufficient memory to unshare the contents of a copy-on-write copy.
+ * @param arraylist: the arraylist
+ * @param pred: predicate called with a pointer to an element and `ctx`
+ * @param ctx: context passed to `pred`
+ * @return: number of elements removed */
+DS_API int64_t arraylist_remove_if(arraylist_t *arraylist, bool(*pred)(const void*, void*), void *ctx);
+
+/** Remove every occurrence of `value` from `arraylist` using its comparison
+ * function, as arraylist_remove_if does.
+ * @param arraylist: the arraylist
+ * @param value: value to remove
+ * @return: number of elements removed */
+DS_API int64_t arraylist_remove_all(arraylist_t *arraylist, const void *value);
+
+/** Reorder `arraylist` so that the elements for which `pred` returns true come
+ * before the others, in a single pass without allocating. The relative order
+ * of the elements is not kept. Return the number of elements for which `pred`
+ * returned true, -1 if there is insufficient memory to unshare the contents of
+ * a copy-on-write copy.
+ * @param arraylist: the arraylist
+ * @param pred: predicate called with a pointer to an element and `ctx`
+ * @param ctx: context passed to `pred`
+ * @return: index of the first element for which `pred` returned false */
+DS_API int64_t arraylist_partition(arraylist_t *arraylist, bool(*pred)(const void*, void*), void *ctx);
+
+/** Reorder `arraylist` as arraylist_partition does, keeping the relative order
+ * of the elements within each group. Uses a temporary buffer as large as the
+ * arraylist. Return -1 if there is insufficient memory, in which case the
+ * arraylist is unchanged.
+ * @param arraylist: the arraylist
+ * @param pred: predicate called with a pointer to an element and `ctx`
+ * @param ctx: context passed to `pred`
+ * @return: index of the first element for which `pred` returned false */
+DS_API int64_t arraylist_stable_partition(arraylist_t *arraylist, bool(*pred)(const void*, void*), void *ctx);
+
 /** Delete the element at index `index` in `arraylist`. If deletion was
  * successful, then return true. If `index` is out of bounds, then return
  * false and do not modify the arraylist.
@@ -187,22 +373,174 @@ DS_API int64_t arraylist_rfind(const arraylist_t *arraylist, const void *value);
  * @return: number of times `value` appears */
 DS_API int64_t arraylist_count(const arraylist_t *arraylist, const void *value);
 
-/** Sort `arraylist` using its comparison function.
+/** Store in `out_indices[i]` the index of the first occurrence of `keys[i]` in
+ * `arraylist` using the comparison function, -1 if it is not in the
+ * arraylist, for each of the `num_keys` keys. Batches of keys are compared
+ * against each block of the arraylist while it is in cache, so the arraylist
+ * is read from memory once per batch rather than once per key.
+ * @param arraylist: the arraylist
+ * @param keys: array of `num_keys` values of the element type
+ * @param num_keys: number of keys
+ * @param out_indices: array of `num_keys` indices that receives the results */
+DS_API void arraylist_find_many(const arraylist_t *arraylist, const void *keys, int64_t num_keys, int64_t *out_indices);
+
+/** Store in `out_indices[i]` the index of the first element of the sorted
+ * `arraylist` that is not less than `keys[i]`, or the length of the arraylist
+ * if every element is less, for each of the `num_keys` keys. Binary searches
+ * for several keys run in lockstep, each prefetching its next probe, so that
+ * their cache misses overlap instead of following one another.
+ * @param arraylist: the arraylist, sorted in ascending order
+ * @param keys: array of `num_keys` values of the element type
+ * @param num_keys: number of keys
+ * @param out_indices: array of `num_keys` indices that receives the results */
+DS_API void arraylist_lower_bound_many(const arraylist_t *arraylist, const void *keys, int64_t num_keys, int64_t *out_indices);
+
+/** Sort `arraylist` using its comparison function. The sort is stable and
+ * takes O(n log n) time, merging runs through a buffer of half the length of
+ * the arraylist, or in place if that buffer cannot be allocated.
  * @param arraylist: the arraylist */
 DS_API void arraylist_sort(arraylist_t *arraylist);
 
+/** Sort `arraylist` as in arraylist_sort, using the caller's `buffer` instead
+ * of allocating one. Merges whose smaller run does not fit in the buffer are
+ * done in place by rotations, so a NULL buffer sorts with no extra memory in
+ * O(n log^2 n) time.
+ * @param arraylist: the arraylist
+ * @param buffer: temporary space for `buffer_len` elements, NULL if none
+ * @param buffer_len: number of elements `buffer` can hold, half the length of
+ *   `arraylist` for every merge to use it */
+DS_API void arraylist_sort_buffered(arraylist_t *arraylist, void *buffer, int64_t buffer_len);
+
+/** Replace the contents of `dest_indices` with the indices of the elements of
+ * `arraylist` in sorted order, so that the element at index
+ * `dest_indices[i]` is the `i`th smallest, without moving any element of
+ * `arraylist`. The sort is stable. Prefer it to arraylist_sort for large
+ * elements, followed by arraylist_apply_permutation to reorder them. Return
+ * false if there is insufficient memory.
+ * @param arraylist: the arraylist
+ * @param dest_indices: arraylist of int64_t that receives the indices, distinct
+ *   from `arraylist`
+ * @return: whether the indices were sorted */
+DS_API bool arraylist_argsort(const arraylist_t *arraylist, arraylist_t *dest_indices);
+
+/** Reorder `arraylist` in place so that its element at index `i` is the one
+ * previously at index `indices[i]`, following each cycle of the permutation
+ * with a single element of temporary space, so that each element is moved
+ * once. Return false, leaving `arraylist` unchanged, if `indices` is not a
+ * permutation of the indices of `arraylist` or there is insufficient memory.
+ * @param arraylist: the arraylist to reorder
+ * @param indices: arraylist of int64_t holding a permutation, such as the
+ *   output of arraylist_argsort
+ * @return: whether the arraylist was reordered */
+DS_API bool arraylist_apply_permutation(arraylist_t *arraylist, const arraylist_t *indices);
+
 /** Reverse the elements of `arraylist`.
  * @param arraylist: the arraylist
  * @param temp: a buffer large enough to hold one element, used for temporary
  *     space during swaping operations */
 DS_API void arraylist_reverse(arraylist_t *arraylist, void *temp);
 
+/** Reorder `arraylist` so that the element at index `n` is the one that would
+ * be there if the arraylist were sorted, with no greater element before it
+ * and no smaller element after it, in linear time on average and O(n log n)
+ * time in the worst case (introselect). Negative indices are supported. Return
+ * a pointer to the element at index `n`, NULL if `n` is out of bounds or there
+ * is insufficient memory to unshare the contents of a copy-on-write copy.
+ * @param arraylist: the arraylist
+ * @param n: index of the element to select
+ * @return: pointer to the selected element */
+DS_API void *arraylist_nth_element(arraylist_t *arraylist, int64_t n);
+
+/** Reorder `arraylist` so that its first `k` elements are its `k` smallest in
+ * ascending order, in O(n + k log k) time. The order of the other elements is
+ * unspecified. `k` is clamped to the length of the arraylist. Return false if
+ * there is insufficient memory to unshare the contents of a copy-on-write
+ * copy.
+ * @param arraylist: the arraylist
+ * @param k: number of elements to sort
+ * @return: whether the arraylist was reordered */
+DS_API bool arraylist_partial_sort(arraylist_t *arraylist, int64_t k);
+
+/** Replace the contents of `dest` with the `k` greatest elements of `arraylist`
+ * in descending order, in O(n log k) time using a heap of `k` elements built in
+ * `dest`. `k` is clamped to the length of `arraylist`, which is unchanged.
+ * Return false if there is insufficient memory.
+ * @param arraylist: the arraylist
+ * @param k: number of elements to select
+ * @param dest: the arraylist that receives the elements, must have elements of
+ *   the same type as `arraylist` and be distinct from it
+ * @return: whether the elements were selected */
+DS_API bool arraylist_top_k(const arraylist_t *arraylist, int64_t k, arraylist_t *dest);
+
+/** Replace the contents of `dest` with the elements of the sorted arraylists
+ * `a` and `b` merged in sorted order, in linear time. The merge is stable:
+ * equal elements keep their order, those of `a` first. When one input wins
+ * many times in a row, its run is found by galloping search and copied at
+ * once, so merging skewed inputs takes far fewer comparisons. Return false if
+ * there is insufficient memory.
+ * @param a: the first sorted arraylist
+ * @param b: the second sorted arraylist, must have elements of the same type as
+ *   `a`
+ * @param dest: the arraylist that receives the elements, must have elements of
+ *   the same type as `a` and be distinct from `a` and `b`
+ * @return: whether the arraylists were merged */
+DS_API bool arraylist_merge(const arraylist_t *a, const arraylist_t *b, arraylist_t *dest);
+
+/** Merge the adjacent sorted ranges of `arraylist` from index `start` to just
+ * before index `mid` and from index `mid` to just before index `end` into one
+ * sorted range, stably. A buffer as large as the first range is used if it can
+ * be allocated; otherwise the merge is done without one in O(n log n) time.
+ * Return false if the indices are not 0 <= `start` <= `mid` <= `end` <= length
+ * or there is insufficient memory to unshare the contents of a copy-on-write
+ * copy.
+ * @param arraylist: the arraylist
+ * @param start: index of the first element of the first range
+ * @param mid: index of the first element of the second range
+ * @param end: index just past the last element of the second range
+ * @return: whether the ranges were merged */
+DS_API bool arraylist_merge_inplace(arraylist_t *arraylist, int64_t start, int64_t mid, int64_t end);
+
+/** Merge adjacent sorted ranges as in arraylist_merge_inplace, using the
+ * caller's `buffer` instead of allocating one. The merge goes through the
+ * buffer if it can hold the smaller range, and is done in place otherwise.
+ * Return false as in arraylist_merge_inplace.
+ * @param arraylist: the arraylist
+ * @param start: index of the first element of the first range
+ * @param mid: index of the first element of the second range
+ * @param end: index just past the last element of the second range
+ * @param buffer: temporary space for `buffer_len` elements, NULL if none
+ * @param buffer_len: number of elements `buffer` can hold
+ * @return: whether the ranges were merged */
+DS_API bool arraylist_merge_inplace_buffered(arraylist_t *arraylist, int64_t start, int64_t mid, int64_t end, void *buffer, int64_t buffer_len);
+
+/** Replace the contents of `dest` with the elements of the `k` sorted
+ * arraylists `lists` merged in sorted order, using a loser tree so that each
+ * element costs about log2(k) comparisons. The merge is stable: equal
+ * elements keep their order, those of lists with lower indices first. Return
+ * false if there is insufficient memory.
+ * @param lists: the sorted arraylists, with elements of the same type
+ * @param k: number of arraylists, >=0
+ * @param dest: the arraylist that receives the elements, must have elements of
+ *   the same type as the arraylists and be distinct from all of them
+ * @return: whether the arraylists were merged */
+DS_API bool arraylist_merge_k(const arraylist_t *const *lists, int64_t k, arraylist_t *dest);
+
 /** Return a shallow copy of `arraylist`. Return NULL if there is insufficient
  * memory.
  * @param arraylist: the arraylist
  * @return: a copy of `arraylist` */
 DS_API arraylist_t *arraylist_copy(const arraylist_t *arraylist);
 
+/** Return a copy-on-write copy of `arraylist` in O(1) time. The copy shares the
+ * contents of `arraylist` through a reference count until either of them is
+ * modified, at which point the modified arraylist makes its own copy of the
+ * contents. Modifying functions that cannot make that copy for lack of memory
+ * fail as they do when they cannot grow the arraylist. The copy must be freed
+ * with arraylist_free. Return NULL if there is insufficient memory.
+ * @param arraylist: the arraylist
+ * @return: a copy of `arraylist` */
+DS_API arraylist_t *arraylist_cow_copy(arraylist_t *arraylist);
+
 /** Return a negative number if `arraylist1` is less than `arraylist2`, 0 if
  * `arraylist1` is equal to `arraylist2`, a positive number if `arraylist1` is
  * greater than `arraylist2`. Comparison is done one element at a time using the
@@ -241,29 +579,1025 @@ DS_API void *arraylist_iter_next(arraylist_iter_t *iter);
 DS_API void arraylist_iter_reset(arraylist_iter_t *iter);
 
 
-/* -------------------------- doubly linked list -------------------------- */
+/* ---------------------------- arraylist views ---------------------------- */
+
+/** Return a view of the elements of `arraylist` starting at index `start` and
+ * ending just before index `end`, without copying them. Indices are normalized
+ * as in arraylist_slice.
+ * @param arraylist: the arraylist
+ * @param start: start index
+ * @param end: end index
+ * @return: the view */
+DS_API arraylist_view_t arraylist_view(const arraylist_t *arraylist, int64_t start, int64_t end);
+
+/** Return a view of the elements of `view` starting at index `start` and
+ * ending just before index `end`. Indices are normalized as in arraylist_slice.
+ * @param view: the view
+ * @param start: start index
+ * @param end: end index
+ * @return: the sub-view */
+DS_API arraylist_view_t arraylist_view_slice(const arraylist_view_t *view, int64_t start, int64_t end);
+
+/** Return the number of elements in a view.
+ * @param view: the view */
+DS_API int64_t arraylist_view_len(const arraylist_view_t *view);
+
+/** Return a pointer to an element of a view. Return NULL if `index` is out of
+ * bounds. Negative indices are supported as in arraylist_get.
+ * @param view: the view
+ * @param index: index of the element to get
+ * @return: pointer to the requested element */
+DS_API const void *arraylist_view_get(const arraylist_view_t *view, int64_t index);
+
+/** Determine whether `view` contains `value` using the comparison function.
+ * @param view: the view
+ * @param value: value to search for */
+DS_API bool arraylist_view_contains(const arraylist_view_t *view, const void *value);
+
+/** Return the non-negative index of the first occurence of `value` in `view`
+ * using the comparison function, -1 if `value` is not in the view.
+ * @param view: the view
+ * @param value: value to search for
+ * @return: index of first occurrence of `value`, -1 if not in `view` */
+DS_API int64_t arraylist_view_find(const arraylist_view_t *view, const void *value);
+
+/** Return the non-negative index of the last occurence of `value` in `view`
+ * using the comparison function, -1 if `value` is not in the view.
+ * @param view: the view
+ * @param value: value to search for
+ * @return: index of last occurrence of `value`, -1 if not in `view` */
+DS_API int64_t arraylist_view_rfind(const arraylist_view_t *view, const void *value);
+
+/** Return the number of times `value` appears in `view`, using the comparison
+ * function.
+ * @param view: the view
+ * @param value: value to search for
+ * @return: number of times `value` appears */
+DS_API int64_t arraylist_view_count(const arraylist_view_t *view, const void *value);
+
+/** Compare two views one element at a time as in arraylist_compare.
+ * @param view1: the first view
+ * @param view2: the second view, must have elements of the same type as
+ *   `view1`
+ * @return: comparison of `view1` and `view2` */
+DS_API int64_t arraylist_view_compare(const arraylist_view_t *view1, const arraylist_view_t *view2);
+
+/** Call `func` for each value in `view` in order by passing a pointer to the
+ * value to `func`.
+ * @param view: the view
+ * @param func: function to call */
+DS_API void arraylist_view_foreach(const arraylist_view_t *view, void(*func)(const void*));
+
+/** Return a new dynamically allocated arraylist containing a copy of the
+ * elements of `view`. Return NULL if there is insufficient memory.
+ * @param view: the view
+ * @return: the arraylist created */
+DS_API arraylist_t *arraylist_view_copy(const arraylist_view_t *view);
+
+/* --------------------------- columnar arraylist --------------------------- */
+
+/** Columnar arraylist type. A columnar arraylist holds rows of fixed-size
+ * fields, storing each field in its own contiguous column, so that scanning
+ * one field only reads the memory of that field. A row is passed to and from
+ * the columnar arraylist as its fields packed one after the other in column
+ * order, without padding. */
+typedef struct {
+	int64_t len;			// number of rows
+	int64_t phys_len;		// number of rows each column can hold, >0
+	int64_t num_columns;	// number of columns
+	size_t *column_sizes;	// size, in bytes, of the field of each column
+	size_t row_size;		// size, in bytes, of a packed row, the sum of column_sizes
+	int8_t **columns;		// contents of each column
+} columnlist_t;
+
+/** Create and return a new empty columnar arraylist. Return NULL if there is
+ * insufficient memory.
+ * @param column_sizes: size, in bytes, of the field of each column
+ * @param num_columns: number of columns, >=0
+ * @return: the columnar arraylist created */
+DS_API columnlist_t *columnlist_new(const size_t *column_sizes, int64_t num_columns);
+
+/** Free a columnar arraylist.
+ * @param columnlist: the columnar arraylist to free */
+DS_API void columnlist_free(columnlist_t *columnlist);
+
+/** Return the number of rows in a columnar arraylist.
+ * @param columnlist: the columnar arraylist */
+DS_API int64_t columnlist_len(const columnlist_t *columnlist);
+
+/** Return a pointer to the contents of a column, holding the field of every
+ * row contiguously in row order. The pointer is invalidated by any function
+ * that adds or deletes rows. Return NULL if `column` is out of bounds.
+ * @param columnlist: the columnar arraylist
+ * @param column: index of the column
+ * @return: pointer to the first field of the column */
+DS_API void *columnlist_column(const columnlist_t *columnlist, int64_t column);
+
+/** Return a pointer to the field of a row in a column. Negative row indices are
+ * supported as in arraylist_get. Return NULL if `column` or `index` is out of
+ * bounds.
+ * @param columnlist: the columnar arraylist
+ * @param column: index of the column
+ * @param index: index of the row
+ * @return: pointer to the field */
+DS_API void *columnlist_get(const columnlist_t *columnlist, int64_t column, int64_t index);
+
+/** Copy a row of a columnar arraylist into `dest`, packed. Negative indices are
+ * supported. Return false if `index` is out of bounds, in which case `dest` is
+ * not modified.
+ * @param columnlist: the columnar arraylist
+ * @param index: index of the row
+ * @param dest: location to copy the row, must have room for `row_size` bytes
+ * @return: whether the row was copied */
+DS_API bool columnlist_get_row(const columnlist_t *columnlist, int64_t index, void *dest);
+
+/** Assign every field of a row of a columnar arraylist from the packed row
+ * `row`. Negative indices are supported. Return false if `index` is out of
+ * bounds.
+ * @param columnlist: the columnar arraylist
+ * @param index: index of the row
+ * @param row: the packed row to assign
+ * @return: whether the row was assigned */
+DS_API bool columnlist_set_row(columnlist_t *columnlist, int64_t index, const void *row);
+
+/** Append the packed row `row` to the end of a columnar arraylist, growing
+ * every column as arraylist_append does. Return false if there is insufficient
+ * memory.
+ * @param columnlist: the columnar arraylist
+ * @param row: the packed row to append
+ * @return: whether the row was appended */
+DS_API bool columnlist_append(columnlist_t *columnlist, const void *row);
+
+/** Delete a row of a columnar arraylist. Negative indices are supported.
+ * Return false if `index` is out of bounds.
+ * @param columnlist: the columnar arraylist
+ * @param index: index of the row
+ * @return: whether deletion was successful */
+DS_API bool columnlist_delete(columnlist_t *columnlist, int64_t index);
+
+/** Remove all rows from a columnar arraylist.
+ * @param columnlist: the columnar arraylist */
+DS_API void columnlist_clear(columnlist_t *columnlist);
+
+/* --------------------------- segmented vector --------------------------- */
+
+/* Maximum number of segments of a segmented vector */
+#define SEGVEC_MAX_SEGMENTS 48
+
+/** Segmented vector type. Elements are stored in segments whose lengths double
+ * from one to the next; segments are never moved or freed until the segmented
+ * vector is, so pointers to elements stay valid for its whole lifetime. An
+ * element is found in constant time from the position of the highest set bit
+ * of its index. Any number of threads may append at the same time: each
+ * append claims a slot with an atomic fetch-and-add and the segment holding
+ * it is installed with a compare-and-swap, without locks. Each segment is
+ * followed by a bitmap of the slots whose element has been written, so that
+ * slots claimed by failed or unfinished appends read as missing. */
+typedef struct {
+	size_t elem_size;							// size of each element, in bytes
+	int64_t first_segment_bits;					// base 2 logarithm of the length of the first segment
+	volatile int64_t len;						// number of slots claimed by appends, including failed ones
+	void *volatile segments[SEGVEC_MAX_SEGMENTS];	// contents and written bitmap of each segment, NULL until needed
+} segvec_t;
+
+/** Create and return a new, empty segmented vector. Return NULL if there is
+ * insufficient memory.
+ * @param elem_size: size, in bytes, of each element
+ * @param first_segment_len: number of elements of the first segment, rounded
+ *   up to a power of 2, >0
+ * @return: the segmented vector created */
+DS_API segvec_t *segvec_new(size_t elem_size, int64_t first_segment_len);
+
+/** Free a segmented vector and all of its segments. No thread may be appending.
+ * @param segvec: the segmented vector to free */
+DS_API void segvec_free(segvec_t *segvec);
+
+/** Return the number of slots claimed in a segmented vector. This counts
+ * elements whose append is still in progress in another thread and slots
+ * whose append failed, including appends past the last segment, so some
+ * indices below it may have no element.
+ * @param segvec: the segmented vector
+ * @return: number of elements */
+DS_API int64_t segvec_len(const segvec_t *segvec);
+
+/** Append a copy of `value` to a segmented vector and return a pointer to the
+ * new element, valid until the segmented vector is freed. Safe to call from
+ * several threads at once. Return NULL if there is insufficient memory or the
+ * last segment is full, in which case the claimed index is left without an
+ * element and still counts toward segvec_len.
+ * @param segvec: the segmented vector
+ * @param value: the value to append
+ * @return: pointer to the new element */
+DS_API void *segvec_append(segvec_t *segvec, const void *value);
+
+/** Return a pointer to the element at index `index` of a segmented vector.
+ * Negative indices are supported, relative to segvec_len. Return NULL if
+ * `index` is out of bounds or its element has not been written, because its
+ * append failed or is still in progress in another thread.
+ * @param segvec: the segmented vector
+ * @param index: index of the element
+ * @return: pointer to the element */
+DS_API void *segvec_get(const segvec_t *segvec, int64_t index);
+
+/* ----------------------- variable-length arraylist ----------------------- */
+
+/** Comparison function type for elements of a variable-length arraylist, with
+ * the same return convention as cmp_func_t. */
+typedef int64_t (*varlist_cmp_func_t)(const void *a, size_t len_a, const void *b, size_t len_b);
+
+/** Location of an element of a variable-length arraylist in its arena */
+typedef struct {
+	int64_t offset;		// offset of the first byte of the element in the arena
+	int64_t len;		// length of the element, in bytes
+} varlist_entry_t;
+
+/** Variable-length arraylist type. Elements are byte strings of any length,
+ * such as strings or blobs, stored one after the other in a single arena, with
+ * a table giving the location of each element in index order. Deleting an
+ * element leaves its bytes in the arena as garbage until there is enough of
+ * it to be worth compacting. */
+typedef struct {
+	int64_t len;					// number of elements
+	int64_t phys_len;				// number of entries the table can hold, >0
+	varlist_entry_t *entries;		// location of each element in the arena
+	int8_t *arena;					// bytes of the elements
+	int64_t arena_len;				// number of bytes used in the arena, including garbage
+	int64_t arena_phys_len;			// number of bytes the arena can hold, >0
+	int64_t garbage;				// number of bytes in the arena of deleted elements
+	varlist_cmp_func_t cmp_func;	// comparison function, NULL to compare bytes
+} varlist_t;
+
+/** Create and return a new, empty variable-length arraylist. Return NULL if
+ * there is insufficient memory.
+ * @param cmp_func: comparison function, or NULL to order elements by comparing
+ *   their bytes, a shorter element coming before any longer one it is a prefix
+ *   of
+ * @return: the variable-length arraylist created */
+DS_API varlist_t *varlist_new(varlist_cmp_func_t cmp_func);
+
+/** Free a variable-length arraylist.
+ * @param varlist: the variable-length arraylist to free */
+DS_API void varlist_free(varlist_t *varlist);
+
+/** Return the number of elements of a variable-length arraylist.
+ * @param varlist: the variable-length arraylist
+ * @return: number of elements */
+DS_API int64_t varlist_len(const varlist_t *varlist);
+
+/** Append a copy of the `len` bytes at `value`, which must not point into the
+ * arena of `varlist`. Return false if there is insufficient memory.
+ * @param varlist: the variable-length arraylist
+ * @param value: the bytes of the element
+ * @param len: length of the element, in bytes
+ * @return: whether the element was appended */
+DS_API bool varlist_append(varlist_t *varlist, const void *value, size_t len);
+
+/** Return a pointer to the bytes of the element at index `index` and store its
+ * length in `len`. Negative indices are supported. The pointer is invalidated
+ * by any function that adds or deletes elements. Return NULL if `index` is out
+ * of bounds.
+ * @param varlist: the variable-length arraylist
+ * @param index: index of the element
+ * @param len: location to store the length of the element, or NULL
+ * @return: pointer to the element */
+DS_API const void *varlist_get(const varlist_t *varlist, int64_t index, size_t *len);
+
+/** Delete the element at index `index`. Negative indices are supported. Its
+ * bytes are reclaimed by a compaction once the garbage in the arena is more
+ * than half of it. Return false if `index` is out of bounds.
+ * @param varlist: the variable-length arraylist
+ * @param index: index of the element
+ * @return: whether the element was deleted */
+DS_API bool varlist_delete(varlist_t *varlist, int64_t index);
+
+/** Delete every element.
+ * @param varlist: the variable-length arraylist */
+DS_API void varlist_clear(varlist_t *varlist);
+
+/** Rewrite the arena with the elements in index order and without garbage, so
+ * that scanning the elements in order reads the arena sequentially. Return
+ * false, leaving the arena unchanged, if there is insufficient memory.
+ * @param varlist: the variable-length arraylist
+ * @return: whether the arena was compacted */
+DS_API bool varlist_compact(varlist_t *varlist);
+
+/** Sort a variable-length arraylist using its comparison function. Only the
+ * table entries are moved, not the bytes of the elements; call varlist_compact
+ * afterwards to make the arena sequential again. The sort is stable. Return
+ * false if there is insufficient memory.
+ * @param varlist: the variable-length arraylist
+ * @return: whether the arraylist was sorted */
+DS_API bool varlist_sort(varlist_t *varlist);
+
+/** Append every element of the `size` bytes at `buffer`, where elements are
+ * separated by `delimiter`, such as the lines of a text. A last element not
+ * followed by the delimiter is appended unless it is empty. Return false,
+ * leaving `varlist` unchanged, if there is insufficient memory.
+ * @param varlist: the variable-length arraylist
+ * @param buffer: the elements and delimiters
+ * @param size: size of the buffer, in bytes
+ * @param delimiter: byte that ends each element
+ * @return: whether the elements were appended */
+DS_API bool varlist_import_delimited(varlist_t *varlist, const void *buffer, size_t size, char delimiter);
+
+/** Append every element of the `size` bytes at `buffer`, where each element is
+ * preceded by its length as a uint32_t in native byte order. Return false,
+ * leaving `varlist` unchanged, if the buffer ends in the middle of an element
+ * or there is insufficient memory.
+ * @param varlist: the variable-length arraylist
+ * @param buffer: the lengths and elements
+ * @param size: size of the buffer, in bytes
+ * @return: whether the elements were appended */
+DS_API bool varlist_import_length_prefixed(varlist_t *varlist, const void *buffer, size_t size);
+
+/* ----------------------------- search index ----------------------------- */
+
+/** Static search index type. A read-only copy of a sorted arraylist laid out in
+ * Eytzinger order, the breadth-first order of a complete binary search tree,
+ * so that the first levels of every search share the same few cache lines and
+ * the nodes a search visits several levels ahead can be prefetched. */
+typedef struct {
+	int64_t len;			// number of elements
+	size_t elem_size;		// size of each element, in bytes
+	cmp_func_t cmp_func;	// comparison function
+	int8_t *elements;		// elements in Eytzinger order from slot 1, cache line aligned
+	int64_t *indices;		// index in the arraylist of the element in each slot
+} searchindex_t;
+
+/** Create and return a search index holding a copy of the elements of
+ * `arraylist`, which must be sorted. The index does not reflect later changes
+ * to the arraylist. Return NULL if there is insufficient memory.
+ * @param arraylist: the sorted arraylist
+ * @return: the search index created */
+DS_API searchindex_t *arraylist_build_search_index(const arraylist_t *arraylist);
+
+/** Free a search index.
+ * @param index: the search index to free */
+DS_API void searchindex_free(searchindex_t *index);
+
+/** Return the number of elements of a search index.
+ * @param index: the search index
+ * @return: number of elements */
+DS_API int64_t searchindex_len(const searchindex_t *index);
+
+/** Return the index in the original arraylist of the first element that is not
+ * less than `value`, or the number of elements if every element is less, in
+ * O(log n) time with few cache misses.
+ * @param index: the search index
+ * @param value: the value to search for
+ * @return: index of the first element not less than `value` */
+DS_API int64_t searchindex_lower_bound(const searchindex_t *index, const void *value);
+
+/* ------------------------ compressed integer list ------------------------ */
+
+/* Number of values in each compressed block of a compressed integer list */
+#define INTLIST_BLOCK_LEN 128
+
+/** Compressed block of a compressed integer list */
+typedef struct {
+	int64_t first;		// first value of the block
+	int64_t min_delta;	// least difference between consecutive values of the block
+	int64_t offset;		// index in `words` of the first word of the packed deltas
+	int64_t width;		// number of bits of each packed delta, from 0 to 64
+} intlist_block_t;
+
+/** Compressed integer list type. Values are int64_t, grouped in blocks of
+ * INTLIST_BLOCK_LEN. Each full block stores its first value, and the differences
+ * between consecutive values minus their minimum, bit-packed with just enough
+ * bits for the largest. Sorted ids and timestamps, whose differences are
+ * small, then take a few bits per value. The last block is kept uncompressed
+ * until it fills. Random access and lower bound searches go straight to a
+ * block through the block table and decode only that block. */
+typedef struct {
+	int64_t len;					// number of values
+	intlist_block_t *blocks;		// full blocks
+	int64_t num_blocks;				// number of full blocks
+	int64_t phys_blocks;			// number of blocks `blocks` can hold
+	uint64_t *words;				// packed deltas of every full block
+	int64_t num_words;				// number of words used in `words`
+	int64_t phys_words;				// number of words `words` can hold
+	int64_t tail[INTLIST_BLOCK_LEN];	// values after the last full block
+} intlist_t;
+
+/** Compressed integer list iterator type */
+typedef struct {
+	const intlist_t *intlist;				// compressed integer list over which we are iterating
+	int64_t index;							// index of the next value
+	int64_t values[INTLIST_BLOCK_LEN];		// decoded values of the block of the next value
+} intlist_iter_t;
+
+/** Create and return a new, empty compressed integer list. Return NULL if there
+ * is insufficient memory.
+ * @return: the compressed integer list created */
+DS_API intlist_t *intlist_new(void);
+
+/** Free a compressed integer list.
+ * @param intlist: the compressed integer list to free */
+DS_API void intlist_free(intlist_t *intlist);
+
+/** Return the number of values in a compressed integer list.
+ * @param intlist: the compressed integer list
+ * @return: number of values */
+DS_API int64_t intlist_len(const intlist_t *intlist);
+
+/** Return the number of bytes of memory used by a compressed integer list.
+ * @param intlist: the compressed integer list
+ * @return: size in bytes */
+DS_API int64_t intlist_size(const intlist_t *intlist);
+
+/** Append `value` to a compressed integer list, compressing the last block once
+ * it fills. Return false if there is insufficient memory.
+ * @param intlist: the compressed integer list
+ * @param value: the value to append
+ * @return: whether the value was appended */
+DS_API bool intlist_append(intlist_t *intlist, int64_t value);
+
+/** Store the value at index `index` of a compressed integer list in `dest`,
+ * decoding at most one block. Negative indices are supported. Return false if
+ * `index` is out of bounds.
+ * @param intlist: the compressed integer list
+ * @param index: index of the value
+ * @param dest: location to store the value
+ * @return: whether `index` was in bounds */
+DS_API bool intlist_get(const intlist_t *intlist, int64_t index, int64_t *dest);
+
+/** Return the index of the first value not less than `value` in a compressed
+ * integer list sorted in ascending order, or its length if every value is
+ * less, by binary search over the first value of each block and then within a
+ * single decoded block.
+ * @param intlist: the sorted compressed integer list
+ * @param value: the value to search for
+ * @return: index of the first value not less than `value` */
+DS_API int64_t intlist_lower_bound(const intlist_t *intlist, int64_t value);
+
+/** Create and return a compressed integer list holding the values of an
+ * arraylist of int64_t. Return NULL if the elements of `arraylist` are not the
+ * size of an int64_t or there is insufficient memory.
+ * @param arraylist: arraylist of int64_t
+ * @return: the compressed integer list created */
+DS_API intlist_t *intlist_from_arraylist(const arraylist_t *arraylist);
 
-#define NODE_VALUE_MAX_SIZE (4 * sizeof(void *))
+/** Replace the contents of `dest` with the values of a compressed integer list.
+ * Return false if the elements of `dest` are not the size of an int64_t or
+ * there is insufficient memory.
+ * @param intlist: the compressed integer list
+ * @param dest: arraylist of int64_t that receives the values
+ * @return: whether the values were copied */
+DS_API bool intlist_to_arraylist(const intlist_t *intlist, arraylist_t *dest);
+
+/** Create and return a new compressed integer list iterator, decoding one block
+ * at a time. Return NULL if there is insufficient memory.
+ * @param intlist: the compressed integer list over which to iterate
+ * @return: a compressed integer list iterator */
+DS_API intlist_iter_t *intlist_iter_new(const intlist_t *intlist);
+
+/** Free a compressed integer list iterator.
+ * @param iter: the compressed integer list iterator */
+DS_API void intlist_iter_free(intlist_iter_t *iter);
+
+/** Return a pointer to the next value of a compressed integer list iterator,
+ * valid until the next call, or NULL if there are no more values. The list
+ * must not be modified during iteration.
+ * @param iter: the compressed integer list iterator
+ * @return: pointer to the next value */
+DS_API const int64_t *intlist_iter_next(intlist_iter_t *iter);
+
+/** Reset a compressed integer list iterator back to the beginning.
+ * @param iter: the compressed integer list iterator */
+DS_API void intlist_iter_reset(intlist_iter_t *iter);
+
+/* -------------------------------- bitset -------------------------------- */
+
+/** Dynamic bitset type. Bits are packed 64 to a word, and the storage grows
+ * geometrically like the contents of an arraylist. An optional rank directory
+ * built by bitset_build_rank samples the number of set bits before every
+ * 512-bit block, so that bitset_rank and bitset_select do not scan the whole
+ * bitset. Modifying a bit invalidates the entries after its block. */
+typedef struct {
+	int64_t len;			// number of bits
+	int64_t phys_words;		// number of words the storage can hold, >0
+	uint64_t *words;		// bits, least significant bit first; bits past `len` are 0
+	int64_t *rank_dir;		// number of set bits before each block, NULL until built
+	int64_t rank_blocks;	// number of leading entries of `rank_dir` that are up to date
+} bitset_t;
+
+/** Create and return a new bitset of `len` clear bits. Return NULL if there
+ * is insufficient memory.
+ * @param len: number of bits, >=0
+ * @return: the bitset created */
+DS_API bitset_t *bitset_new(int64_t len);
+
+/** Free a bitset.
+ * @param bitset: the bitset to free */
+DS_API void bitset_free(bitset_t *bitset);
+
+/** Return the number of bits in a bitset.
+ * @param bitset: the bitset */
+DS_API int64_t bitset_len(const bitset_t *bitset);
+
+/** Change the number of bits in a bitset to `len`. Bits added are clear.
+ * Return false if there is insufficient memory, in which case the bitset is
+ * unchanged.
+ * @param bitset: the bitset
+ * @param len: new number of bits, >=0
+ * @return: whether the bitset was resized */
+DS_API bool bitset_resize(bitset_t *bitset, int64_t len);
+
+/** Append a bit to the end of a bitset. Return false if there is insufficient
+ * memory.
+ * @param bitset: the bitset
+ * @param value: value of the bit to append
+ * @return: whether the bit was appended */
+DS_API bool bitset_append(bitset_t *bitset, bool value);
+
+/** Set the bit at `index` of a bitset. Return false if `index` is out of
+ * bounds.
+ * @param bitset: the bitset
+ * @param index: index of the bit
+ * @return: whether `index` was in bounds */
+DS_API bool bitset_set(bitset_t *bitset, int64_t index);
+
+/** Clear the bit at `index` of a bitset. Return false if `index` is out of
+ * bounds.
+ * @param bitset: the bitset
+ * @param index: index of the bit
+ * @return: whether `index` was in bounds */
+DS_API bool bitset_clear(bitset_t *bitset, int64_t index);
+
+/** Return whether the bit at `index` of a bitset is set. Return false if
+ * `index` is out of bounds.
+ * @param bitset: the bitset
+ * @param index: index of the bit */
+DS_API bool bitset_test(const bitset_t *bitset, int64_t index);
+
+/** Set or clear every bit of a bitset.
+ * @param bitset: the bitset
+ * @param value: value of the bits */
+DS_API void bitset_fill(bitset_t *bitset, bool value);
+
+/** Return the number of set bits of a bitset starting at index `start` and
+ * ending just before index `end`. Indices are normalized as in arraylist_slice.
+ * @param bitset: the bitset
+ * @param start: start index
+ * @param end: end index
+ * @return: number of set bits in the range */
+DS_API int64_t bitset_count(const bitset_t *bitset, int64_t start, int64_t end);
+
+/** Build the rank directory of a bitset, making bitset_rank O(1) and
+ * bitset_select O(log n) until bits are modified. The directory takes one
+ * int64_t per 512 bits. Modifying a bit only invalidates the entries after its
+ * block, so rank and select stay fast before it; call again after bulk
+ * updates. Writing to `words` directly requires calling this again before
+ * using rank or select. Return false if there is insufficient memory, in which
+ * case rank and select scan the bitset linearly.
+ * @param bitset: the bitset
+ * @return: whether the directory was built */
+DS_API bool bitset_build_rank(bitset_t *bitset);
+
+/** Return the number of set bits of a bitset before index `index`. Takes O(1)
+ * time with an up-to-date rank directory, otherwise time linear in the number
+ * of bits after the last valid entry.
+ * @param bitset: the bitset
+ * @param index: index of the bit
+ * @return: number of set bits before `index` */
+DS_API int64_t bitset_rank(const bitset_t *bitset, int64_t index);
+
+/** Return the index of the set bit of a bitset preceded by `rank` set bits,
+ * -1 if there are not that many set bits. Binary searches the rank directory,
+ * then scans linearly past its last valid entry.
+ * @param bitset: the bitset
+ * @param rank: number of set bits before the bit sought, >=0
+ * @return: index of the bit */
+DS_API int64_t bitset_select(const bitset_t *bitset, int64_t rank);
+
+/** Return the index of the first set bit of a bitset at or after `index`, -1
+ * if there is none.
+ * @param bitset: the bitset
+ * @param index: index to start searching from
+ * @return: index of the next set bit */
+DS_API int64_t bitset_next_set(const bitset_t *bitset, int64_t index);
+
+/** Return the index of the first clear bit of a bitset at or after `index`,
+ * -1 if there is none.
+ * @param bitset: the bitset
+ * @param index: index to start searching from
+ * @return: index of the next clear bit */
+DS_API int64_t bitset_next_clear(const bitset_t *bitset, int64_t index);
+
+/** Replace `dest` with the bitwise AND of `dest` and `src`. `dest` keeps its
+ * length; bits of `src` past its length are taken as clear.
+ * @param dest: the bitset to modify
+ * @param src: the other operand */
+DS_API void bitset_and(bitset_t *dest, const bitset_t *src);
+
+/** Replace `dest` with the bitwise OR of `dest` and `src`, as in bitset_and.
+ * @param dest: the bitset to modify
+ * @param src: the other operand */
+DS_API void bitset_or(bitset_t *dest, const bitset_t *src);
+
+/** Replace `dest` with the bitwise XOR of `dest` and `src`, as in bitset_and.
+ * @param dest: the bitset to modify
+ * @param src: the other operand */
+DS_API void bitset_xor(bitset_t *dest, const bitset_t *src);
+
+/** Clear the bits of `dest` that are set in `src`, as in bitset_and.
+ * @param dest: the bitset to modify
+ * @param src: the bits to clear */
+DS_API void bitset_andnot(bitset_t *dest, const bitset_t *src);
+
+/* --------------------------- persistent vector --------------------------- */
+
+/** Node of a persistent vector tree */
+typedef struct pvector_node_t pvector_node_t;
+
+/** Persistent vector type. A persistent vector is an immutable sequence stored
+ * as a 32-way radix-balanced tree plus a tail buffer of up to 32 elements.
+ * Updating a version returns a new version in O(log32 n) time that shares all
+ * unchanged nodes with the old one, so taking a snapshot is O(1). Nodes are
+ * reference counted, so versions may be read and freed from different threads.
+ * A transient is a version that can be modified in place for fast bulk
+ * updates, copying shared nodes only once. */
+typedef struct {
+	int64_t len;			// number of elements
+	size_t elem_size;		// size of each element, in bytes
+	int shift;				// number of index bits resolved below the root, a multiple of 5
+	int64_t owner;			// id of this transient, 0 for a persistent version
+	pvector_node_t *root;	// root branch of the tree holding all elements before the tail
+	pvector_node_t *tail;	// leaf holding the last elements
+	cmp_func_t cmp_func;	// comparison function
+} pvector_t;
+
+/** Create and return a new, empty persistent vector. Return NULL if there is
+ * insufficient memory.
+ * @param elem_size: size, in bytes, of each element
+ * @param cmp_func: comparison function
+ * @return: the persistent vector created */
+DS_API pvector_t *pvector_new(size_t elem_size, cmp_func_t cmp_func);
+
+/** Free a version of a persistent vector. Nodes shared with other versions
+ * are freed when the last version using them is freed.
+ * @param pvector: the version to free */
+DS_API void pvector_free(pvector_t *pvector);
+
+/** Return the number of elements in a version of a persistent vector.
+ * @param pvector: the version */
+DS_API int64_t pvector_len(const pvector_t *pvector);
+
+/** Return a pointer to an element of a version of a persistent vector, which
+ * must not be modified. Return NULL if `index` is out of bounds. Negative
+ * indices are supported as in arraylist_get.
+ * @param pvector: the version
+ * @param index: index of the element to get
+ * @return: pointer to the requested element */
+DS_API const void *pvector_get(const pvector_t *pvector, int64_t index);
+
+/** Return a new version of `pvector` with the element at `index` set to a copy
+ * of `value`. `pvector` is unchanged. Return NULL if `index` is out of bounds
+ * or there is insufficient memory. Must not be called on a transient.
+ * @param pvector: the version
+ * @param index: index of the element to set
+ * @param value: the value to assign
+ * @return: the new version */
+DS_API pvector_t *pvector_set(const pvector_t *pvector, int64_t index, const void *value);
+
+/** Return a new version of `pvector` with a copy of `value` appended to the
+ * end. `pvector` is unchanged. Return NULL if there is insufficient memory.
+ * Must not be called on a transient.
+ * @param pvector: the version
+ * @param value: the value to append
+ * @return: the new version */
+DS_API pvector_t *pvector_append(const pvector_t *pvector, const void *value);
+
+/** Return a transient with the same contents as `pvector` in O(1) time. The
+ * transient can be modified in place by pvector_transient_set and
+ * pvector_transient_append without affecting `pvector`, then turned into a
+ * persistent version by pvector_persistent. A transient must only be used by
+ * one thread at a time. Return NULL if there is insufficient memory.
+ * @param pvector: the version
+ * @return: the transient */
+DS_API pvector_t *pvector_transient(const pvector_t *pvector);
+
+/** Set the element at `index` of a transient to a copy of `value` in place.
+ * Return false if `index` is out of bounds or there is insufficient memory.
+ * @param transient: the transient
+ * @param index: index of the element to set
+ * @param value: the value to assign
+ * @return: whether the element was set */
+DS_API bool pvector_transient_set(pvector_t *transient, int64_t index, const void *value);
+
+/** Append a copy of `value` to the end of a transient in place. Return false
+ * if there is insufficient memory.
+ * @param transient: the transient
+ * @param value: the value to append
+ * @return: whether the value was appended */
+DS_API bool pvector_transient_append(pvector_t *transient, const void *value);
+
+/** Turn a transient into a persistent version in O(1) time. It must not be
+ * passed to pvector_transient_set or pvector_transient_append afterwards.
+ * @param transient: the transient */
+DS_API void pvector_persistent(pvector_t *transient);
+
+/** Create and return a persistent vector with the contents of `arraylist`,
+ * built through a transient. Return NULL if there is insufficient memory.
+ * @param arraylist: the arraylist
+ * @return: the persistent vector created */
+DS_API pvector_t *pvector_from_arraylist(const arraylist_t *arraylist);
+
+/** Create and return a new arraylist with the contents of a version of a
+ * persistent vector. Return NULL if there is insufficient memory.
+ * @param pvector: the version
+ * @return: the arraylist created */
+DS_API arraylist_t *pvector_to_arraylist(const pvector_t *pvector);
+
+/* ------------------------- concurrent skip list ------------------------- */
+
+/** Node of a concurrent skip list */
+typedef struct skiplist_node_t skiplist_node_t;
+
+/** Concurrent skip list type. A skip list is an ordered set of elements that
+ * can be searched and modified by many threads at once without locks. Links
+ * of a node being deleted are marked before the node is unlinked, and unlinked
+ * nodes are freed through epoch-based reclamation once no thread can still be
+ * reading them. */
+typedef struct {
+	skiplist_node_t *head;		// sentinel node before the first element
+	size_t elem_size;			// size of each element, in bytes
+	cmp_func_t cmp_func;		// comparison function ordering the elements
+	volatile int64_t len;		// number of elements
+} skiplist_t;
+
+/** Iterator over a concurrent skip list. It yields the elements in ascending
+ * order, including or not those inserted or erased while iterating. Nodes it
+ * can reach are kept alive until it is freed, so an iterator must be freed by
+ * the thread that created it and should not be held for long. */
+typedef struct {
+	const skiplist_t *skiplist;	// skip list being iterated over
+	skiplist_node_t *next;		// node holding the next element, NULL if there is none
+	void *record;				// epoch record of the thread that created the iterator
+} skiplist_iter_t;
+
+/** Create and return a new, empty concurrent skip list. Return NULL if there is
+ * insufficient memory.
+ * @param elem_size: size, in bytes, of each element
+ * @param cmp_func: comparison function ordering the elements
+ * @return: the skip list created */
+DS_API skiplist_t *skiplist_new(size_t elem_size, cmp_func_t cmp_func);
+
+/** Free a concurrent skip list. No other thread may be using it.
+ * @param skiplist: the skip list to free */
+DS_API void skiplist_free(skiplist_t *skiplist);
+
+/** Return the number of elements in a concurrent skip list. While other threads
+ * modify it, the result may already be outdated.
+ * @param skiplist: the skip list */
+DS_API int64_t skiplist_len(const skiplist_t *skiplist);
+
+/** Insert a copy of `value` into a concurrent skip list. Return false if an
+ * equal element is already present or there is insufficient memory.
+ * @param skiplist: the skip list
+ * @param value: the value to insert
+ * @return: whether the value was inserted */
+DS_API bool skiplist_insert(skiplist_t *skiplist, const void *value);
+
+/** Erase the element equal to `value` from a concurrent skip list. Return
+ * false if there is none or there is insufficient memory.
+ * @param skiplist: the skip list
+ * @param value: the value to erase
+ * @return: whether an element was erased */
+DS_API bool skiplist_erase(skiplist_t *skiplist, const void *value);
+
+/** Return whether a concurrent skip list contains an element equal to `value`.
+ * Return false if there is insufficient memory.
+ * @param skiplist: the skip list
+ * @param value: the value to search for */
+DS_API bool skiplist_contains(const skiplist_t *skiplist, const void *value);
+
+/** Create and return an iterator over a concurrent skip list starting at its
+ * first element. Return NULL if there is insufficient memory.
+ * @param skiplist: the skip list
+ * @return: the iterator created */
+DS_API skiplist_iter_t *skiplist_iter_new(const skiplist_t *skiplist);
+
+/** Create and return an iterator over a concurrent skip list starting at the
+ * first element greater than or equal to `value`. Return NULL if there is
+ * insufficient memory.
+ * @param skiplist: the skip list
+ * @param value: the value to search for
+ * @return: the iterator created */
+DS_API skiplist_iter_t *skiplist_lower_bound(const skiplist_t *skiplist, const void *value);
+
+/** Free an iterator over a concurrent skip list. Must be called by the thread
+ * that created it.
+ * @param iter: the iterator to free */
+DS_API void skiplist_iter_free(skiplist_iter_t *iter);
+
+/** Return a pointer to the next element of an iterator over a concurrent skip
+ * list, which must not be modified and remains valid until the iterator is
+ * freed. Return NULL if there are no more elements.
+ * @param iter: the iterator
+ * @return: pointer to the next element */
+DS_API const void *skiplist_iter_next(skiplist_iter_t *iter);
+
+/* ------------------------------ thread pool ------------------------------ */
+
+/** Work-stealing thread pool type. Each worker owns a Chase-Lev deque; tasks
+ * spawned by a worker are pushed on its own deque and idle workers steal from
+ * the others. Tasks spawned by other threads go through a shared queue. */
+typedef struct threadpool_t threadpool_t;
+
+/** Thread pool task type. The caller owns the memory of a task, which must stay
+ * valid from threadpool_spawn until threadpool_join returns. */
+typedef struct threadpool_task_t {
+	void (*func)(void*);			// function run by the task
+	void *arg;						// argument passed to `func`
+	volatile int64_t done;			// nonzero once `func` has returned
+	struct threadpool_task_t *next;	// next task in the pool's submission queue
+} threadpool_task_t;
+
+/** Thread pool statistics type */
+typedef struct {
+	int64_t spawned;		// number of tasks spawned
+	int64_t executed;		// number of tasks run to completion
+	int64_t steals;			// number of tasks stolen from another worker's deque
+	int64_t failed_steals;	// number of times a worker found every other deque empty
+} threadpool_stats_t;
+
+/** Create and return a new thread pool. Return NULL if there is insufficient
+ * memory or the worker threads cannot be started.
+ * @param num_workers: number of worker threads, or <=0 for one per processor
+ * @param pin_workers: whether to bind worker i to processor i
+ * @return: the thread pool created */
+DS_API threadpool_t *threadpool_new(int64_t num_workers, bool pin_workers);
+
+/** Stop the worker threads of a thread pool and free its memory. All spawned
+ * tasks must have been joined. Must not be called on the default pool.
+ * @param pool: the thread pool */
+DS_API void threadpool_free(threadpool_t *pool);
+
+/** Return the number of worker threads of a thread pool.
+ * @param pool: the thread pool */
+DS_API int64_t threadpool_num_workers(const threadpool_t *pool);
+
+/** Return the global default thread pool, which has one worker per processor
+ * and is created on first use. This is the pool used by the library's parallel
+ * operations. Return NULL if it cannot be created.
+ * @return: the default thread pool */
+DS_API threadpool_t *threadpool_default(void);
+
+/** Spawn `task` on `pool` to run `func(arg)` asynchronously. Spawning from a
+ * worker of `pool` pushes the task on that worker's own deque without locking.
+ * The task must later be passed to threadpool_join.
+ * @param pool: the thread pool
+ * @param task: the task, overwritten by this function
+ * @param func: function to run
+ * @param arg: argument passed to `func` */
+DS_API void threadpool_spawn(threadpool_t *pool, threadpool_task_t *task, void(*func)(void*), void *arg);
+
+/** Wait until `task` has finished. When called from a worker of `pool`, the
+ * worker runs other tasks of `pool` while waiting, so tasks may spawn and join
+ * subtasks (fork/join) without deadlocking. Other threads simply wait.
+ * @param pool: the thread pool on which `task` was spawned
+ * @param task: the task */
+DS_API void threadpool_join(threadpool_t *pool, threadpool_task_t *task);
+
+/** Copy the statistics of a thread pool into `stats`. Counters are read
+ * without stopping the workers, so they are only approximate while tasks run.
+ * @param pool: the thread pool
+ * @param stats: location to copy the statistics */
+DS_API void threadpool_get_stats(const threadpool_t *pool, threadpool_stats_t *stats);
+
+/* ---------------------- parallel arraylist operations ---------------------- */
+
+/** Call `func` for each value in `arraylist` by passing a pointer to the value
+ * to `func`. The arraylist is split into cache-aligned chunks which are
+ * processed concurrently by several threads, so calls happen in no particular
+ * order and `func` must be safe to call from several threads at once.
+ * @param arraylist: the arraylist
+ * @param func: function to call */
+DS_API void arraylist_parallel_foreach(arraylist_t *arraylist, void(*func)(void*));
+
+/** Set `dest` to have the same length as `source` and, concurrently for each
+ * index i, call `func(dest[i], source[i], ctx)` to compute element i of `dest`
+ * from element i of `source`. `dest` may have a different element size from
+ * `source`; its previous contents are discarded. Return false if there is
+ * insufficient memory, in which case `dest` is unchanged.
+ * @param source: the arraylist that gives values
+ * @param dest: the arraylist that receives values, must not be `source`
+ * @param func: function that writes its first argument from its second
+ * @param ctx: context passed to `func`
+ * @return: whether the map was successful */
+DS_API bool arraylist_parallel_map(const arraylist_t *source, arraylist_t *dest, void(*func)(void*, const void*, void*), void *ctx);
+
+/** Reduce `arraylist` to a single element using `combine`, which must be
+ * associative and for which `identity` must be an identity value. Calling
+ * `combine(accumulator, value, ctx)` must fold `value` into `accumulator`.
+ * Each chunk of the arraylist is reduced concurrently starting from `identity`
+ * and the partial results are then combined from left to right. Chunk
+ * boundaries depend only on the element size, so the result is reproducible
+ * regardless of the number of threads, even if `combine` is only approximately
+ * associative as with floating-point addition. The result is copied into
+ * `dest`. Return false if there is insufficient memory, in which case `dest`
+ * is not modified.
+ * @param arraylist: the arraylist
+ * @param identity: identity value of `combine`, one element in size
+ * @param combine: associative function that folds its second argument into its
+ *   first
+ * @param ctx: context passed to `combine`
+ * @param dest: location to copy the result, must be large enough to hold an
+ *   element
+ * @return: whether the reduction was successful */
+DS_API bool arraylist_parallel_reduce(const arraylist_t *arraylist, const void *identity, void(*combine)(void*, const void*, void*), void *ctx, void *dest);
+
+/* ------------------------- external merge sort ------------------------- */
+
+/** Run of sorted elements spilled to a temporary file */
+typedef struct extsort_run_t extsort_run_t;
+
+/** External merge sort type. Elements are added one at a time and collected
+ * into an in-memory run; whenever the run fills the memory budget it is
+ * sorted and written to a temporary file. Once all elements are added, the
+ * runs are merged back with a loser tree, in several passes if there are too
+ * many of them to merge at once within the budget. The sort is stable. */
+typedef struct {
+	size_t elem_size;			// size of each element, in bytes
+	cmp_func_t cmp_func;		// comparison function
+	size_t memory_budget;		// maximum size, in bytes, of the buffers
+	int64_t len;				// number of elements added
+	arraylist_t *run;			// elements added since the last spill
+	extsort_run_t **runs;		// runs spilled to temporary files
+	int64_t num_runs;			// number of runs in `runs`
+	int64_t *tree;				// loser tree over `runs` once merging
+	int64_t next;				// index in `run` of the next element, when it was never spilled
+	int8_t *current;			// copy of the element last returned by extsort_next
+	bool finished;				// whether extsort_finish was called
+	bool failed;				// whether an I/O or memory error occurred
+} extsort_t;
+
+/** Create and return a new external merge sort. Return NULL if there is
+ * insufficient memory.
+ * @param elem_size: size, in bytes, of each element
+ * @param cmp_func: comparison function
+ * @param memory_budget: size, in bytes, of memory used for runs and file
+ *   buffers, at least 1 element
+ * @return: the external merge sort created */
+DS_API extsort_t *extsort_new(size_t elem_size, cmp_func_t cmp_func, size_t memory_budget);
+
+/** Free an external merge sort and delete its temporary files.
+ * @param extsort: the external merge sort to free */
+DS_API void extsort_free(extsort_t *extsort);
+
+/** Add a copy of `value` to an external merge sort, spilling the current run
+ * to a temporary file if it fills the memory budget. Must not be called after
+ * extsort_finish. Return false if an I/O error occurred or there is
+ * insufficient memory.
+ * @param extsort: the external merge sort
+ * @param value: the value to add
+ * @return: whether the value was added */
+DS_API bool extsort_add(extsort_t *extsort, const void *value);
+
+/** Finish adding elements to an external merge sort and prepare to read them
+ * back in sorted order. Return false if an I/O error occurred or there is
+ * insufficient memory.
+ * @param extsort: the external merge sort
+ * @return: whether the elements can be read back */
+DS_API bool extsort_finish(extsort_t *extsort);
+
+/** Return a pointer to the next element of a finished external merge sort in
+ * sorted order, valid until the next call. Return NULL once every element has
+ * been returned or if an I/O error occurred, which can be told apart by
+ * checking `failed`.
+ * @param extsort: the external merge sort
+ * @return: pointer to the next element */
+DS_API const void *extsort_next(extsort_t *extsort);
+
+/** Write the remaining elements of a finished external merge sort in sorted
+ * order to the file at `path`, which is created or truncated. Return false if
+ * an I/O error occurred.
+ * @param extsort: the external merge sort
+ * @param path: path of the output file
+ * @return: whether all elements were written */
+DS_API bool extsort_write(extsort_t *extsort, const char *path);
+
+/* -------------------------- doubly linked list -------------------------- */
 
 typedef struct linkedlistnode_t {
-	union {
-		void *ptr;							// pointer to malloced buffer containing value, used when value requires >NODE_VALUE_MAX_SIZE bytes
-		int8_t value[NODE_VALUE_MAX_SIZE];	// byte array whose first few elements contain the value, used when value requires <=sizeof(int8_t *) bytes
-	} elem;									// element in this node
-	size_t elem_size;						// size of element
-	struct linkedlistnode_t *prev;			// previous node, NULL if we are the head
-	struct linkedlistnode_t *next;			// next node, NULL if we are the tail
+	struct linkedlistnode_t *prev;	// previous node, NULL if we are the head
+	struct linkedlistnode_t *next;	// next node, NULL if we are the tail
+	int8_t value[];					// element in this node, whose size is the elem_size of its linkedlist
 } linkedlistnode_t;
 
 typedef struct {
 	linkedlistnode_t *head;		// head node, NULL if empty
 	linkedlistnode_t *tail;		// tail node, NULL if empty
-	bool value_in_node;			// true if value is stored in node directly, false if value is stored in malloced buffer whose pointer is stored in node
+	size_t elem_size;			// size of each element, in bytes
 	int64_t len;				// number of elements
 	cmp_func_t cmp_func;		// comparison function
+	int8_t *slab;				// block holding the nodes in list order since the last compaction, NULL if none
+	int64_t slab_len;			// number of nodes `slab` holds
 } linkedlist_t;
 
-/** Create and return a new, empty linkedlist. Return NULL if there is
+/** Create and return a new, empty linkedlist. Each node is a single allocation
+ * sized exactly for two links and an element. Return NULL if there is
  * insufficient memory.
  * @param elem_size: size, in bytes, of each element of the linkedlist
  * @param cmp_func: the comparison function
@@ -278,3 +1612,201 @@ DS_API void linkedlist_free(linkedlist_t *linkedlist);
  * @param linkedlist: the linkedlist
  * @return: length of the linkedlist */
 DS_API int64_t linkedlist_len(linkedlist_t *linkedlist);
+
+/** Append a copy of `value` to the tail of `linkedlist`. Return the node
+ * created, NULL if there is insufficient memory.
+ * @param linkedlist: the linkedlist
+ * @param value: the value to append
+ * @return: the node holding the value */
+DS_API linkedlistnode_t *linkedlist_append(linkedlist_t *linkedlist, const void *value);
+
+/** Prepend a copy of `value` to the head of `linkedlist`. Return the node
+ * created, NULL if there is insufficient memory.
+ * @param linkedlist: the linkedlist
+ * @param value: the value to prepend
+ * @return: the node holding the value */
+DS_API linkedlistnode_t *linkedlist_prepend(linkedlist_t *linkedlist, const void *value);
+
+/** Unlink `node` from `linkedlist` and free it.
+ * @param linkedlist: the linkedlist
+ * @param node: a node of `linkedlist` */
+DS_API void linkedlist_delete(linkedlist_t *linkedlist, linkedlistnode_t *node);
+
+/** Move every node of `linkedlist` into a single contiguous block in list
+ * order and relink them, so that traversing the list reads memory
+ * sequentially again after nodes were scattered by many insertions and
+ * deletions. Pointers to nodes are invalidated. Return false, leaving the
+ * linkedlist unchanged, if there is insufficient memory.
+ * @param linkedlist: the linkedlist
+ * @return: whether the linkedlist was compacted */
+DS_API bool linkedlist_compact(linkedlist_t *linkedlist);
+
+/** Call `func` for each value in `linkedlist` from head to tail by passing a
+ * pointer to the value to `func`. `func` must not add or delete nodes.
+ * @param linkedlist: the linkedlist
+ * @param func: function to call */
+DS_API void linkedlist_foreach(linkedlist_t *linkedlist, void(*func)(void*));
+
+/** Return the first node of `linkedlist` whose value is equal to `value` using
+ * the comparison function, NULL if there is none.
+ * @param linkedlist: the linkedlist
+ * @param value: value to search for
+ * @return: node holding the first occurrence of `value` */
+DS_API linkedlistnode_t *linkedlist_find(const linkedlist_t *linkedlist, const void *value);
+
+/** Return the number of times `value` appears in `linkedlist`, using the
+ * comparison function.
+ * @param linkedlist: the linkedlist
+ * @param value: value to search for
+ * @return: number of times `value` appears */
+DS_API int64_t linkedlist_count(const linkedlist_t *linkedlist, const void *value);
+
+/* ------------------------- intrusive linked list ------------------------- */
+
+/** Link of an intrusive doubly linked list, embedded in the structs on the
+ * list so that linking and unlinking never allocate. A list is circular with a
+ * standalone link as its head; an unlinked link points to itself. A struct can
+ * be on several lists at once by embedding one link per list. */
+typedef struct ds_link_t {
+	struct ds_link_t *prev;		// previous link, the head if we are first
+	struct ds_link_t *next;		// next link, the head if we are last
+} ds_link_t;
+
+/** Return a pointer to the struct of type `type` whose member `member` is at
+ * `ptr`. */
+#define DS_CONTAINER_OF(ptr, type, member) ((type *)((char *)(ptr) - offsetof(type, member)))
+
+/** Iterate `link` over the links of the list with head `head`. The current
+ * link must not be unlinked during iteration. */
+#define DS_LINK_FOREACH(link, head) for (ds_link_t *link = (head)->next; link != (head); link = link->next)
+
+/** Initialize `link` as an empty list head or an unlinked link.
+ * @param link: the link */
+DS_API void ds_link_init(ds_link_t *link);
+
+/** Return whether `link` is on a list, or for a list head whether the list is
+ * non-empty.
+ * @param link: the link
+ * @return: whether the link is linked */
+DS_API bool ds_link_is_linked(const ds_link_t *link);
+
+/** Insert the unlinked `link` just before `pos`. Inserting before a list head
+ * appends to the list.
+ * @param pos: a link on a list, or a list head
+ * @param link: the link to insert */
+DS_API void ds_link_insert_before(ds_link_t *pos, ds_link_t *link);
+
+/** Insert the unlinked `link` just after `pos`. Inserting after a list head
+ * prepends to the list.
+ * @param pos: a link on a list, or a list head
+ * @param link: the link to insert */
+DS_API void ds_link_insert_after(ds_link_t *pos, ds_link_t *link);
+
+/** Remove `link` from its list, leaving it unlinked. Does nothing if it is
+ * already unlinked.
+ * @param link: the link to remove */
+DS_API void ds_link_unlink(ds_link_t *link);
+
+/** Move every link of the list with head `head` just before `pos`, leaving the
+ * list empty, in constant time.
+ * @param pos: a link on another list, or another list head
+ * @param head: head of the list to move */
+DS_API void ds_link_splice(ds_link_t *pos, ds_link_t *head);
+
+/** Move `link`, which may be linked on any list or unlinked, to the front of
+ * the list with head `head`.
+ * @param head: the list head
+ * @param link: the link to move */
+DS_API void ds_link_move_to_front(ds_link_t *head, ds_link_t *link);
+
+/* --------------------------------- cache --------------------------------- */
+
+/** Replacement policy of a cache */
+typedef enum {
+	CACHE_LRU,		// evict the least recently used entry, relinking an entry on every hit
+	CACHE_CLOCK		// evict the first entry not hit since the clock hand last passed it, only setting a bit on a hit
+} cache_policy_t;
+
+/** Function called with the key and value of each entry evicted from a cache,
+ * and the context given to cache_on_evict. */
+typedef void (*cache_evict_func_t)(const void *key, void *value, void *ctx);
+
+/** Entry of a cache holding a key and its value */
+typedef struct cache_entry_t cache_entry_t;
+
+/** Bounded cache type, mapping fixed-size keys to fixed-size values. Entries
+ * are preallocated in a single pool and found through a chained hash index,
+ * so get, put and eviction take O(1) time and never allocate. */
+typedef struct {
+	int64_t capacity;				// maximum number of entries, >0
+	int64_t len;					// number of entries
+	size_t key_size;				// size of each key, in bytes
+	size_t value_size;				// size of each value, in bytes
+	size_t entry_size;				// size of each entry with its key and value, in bytes
+	hash_func_t hash_func;			// hash function of the keys
+	cmp_func_t cmp_func;			// comparison function of the keys
+	cache_policy_t policy;			// replacement policy
+	cache_evict_func_t evict_func;	// function called on eviction, or NULL
+	void *evict_ctx;				// context passed to evict_func
+	int8_t *entries;				// pool of `capacity` entries
+	int64_t *buckets;				// index of the first entry in each bucket, -1 if empty
+	int64_t num_buckets;			// number of buckets, a power of 2
+	ds_link_t recency;				// entries in use from most to least recently used, with LRU
+	ds_link_t free;					// entries not in use
+	int64_t hand;					// index of the entry the clock hand points to, with CLOCK
+	int64_t hits;					// number of calls to cache_get that found their key
+	int64_t misses;					// number of calls to cache_get that did not
+	int64_t evictions;				// number of entries evicted
+} cache_t;
+
+/** Create and return a new, empty cache. Return NULL if there is insufficient
+ * memory.
+ * @param capacity: maximum number of entries, >0
+ * @param key_size: size, in bytes, of each key
+ * @param value_size: size, in bytes, of each value
+ * @param hash_func: hash function of the keys
+ * @param cmp_func: comparison function of the keys
+ * @param policy: replacement policy
+ * @return: the cache created */
+DS_API cache_t *cache_new(int64_t capacity, size_t key_size, size_t value_size, hash_func_t hash_func, cmp_func_t cmp_func, cache_policy_t policy);
+
+/** Free a cache, without calling its eviction function.
+ * @param cache: the cache to free */
+DS_API void cache_free(cache_t *cache);
+
+/** Return the number of entries in a cache.
+ * @param cache: the cache
+ * @return: number of entries */
+DS_API int64_t cache_len(const cache_t *cache);
+
+/** Set the function called with each entry evicted from a cache to make room
+ * for a new one. Entries removed by cache_remove or replaced by cache_put are
+ * not passed to it.
+ * @param cache: the cache
+ * @param evict_func: function called on eviction, or NULL
+ * @param ctx: context passed to `evict_func` */
+DS_API void cache_on_evict(cache_t *cache, cache_evict_func_t evict_func, void *ctx);
+
+/** Return a pointer to the value of `key` in a cache and record a hit on it,
+ * NULL if `key` is not in the cache. The pointer is invalidated by any function
+ * that adds or removes entries.
+ * @param cache: the cache
+ * @param key: the key
+ * @return: pointer to the value */
+DS_API void *cache_get(cache_t *cache, const void *key);
+
+/** Set the value of `key` in a cache to a copy of `value`, evicting an entry
+ * according to the replacement policy if `key` is new and the cache is full.
+ * Return a pointer to the value in the cache, invalidated by any function that
+ * adds or removes entries.
+ * @param cache: the cache
+ * @param key: the key
+ * @param value: the value
+ * @return: pointer to the value */
+DS_API void *cache_put(cache_t *cache, const void *key, const void *value);
+
+/** Remove `key` from a cache. Return false if it was not in the cache.
+ * @param cache: the cache
+ * @param key: the key
+ * @return: whether the key was removed */
+DS_API bool cache_remove(cache_t *cache, const void *key);
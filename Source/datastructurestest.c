@@ -505,7 +505,1896 @@ void test_arraylist(void) {
 	arraylist_free(int_arraylist5);
 }
 
+/** Store twice the int `source` plus the int `ctx` as a double in `dest`. Used to test
+ * arraylist_parallel_map */
+void double_int(void *dest, const void *source, void *ctx) {
+	*(double *)dest = 2. * *(const int *)source + *(int *)ctx;
+}
+
+/** Add the int64_t `value` to the int64_t `accumulator`. Used to test
+ * arraylist_parallel_reduce */
+void add_int64(void *accumulator, const void *value, void *ctx) {
+	*(int64_t *)accumulator += *(const int64_t *)value;
+}
+
+/** Return whether the int `value` is less than the int `ctx`. */
+bool int_less_than(const void *value, void *ctx) {
+	return *(const int *)value < *(int *)ctx;
+}
+
+/** Return whether the int `value` is even. */
+bool int_is_even(const void *value, void *ctx) {
+	return *(const int *)value % 2 == 0;
+}
+
+/** Tests for arraylist removal by predicate and partitioning. */
+void test_arraylist_remove_if(void) {
+	// remove_if in one pass, keeping order, and shrinking
+	arraylist_t *arraylist = arraylist_new(sizeof(int), int_compare);
+	for (int i = 0; i < 10000; i++) {
+		arraylist_append(arraylist, &i);
+	}
+	int bound = 9900;
+	assert_equal(9900, arraylist_remove_if(arraylist, int_less_than, &bound));
+	assert_equal(100, arraylist_len(arraylist));
+	assert_true(arraylist->phys_len <= 100 * 3);
+	for (int i = 0; i < 100; i++) {
+		assert_equal(9900 + i, *(int *)arraylist_get(arraylist, i));
+	}
+	assert_equal(0, arraylist_remove_if(arraylist, int_less_than, &bound));
+	assert_equal(50, arraylist_remove_if(arraylist, int_is_even, NULL));
+	assert_equal(9901, *(int *)arraylist_get(arraylist, 0));
+	assert_equal(9999, *(int *)arraylist_get(arraylist, -1));
+
+	// remove_if on a copy-on-write copy leaves the original intact
+	arraylist_t *copy = arraylist_cow_copy(arraylist);
+	bound = 9951;
+	assert_equal(25, arraylist_remove_if(copy, int_less_than, &bound));
+	assert_equal(50, arraylist_len(arraylist));
+	assert_equal(25, arraylist_len(copy));
+	assert_equal(9951, *(int *)arraylist_get(copy, 0));
+	arraylist_free(copy);
+
+	// remove_all
+	arraylist_clear(arraylist);
+	for (int i = 0; i < 30; i++) {
+		int value = i % 3;
+		arraylist_append(arraylist, &value);
+	}
+	int int_value = 1;
+	assert_equal(10, arraylist_remove_all(arraylist, &int_value));
+	assert_equal(0, arraylist_remove_all(arraylist, &int_value));
+	assert_equal(20, arraylist_len(arraylist));
+	assert_false(arraylist_contains(arraylist, &int_value));
+	for (int i = 0; i < 20; i++) {
+		assert_equal(i % 2 * 2, *(int *)arraylist_get(arraylist, i));
+	}
+
+	// partition
+	arraylist_clear(arraylist);
+	assert_equal(0, arraylist_partition(arraylist, int_is_even, NULL));
+	for (int i = 0; i < 101; i++) {
+		int value = i * 37 % 101;
+		arraylist_append(arraylist, &value);
+	}
+	assert_equal(51, arraylist_partition(arraylist, int_is_even, NULL));
+	int64_t sum = 0;
+	for (int i = 0; i < 101; i++) {
+		int value = *(int *)arraylist_get(arraylist, i);
+		assert_equal(i < 51, value % 2 == 0);
+		sum += value;
+	}
+	assert_equal(5050, sum);
+	bound = 1000;
+	assert_equal(101, arraylist_partition(arraylist, int_less_than, &bound));
+	bound = -1;
+	assert_equal(0, arraylist_partition(arraylist, int_less_than, &bound));
+
+	// stable partition
+	arraylist_clear(arraylist);
+	for (int i = 0; i < 100; i++) {
+		arraylist_append(arraylist, &i);
+	}
+	assert_equal(50, arraylist_stable_partition(arraylist, int_is_even, NULL));
+	for (int i = 0; i < 50; i++) {
+		assert_equal(2 * i, *(int *)arraylist_get(arraylist, i));
+		assert_equal(2 * i + 1, *(int *)arraylist_get(arraylist, 50 + i));
+	}
+	arraylist_free(arraylist);
+}
+
+/** Tests for arraylist selection algorithms. */
+void test_arraylist_select(void) {
+	// nth_element on a permutation
+	arraylist_t *arraylist = arraylist_new(sizeof(int), int_compare);
+	for (int i = 0; i < 10007; i++) {
+		int value = (int)((int64_t)i * 7919 % 10007);
+		arraylist_append(arraylist, &value);
+	}
+	int64_t positions[] = { 0, 1, 2, 5003, 10005, 10006 };
+	for (size_t p = 0; p < COUNTOF(positions); p++) {
+		int64_t n = positions[p];
+		assert_equal(n, *(int *)arraylist_nth_element(arraylist, n));
+		for (int64_t i = 0; i < 10007; i++) {
+			assert_equal(i < n, *(int *)arraylist_get(arraylist, i) < n);
+		}
+	}
+	assert_equal(10006, *(int *)arraylist_nth_element(arraylist, -1));
+	assert_equal(NULL, arraylist_nth_element(arraylist, 10007));
+
+	// nth_element with many duplicates
+	arraylist_t *duplicates = arraylist_new(sizeof(int), int_compare);
+	for (int i = 0; i < 10000; i++) {
+		int value = i % 3;
+		arraylist_append(duplicates, &value);
+	}
+	assert_equal(1, *(int *)arraylist_nth_element(duplicates, 5000));
+	assert_equal(0, *(int *)arraylist_nth_element(duplicates, 3333));
+	assert_equal(1, *(int *)arraylist_nth_element(duplicates, 3334));
+	arraylist_free(duplicates);
+
+	// partial_sort
+	assert_true(arraylist_partial_sort(arraylist, 100));
+	for (int i = 0; i < 100; i++) {
+		assert_equal(i, *(int *)arraylist_get(arraylist, i));
+	}
+	assert_equal(10007, arraylist_len(arraylist));
+	assert_true(arraylist_partial_sort(arraylist, 0));
+	assert_true(arraylist_partial_sort(arraylist, 20000));
+	for (int i = 0; i < 10007; i++) {
+		assert_equal(i, *(int *)arraylist_get(arraylist, i));
+	}
+
+	// top_k, leaving the source unchanged
+	arraylist_reverse(arraylist, &(int){ 0 });
+	arraylist_t *top = arraylist_new(sizeof(int), int_compare);
+	assert_true(arraylist_top_k(arraylist, 10, top));
+	assert_equal(10, arraylist_len(top));
+	for (int i = 0; i < 10; i++) {
+		assert_equal(10006 - i, *(int *)arraylist_get(top, i));
+	}
+	assert_equal(10006, *(int *)arraylist_get(arraylist, 0));
+	assert_true(arraylist_top_k(arraylist, 0, top));
+	assert_equal(0, arraylist_len(top));
+	arraylist_t *small = arraylist_new(sizeof(int), int_compare);
+	int values[] = { 3, 1, 2 };
+	for (int i = 0; i < 3; i++) {
+		arraylist_append(small, &values[i]);
+	}
+	assert_true(arraylist_top_k(small, 5, top));
+	assert_equal(3, arraylist_len(top));
+	assert_equal(3, *(int *)arraylist_get(top, 0));
+	assert_equal(1, *(int *)arraylist_get(top, 2));
+	arraylist_free(small);
+	arraylist_free(top);
+	arraylist_free(arraylist);
+}
+
+/** Pair ordered by key only, to check the stability of merges */
+typedef struct {
+	int key;
+	int tag;
+} keyed_t;
+
+/** Compare the keys of keyed_t `a` and `b`, ignoring their tags */
+int64_t keyed_compare(const void *a, const void *b) {
+	return (int64_t)((const keyed_t *)a)->key - ((const keyed_t *)b)->key;
+}
+
+/** Tests for merging sorted arraylists. */
+void test_arraylist_merge(void) {
+	// interleaved and skewed two-way merges
+	arraylist_t *a = arraylist_new(sizeof(int), int_compare);
+	arraylist_t *b = arraylist_new(sizeof(int), int_compare);
+	arraylist_t *dest = arraylist_new(sizeof(int), int_compare);
+	assert_true(arraylist_merge(a, b, dest));
+	assert_equal(0, arraylist_len(dest));
+	for (int i = 0; i < 1000; i++) {
+		int value = 2 * i;
+		arraylist_append(a, &value);
+		value = i < 500 ? 2 * i + 1 : 5000 + i;
+		arraylist_append(b, &value);
+	}
+	assert_true(arraylist_merge(a, b, dest));
+	assert_equal(2000, arraylist_len(dest));
+	for (int64_t i = 1; i < 2000; i++) {
+		assert_true(*(int *)arraylist_get(dest, i - 1) <= *(int *)arraylist_get(dest, i));
+	}
+	assert_equal(5999, *(int *)arraylist_get(dest, -1));
+	assert_true(arraylist_merge(b, a, dest));
+	for (int64_t i = 1; i < 2000; i++) {
+		assert_true(*(int *)arraylist_get(dest, i - 1) <= *(int *)arraylist_get(dest, i));
+	}
+	arraylist_clear(b);
+	assert_true(arraylist_merge(a, b, dest));
+	assert_equal(0, arraylist_compare(a, dest));
+
+	// merges are stable
+	arraylist_t *ka = arraylist_new(sizeof(keyed_t), keyed_compare);
+	arraylist_t *kb = arraylist_new(sizeof(keyed_t), keyed_compare);
+	arraylist_t *kc = arraylist_new(sizeof(keyed_t), keyed_compare);
+	arraylist_t *kdest = arraylist_new(sizeof(keyed_t), keyed_compare);
+	for (int i = 0; i < 300; i++) {
+		arraylist_append(ka, &(keyed_t){ i / 20, 0 });
+		arraylist_append(kb, &(keyed_t){ i / 10, 1 });
+		arraylist_append(kc, &(keyed_t){ i / 30, 2 });
+	}
+	assert_true(arraylist_merge(ka, kb, kdest));
+	for (int64_t i = 1; i < 600; i++) {
+		keyed_t *prev = arraylist_get(kdest, i - 1), *next = arraylist_get(kdest, i);
+		assert_true(prev->key < next->key || (prev->key == next->key && prev->tag <= next->tag));
+	}
+
+	// k-way merge is stable and handles empty and single lists
+	const arraylist_t *lists[] = { kc, kb, ka };
+	assert_true(arraylist_merge_k(lists, 3, kdest));
+	assert_equal(900, arraylist_len(kdest));
+	for (int64_t i = 1; i < 900; i++) {
+		keyed_t *prev = arraylist_get(kdest, i - 1), *next = arraylist_get(kdest, i);
+		assert_true(prev->key < next->key || (prev->key == next->key && prev->tag >= next->tag));
+	}
+	assert_true(arraylist_merge_k(lists, 1, kdest));
+	assert_equal(0, arraylist_compare(kc, kdest));
+	assert_true(arraylist_merge_k(lists, 0, kdest));
+	assert_equal(0, arraylist_len(kdest));
+	arraylist_t *ints[7];
+	for (int i = 0; i < 7; i++) {
+		// list 3 is dense and list 5 is empty
+		ints[i] = arraylist_new(sizeof(int), int_compare);
+		for (int j = i; j < 700 && i != 5; j += i == 3 ? 1 : 7) {
+			arraylist_append(ints[i], &j);
+		}
+	}
+	assert_true(arraylist_merge_k((const arraylist_t *const *)ints, 7, dest));
+	assert_equal(100 * 5 + 697, arraylist_len(dest));
+	for (int64_t i = 1; i < arraylist_len(dest); i++) {
+		assert_true(*(int *)arraylist_get(dest, i - 1) <= *(int *)arraylist_get(dest, i));
+	}
+	for (int i = 0; i < 7; i++) {
+		arraylist_free(ints[i]);
+	}
+
+	// in-place merge of adjacent ranges
+	arraylist_clear(ka);
+	for (int i = 0; i < 200; i++) {
+		arraylist_append(ka, &(keyed_t){ i % 100 / 3, i / 100 });
+	}
+	assert_false(arraylist_merge_inplace(ka, 0, 300, 200));
+	assert_false(arraylist_merge_inplace(ka, 50, 10, 200));
+	assert_true(arraylist_merge_inplace(ka, 0, 100, 200));
+	for (int64_t i = 1; i < 200; i++) {
+		keyed_t *prev = arraylist_get(ka, i - 1), *next = arraylist_get(ka, i);
+		assert_true(prev->key < next->key || (prev->key == next->key && prev->tag <= next->tag));
+	}
+	assert_true(arraylist_merge_inplace(ka, 10, 10, 20));
+
+	// in-place merge without a buffer, with one too small for either range,
+	// and with one holding only the shorter second range
+	keyed_t scratch[100];
+	int64_t buffer_lens[] = { 0, 10, 100 };
+	for (int pass = 0; pass < 3; pass++) {
+		arraylist_clear(ka);
+		for (int i = 0; i < 300; i++) {
+			arraylist_append(ka, &(keyed_t){ i < 200 ? i / 7 : (i - 200) / 3, i / 200 });
+		}
+		void *buffer = buffer_lens[pass] ? scratch : NULL;
+		assert_false(arraylist_merge_inplace_buffered(ka, 0, 300, 200, buffer, buffer_lens[pass]));
+		assert_true(arraylist_merge_inplace_buffered(ka, 0, 200, 300, buffer, buffer_lens[pass]));
+		for (int64_t i = 1; i < 300; i++) {
+			keyed_t *prev = arraylist_get(ka, i - 1), *next = arraylist_get(ka, i);
+			assert_true(prev->key < next->key || (prev->key == next->key && prev->tag <= next->tag));
+		}
+	}
+
+	arraylist_free(a);
+	arraylist_free(b);
+	arraylist_free(dest);
+	arraylist_free(ka);
+	arraylist_free(kb);
+	arraylist_free(kc);
+	arraylist_free(kdest);
+}
+
+/** Open the file at `path` as fopen does, with fopen_s on Windows. */
+FILE *open_file(const char *path, const char *mode) {
+#ifdef _WIN32
+	FILE *file;
+	return fopen_s(&file, path, mode) ? NULL : file;
+#else
+	return fopen(path, mode);
+#endif
+}
+
+/** Tests for arraylist sorting and external merge sort. */
+void test_extsort(void) {
+	// arraylist_sort is stable
+	arraylist_t *keyed = arraylist_new(sizeof(keyed_t), keyed_compare);
+	arraylist_sort(keyed);
+	assert_equal(0, arraylist_len(keyed));
+	for (int i = 0; i < 1000; i++) {
+		arraylist_append(keyed, &(keyed_t){ (i * 7919) % 61, i });
+	}
+	arraylist_sort(keyed);
+	for (int64_t i = 1; i < 1000; i++) {
+		keyed_t *prev = arraylist_get(keyed, i - 1), *next = arraylist_get(keyed, i);
+		assert_true(prev->key < next->key || (prev->key == next->key && prev->tag < next->tag));
+	}
+
+	// sorting with a caller's buffer stays stable when runs do not fit in it,
+	// and without any buffer insertion sort rotates elements in place
+	keyed_t scratch[100];
+	for (int pass = 0; pass < 2; pass++) {
+		arraylist_clear(keyed);
+		for (int i = 0; i < 1000; i++) {
+			arraylist_append(keyed, &(keyed_t){ (i * 7919) % 61, i });
+		}
+		arraylist_sort_buffered(keyed, pass ? scratch : NULL, pass ? 100 : 0);
+		for (int64_t i = 1; i < 1000; i++) {
+			keyed_t *prev = arraylist_get(keyed, i - 1), *next = arraylist_get(keyed, i);
+			assert_true(prev->key < next->key || (prev->key == next->key && prev->tag < next->tag));
+		}
+	}
+
+	// elements that fit in memory are never spilled
+	extsort_t *extsort = extsort_new(sizeof(int), int_compare, 1 << 20);
+	for (int i = 0; i < 1000; i++) {
+		int value = 999 - i;
+		assert_true(extsort_add(extsort, &value));
+	}
+	assert_true(extsort_finish(extsort));
+	assert_false(extsort_add(extsort, &(int){ 0 }));
+	assert_equal(0, extsort->num_runs);
+	for (int i = 0; i < 1000; i++) {
+		assert_equal(i, *(const int *)extsort_next(extsort));
+	}
+	assert_true(extsort_next(extsort) == NULL);
+	extsort_free(extsort);
+
+	// a small budget spills many runs and merges them in several passes
+	extsort = extsort_new(sizeof(int), int_compare, 16 * 1024);
+	for (int i = 0; i < 100000; i++) {
+		int value = (int)(((int64_t)i * 7919) % 100000);
+		assert_true(extsort_add(extsort, &value));
+	}
+	assert_true(extsort->num_runs > 30);
+	assert_true(extsort_finish(extsort));
+	for (int i = 0; i < 100000; i++) {
+		assert_equal(i, *(const int *)extsort_next(extsort));
+	}
+	assert_true(extsort_next(extsort) == NULL);
+	assert_false(extsort->failed);
+	extsort_free(extsort);
+
+	// the merge is stable and can be written to a file
+	extsort = extsort_new(sizeof(keyed_t), keyed_compare, 4096);
+	for (int i = 0; i < 20000; i++) {
+		assert_true(extsort_add(extsort, &(keyed_t){ (i * 7919) % 97, i }));
+	}
+	assert_true(extsort_finish(extsort));
+	const char *path = "extsort_test.bin";
+	assert_true(extsort_write(extsort, path));
+	extsort_free(extsort);
+	FILE *file = open_file(path, "rb");
+	assert_true(file != NULL);
+	keyed_t prev, next;
+	assert_equal(1, fread(&prev, sizeof(keyed_t), 1, file));
+	int count = 1;
+	while (fread(&next, sizeof(keyed_t), 1, file) == 1) {
+		assert_true(prev.key < next.key || (prev.key == next.key && prev.tag < next.tag));
+		prev = next;
+		count++;
+	}
+	assert_equal(20000, count);
+	fclose(file);
+	remove(path);
+
+	arraylist_free(keyed);
+}
+
+/** Tests for arraylist argsort and permutation. */
+void test_arraylist_argsort(void) {
+	// argsort orders indices stably without moving elements, and applying its
+	// permutation sorts the elements
+	arraylist_t *indices = arraylist_new(sizeof(int64_t), NULL);
+	arraylist_t *shuffled = arraylist_new(sizeof(keyed_t), keyed_compare);
+	for (int i = 0; i < 1000; i++) {
+		arraylist_append(shuffled, &(keyed_t){ (i * 7919) % 61, i });
+	}
+	arraylist_t *sorted = arraylist_copy(shuffled);
+	arraylist_sort(sorted);
+	assert_true(arraylist_argsort(shuffled, indices));
+	assert_equal(1000, arraylist_len(indices));
+	for (int64_t i = 0; i < 1000; i++) {
+		keyed_t *value = arraylist_get(shuffled, *(int64_t *)arraylist_get(indices, i));
+		assert_equal(((keyed_t *)arraylist_get(sorted, i))->tag, value->tag);
+	}
+	assert_true(arraylist_apply_permutation(shuffled, indices));
+	assert_equal(0, memcmp(sorted->contents, shuffled->contents, 1000 * sizeof(keyed_t)));
+	*(int64_t *)arraylist_get(indices, 0) = *(int64_t *)arraylist_get(indices, 1);
+	assert_false(arraylist_apply_permutation(shuffled, indices));
+	assert_equal(0, memcmp(sorted->contents, shuffled->contents, 1000 * sizeof(keyed_t)));
+	assert_true(arraylist_pop(indices, -1, &(int64_t){ 0 }));
+	assert_false(arraylist_apply_permutation(shuffled, indices));
+	arraylist_clear(shuffled);
+	assert_true(arraylist_argsort(shuffled, indices));
+	assert_equal(0, arraylist_len(indices));
+	assert_true(arraylist_apply_permutation(shuffled, indices));
+
+	// indices must be int64_t
+	arraylist_t *wrong = arraylist_new(sizeof(int), int_compare);
+	assert_false(arraylist_argsort(shuffled, wrong));
+	arraylist_free(wrong);
+	arraylist_free(indices);
+	arraylist_free(sorted);
+	arraylist_free(shuffled);
+}
+
+/** Tests for parallel arraylist operations. */
+void test_arraylist_parallel(void) {
+	// empty arraylist
+	int zero = 0;
+	int64_t int64_zero = 0, sum = -1;
+	arraylist_t *int_arraylist0 = arraylist_new(sizeof(int), int_compare);
+	arraylist_t *double_arraylist = arraylist_new(sizeof(double), double_compare);
+	arraylist_parallel_foreach(int_arraylist0, increment);
+	assert_true(arraylist_parallel_map(int_arraylist0, double_arraylist, double_int, &zero));
+	assert_equal(0, arraylist_len(double_arraylist));
+	arraylist_free(int_arraylist0);
+	arraylist_t *int64_arraylist = arraylist_new(sizeof(int64_t), int_compare);
+	assert_true(arraylist_parallel_reduce(int64_arraylist, &int64_zero, add_int64, NULL, &sum));
+	assert_equal(0, sum);
+
+	// arraylist_parallel_foreach and arraylist_parallel_map over many chunks
+	arraylist_t *big_arraylist = arraylist_new(sizeof(int), int_compare);
+	for (int i = 0; i < 100000; i++) {
+		arraylist_append(big_arraylist, &i);
+	}
+	arraylist_parallel_foreach(big_arraylist, increment);
+	for (int i = 0; i < 100000; i++) {
+		assert_equal(i + 1, *(int*)arraylist_get(big_arraylist, i));
+	}
+	int one = 1;
+	assert_true(arraylist_parallel_map(big_arraylist, double_arraylist, double_int, &one));
+	assert_equal(100000, arraylist_len(double_arraylist));
+	for (int i = 0; i < 100000; i++) {
+		assert_equal(2. * (i + 1) + 1, *(double*)arraylist_get(double_arraylist, i));
+	}
+	arraylist_free(big_arraylist);
+	arraylist_free(double_arraylist);
+
+	// arraylist_parallel_reduce
+	for (int64_t i = 1; i <= 100000; i++) {
+		arraylist_append(int64_arraylist, &i);
+	}
+	assert_true(arraylist_parallel_reduce(int64_arraylist, &int64_zero, add_int64, NULL, &sum));
+	assert_equal((int64_t)100000 * 100001 / 2, sum);
+	arraylist_free(int64_arraylist);
+}
+
+/** Argument of fib_task */
+typedef struct {
+	threadpool_t *pool;
+	int n;
+	int64_t result;
+} fib_arg_t;
+
+/** Compute the `n`th Fibonacci number by spawning a subtask for fib(n - 1).
+ * Used to test fork/join on a thread pool. */
+void fib_task(void *arg) {
+	fib_arg_t *fib = arg;
+	if (fib->n < 2) {
+		fib->result = fib->n;
+		return;
+	}
+	fib_arg_t a = { fib->pool, fib->n - 1, 0 }, b = { fib->pool, fib->n - 2, 0 };
+	threadpool_task_t task;
+	threadpool_spawn(fib->pool, &task, fib_task, &a);
+	fib_task(&b);
+	threadpool_join(fib->pool, &task);
+	fib->result = a.result + b.result;
+}
+
+/** Atomically increment the int64_t `value`. Used to test threadpool_spawn */
+void increment_atomic(void *value) {
+#ifdef _WIN32
+	InterlockedIncrement64((volatile LONG64 *)value);
+#else
+	__sync_fetch_and_add((int64_t *)value, 1);
+#endif
+}
+
+/** Number of subtasks spawned by fanout_task, more than fit in a fresh deque */
+#define FANOUT_TASKS 1000
+
+/** Argument of fanout_task */
+typedef struct {
+	threadpool_t *pool;
+	int64_t counter;
+	threadpool_task_t tasks[FANOUT_TASKS];
+} fanout_arg_t;
+
+/** Spawn FANOUT_TASKS increment_atomic subtasks before joining any of them.
+ * Used to test that a worker's deque grows. */
+void fanout_task(void *arg) {
+	fanout_arg_t *fanout = arg;
+	for (int i = 0; i < FANOUT_TASKS; i++) {
+		threadpool_spawn(fanout->pool, &fanout->tasks[i], increment_atomic, &fanout->counter);
+	}
+	for (int i = 0; i < FANOUT_TASKS; i++) {
+		threadpool_join(fanout->pool, &fanout->tasks[i]);
+	}
+}
+
+/** Tests for thread pool. */
+void test_threadpool(void) {
+	// default pool
+	threadpool_t *pool = threadpool_default();
+	assert_not_equal(NULL, pool);
+	assert_equal(pool, threadpool_default());
+	assert_true(threadpool_num_workers(pool) >= 1);
+
+	// spawn from a non-worker thread
+	threadpool_t *pool4 = threadpool_new(4, true);
+	assert_equal(4, threadpool_num_workers(pool4));
+	int64_t counter = 0;
+	threadpool_task_t tasks[100];
+	for (int i = 0; i < 100; i++) {
+		threadpool_spawn(pool4, &tasks[i], increment_atomic, &counter);
+	}
+	for (int i = 0; i < 100; i++) {
+		threadpool_join(pool4, &tasks[i]);
+		assert_true(tasks[i].done);
+	}
+	assert_equal(100, counter);
+
+	// fork/join from worker threads
+	fib_arg_t fib = { pool4, 20, 0 };
+	threadpool_task_t fib_root;
+	threadpool_spawn(pool4, &fib_root, fib_task, &fib);
+	threadpool_join(pool4, &fib_root);
+	assert_equal(6765, fib.result);
+	threadpool_stats_t stats;
+	threadpool_get_stats(pool4, &stats);
+	assert_equal(stats.spawned, stats.executed);
+	assert_true(stats.spawned >= 100);
+	threadpool_free(pool4);
+
+	// single worker pool
+	threadpool_t *pool1 = threadpool_new(1, false);
+	fib.pool = pool1;
+	fib.n = 15;
+	threadpool_spawn(pool1, &fib_root, fib_task, &fib);
+	threadpool_join(pool1, &fib_root);
+	assert_equal(610, fib.result);
+
+	// a lone worker spawning more tasks than its deque holds must grow it
+	fanout_arg_t *fanout = malloc(sizeof(fanout_arg_t));
+	assert_not_equal(NULL, fanout);
+	fanout->pool = pool1;
+	fanout->counter = 0;
+	threadpool_spawn(pool1, &fib_root, fanout_task, fanout);
+	threadpool_join(pool1, &fib_root);
+	assert_equal(FANOUT_TASKS, fanout->counter);
+	threadpool_get_stats(pool1, &stats);
+	assert_equal(stats.spawned, stats.executed);
+	assert_true(stats.spawned > FANOUT_TASKS);
+	free(fanout);
+	threadpool_free(pool1);
+}
+
+/** Tests for arraylists with aligned and huge page contents. */
+void test_arraylist_aligned(void) {
+	// alignment is kept through arraylist_grow, arraylist_shrink,
+	// arraylist_copy and arraylist_clear
+	arraylist_t *aligned = arraylist_new_aligned(sizeof(int), int_compare, 64, false);
+	assert_equal(0, (uintptr_t)aligned->contents % 64);
+	for (int i = 0; i < 1000; i++) {
+		arraylist_append(aligned, &i);
+		assert_equal(0, (uintptr_t)aligned->contents % 64);
+	}
+	for (int i = 0; i < 1000; i++) {
+		assert_equal(i, *(int*)arraylist_get(aligned, i));
+	}
+	arraylist_t *copy = arraylist_copy(aligned);
+	assert_equal(0, (uintptr_t)copy->contents % 64);
+	assert_equal(0, arraylist_compare(aligned, copy));
+	arraylist_free(copy);
+	for (int i = 999; i >= 10; i--) {
+		assert_true(arraylist_delete(aligned, -1));
+		assert_equal(0, (uintptr_t)aligned->contents % 64);
+	}
+	for (int i = 0; i < 10; i++) {
+		assert_equal(i, *(int*)arraylist_get(aligned, i));
+	}
+	arraylist_clear(aligned);
+	assert_equal(0, (uintptr_t)aligned->contents % 64);
+	assert_equal(0, arraylist_len(aligned));
+	arraylist_free(aligned);
+
+	// huge pages, crossing the mapping threshold in both directions
+	arraylist_t *huge = arraylist_new_aligned(sizeof(int64_t), int_compare, 32, true);
+	for (int64_t i = 0; i < 1000000; i++) {
+		arraylist_append(huge, &i);
+	}
+	assert_equal(0, (uintptr_t)huge->contents % 32);
+	copy = arraylist_copy(huge);
+	for (int64_t i = 0; i < 1000000; i++) {
+		assert_equal(i, *(int64_t*)arraylist_get(copy, i));
+	}
+	arraylist_free(copy);
+	for (int64_t i = 0; i < 999990; i++) {
+		assert_true(arraylist_delete(huge, -1));
+	}
+	assert_equal(0, (uintptr_t)huge->contents % 32);
+	for (int64_t i = 0; i < 10; i++) {
+		assert_equal(i, *(int64_t*)arraylist_get(huge, i));
+	}
+	arraylist_clear(huge);
+	assert_equal(0, arraylist_len(huge));
+	arraylist_free(huge);
+}
+
+/** Sum of the ints passed to sum_int. Used to test arraylist_view_foreach */
+int64_t int_sum;
+
+/** Add the int `value` to int_sum. Used to test arraylist_view_foreach */
+void sum_int(const void *value) {
+	int_sum += *(const int *)value;
+}
+
+/** Tests for arraylist views and copy-on-write copies. */
+void test_arraylist_view(void) {
+	int int_values[] = { 0, 1, 2, 3, 4, 1 };
+	int five = 5;
+	arraylist_t *int_arraylist6 = arraylist_from_array(int_values, COUNTOF(int_values), sizeof(int), int_compare);
+
+	// arraylist_view and arraylist_view_get
+	arraylist_view_t view = arraylist_view(int_arraylist6, 1, -1);
+	assert_equal(4, arraylist_view_len(&view));
+	assert_equal(arraylist_get(int_arraylist6, 1), arraylist_view_get(&view, 0));
+	assert_equal(4, *(const int*)arraylist_view_get(&view, -1));
+	assert_equal(NULL, arraylist_view_get(&view, 4));
+	assert_equal(NULL, arraylist_view_get(&view, -5));
+	arraylist_view_t empty = arraylist_view(int_arraylist6, 3, 2);
+	assert_equal(0, arraylist_view_len(&empty));
+	assert_equal(NULL, arraylist_view_get(&empty, 0));
+	empty = arraylist_view(int_arraylist6, -20, -10);
+	assert_equal(0, arraylist_view_len(&empty));
+
+	// arraylist_view_contains, arraylist_view_find, arraylist_view_rfind and
+	// arraylist_view_count
+	assert_true(arraylist_view_contains(&view, &int_values[1]));
+	assert_false(arraylist_view_contains(&view, &int_values[0]));
+	assert_false(arraylist_view_contains(&empty, &int_values[1]));
+	assert_equal(0, arraylist_view_find(&view, &int_values[1]));
+	assert_equal(0, arraylist_view_rfind(&view, &int_values[1]));
+	assert_equal(-1, arraylist_view_find(&view, &five));
+	assert_equal(1, arraylist_view_count(&view, &int_values[1]));
+	arraylist_view_t whole = arraylist_view(int_arraylist6, 0, 20);
+	assert_equal(5, arraylist_view_rfind(&whole, &int_values[1]));
+	assert_equal(2, arraylist_view_count(&whole, &int_values[1]));
+
+	// arraylist_view_slice and arraylist_view_compare
+	arraylist_view_t sub = arraylist_view_slice(&view, 1, 3);
+	assert_equal(2, arraylist_view_len(&sub));
+	assert_equal(2, *(const int*)arraylist_view_get(&sub, 0));
+	arraylist_view_t other = arraylist_view(int_arraylist6, 2, 4);
+	assert_equal(0, arraylist_view_compare(&sub, &other));
+	assert_true(arraylist_view_compare(&sub, &view) > 0);
+	assert_true(arraylist_view_compare(&empty, &view) < 0);
+
+	// arraylist_view_foreach and arraylist_view_copy
+	int_sum = 0;
+	arraylist_view_foreach(&view, sum_int);
+	assert_equal(10, int_sum);
+	arraylist_t *copy = arraylist_view_copy(&sub);
+	assert_equal(2, arraylist_len(copy));
+	assert_equal(3, *(int*)arraylist_get(copy, 1));
+	arraylist_free(copy);
+	copy = arraylist_view_copy(&empty);
+	assert_equal(0, arraylist_len(copy));
+	arraylist_free(copy);
+
+	// arraylist_cow_copy shares contents until modified
+	arraylist_t *cow1 = arraylist_cow_copy(int_arraylist6);
+	arraylist_t *cow2 = arraylist_cow_copy(cow1);
+	assert_equal(int_arraylist6->contents, cow1->contents);
+	assert_equal(int_arraylist6->contents, cow2->contents);
+	assert_equal(0, arraylist_compare(int_arraylist6, cow2));
+	assert_equal(3, *int_arraylist6->refcount);
+	arraylist_set(cow1, 0, &five);
+	assert_not_equal(int_arraylist6->contents, cow1->contents);
+	assert_equal(5, *(int*)arraylist_get(cow1, 0));
+	assert_equal(0, *(int*)arraylist_get(int_arraylist6, 0));
+	assert_equal(0, *(int*)arraylist_get(cow2, 0));
+	assert_equal(2, *int_arraylist6->refcount);
+	arraylist_append(int_arraylist6, &five);
+	assert_equal(7, arraylist_len(int_arraylist6));
+	assert_equal(6, arraylist_len(cow2));
+	assert_equal(1, *(int*)arraylist_get(cow2, -1));
+	assert_true(arraylist_delete(cow2, 0));
+	assert_equal(1, *(int*)arraylist_get(cow2, 0));
+	assert_equal(0, *(int*)arraylist_get(int_arraylist6, 0));
+	arraylist_free(cow1);
+	arraylist_free(cow2);
+
+	// freeing the original first, then clearing and modifying a shared copy
+	cow1 = arraylist_cow_copy(int_arraylist6);
+	cow2 = arraylist_cow_copy(int_arraylist6);
+	arraylist_free(int_arraylist6);
+	assert_true(arraylist_remove(cow1, &five));
+	assert_equal(6, arraylist_len(cow1));
+	assert_equal(7, arraylist_len(cow2));
+	arraylist_clear(cow2);
+	assert_equal(0, arraylist_len(cow2));
+	assert_equal(6, arraylist_len(cow1));
+	assert_true(arraylist_contains(cow1, &int_values[4]));
+	arraylist_free(cow2);
+	arraylist_free(cow1);
+}
+
+/** Hash function for ints, the identity. */
+uint64_t int_hash(const void *value) {
+	return (uint64_t)*(const int *)value;
+}
+
+/** Tests for Bloom filter and arraylists with an attached Bloom filter. */
+void test_bloom(void) {
+	// standalone filter has no false negatives and few false positives
+	bloom_t *bloom = bloom_new(1000, 12, int_hash);
+	for (int i = 0; i < 1000; i++) {
+		bloom_add(bloom, &i);
+	}
+	assert_equal(1000, bloom->count);
+	for (int i = 0; i < 1000; i++) {
+		assert_true(bloom_may_contain(bloom, &i));
+	}
+	int false_positives = 0;
+	for (int i = 1000; i < 101000; i++) {
+		false_positives += bloom_may_contain(bloom, &i);
+	}
+	assert_true(false_positives < 2000);
+	bloom_clear(bloom);
+	assert_equal(0, bloom->count);
+	int int_value = 5;
+	assert_false(bloom_may_contain(bloom, &int_value));
+	bloom_free(bloom);
+
+	// filter attached to an arraylist follows appends and inserts past its capacity
+	arraylist_t *arraylist = arraylist_new(sizeof(int), int_compare);
+	for (int i = 0; i < 100; i += 2) {
+		arraylist_append(arraylist, &i);
+	}
+	assert_true(arraylist_attach_bloom(arraylist, int_hash));
+	for (int i = 100; i < 20000; i += 2) {
+		if (i % 4) arraylist_append(arraylist, &i);
+		else arraylist_insert(arraylist, 0, &i);
+	}
+	assert_not_equal(NULL, arraylist->bloom);
+	assert_true(arraylist->bloom->capacity >= arraylist_len(arraylist));
+	for (int i = 0; i < 20000; i++) {
+		assert_equal(i % 2 == 0, arraylist_contains(arraylist, &i));
+		assert_equal(i % 2 == 0, arraylist_count(arraylist, &i));
+		assert_equal(i % 2 == 0, arraylist_find(arraylist, &i) >= 0);
+		assert_equal(i % 2 == 0, arraylist_rfind(arraylist, &i) >= 0);
+	}
+
+	// set, remove and delete
+	int_value = 1;
+	arraylist_set(arraylist, 0, &int_value);
+	assert_true(arraylist_contains(arraylist, &int_value));
+	assert_true(arraylist_remove(arraylist, &int_value));
+	assert_false(arraylist_remove(arraylist, &int_value));
+	while (arraylist_len(arraylist) > 10) {
+		arraylist_delete(arraylist, -1);
+	}
+	assert_true(arraylist->bloom->capacity < 1000);
+	for (int i = 0; i < 20000; i++) {
+		assert_equal(arraylist_find(arraylist, &i) >= 0, arraylist_contains(arraylist, &i));
+	}
+
+	// foreach modifies every element
+	arraylist_foreach(arraylist, increment);
+	for (int64_t i = 0; i < arraylist_len(arraylist); i++) {
+		int_value = *(int *)arraylist_get(arraylist, i);
+		assert_true(arraylist_contains(arraylist, &int_value));
+		int_value--;
+		assert_false(arraylist_contains(arraylist, &int_value));
+	}
+
+	// copies do not share the filter
+	arraylist_t *copy = arraylist_copy(arraylist);
+	arraylist_t *cow_copy = arraylist_cow_copy(arraylist);
+	assert_equal(NULL, copy->bloom);
+	assert_equal(NULL, cow_copy->bloom);
+	arraylist_free(copy);
+	arraylist_free(cow_copy);
+
+	// clear, detach
+	arraylist_clear(arraylist);
+	int_value = 19999;
+	assert_false(arraylist_contains(arraylist, &int_value));
+	arraylist_append(arraylist, &int_value);
+	assert_true(arraylist_contains(arraylist, &int_value));
+	arraylist_detach_bloom(arraylist);
+	assert_equal(NULL, arraylist->bloom);
+	assert_true(arraylist_contains(arraylist, &int_value));
+	arraylist_free(arraylist);
+}
+
+/** Tests for batched arraylist lookups. */
+void test_arraylist_batch(void) {
+	arraylist_t *arraylist = arraylist_new(sizeof(int), int_compare);
+	int keys[1000];
+	int64_t indices[1000];
+	for (int i = 0; i < 1000; i++) {
+		keys[i] = i * 7 % 1000 - 100;
+	}
+	// empty arraylist
+	arraylist_find_many(arraylist, keys, 1000, indices);
+	for (int i = 0; i < 1000; i++) {
+		assert_equal(-1, indices[i]);
+	}
+	arraylist_lower_bound_many(arraylist, keys, 1000, indices);
+	for (int i = 0; i < 1000; i++) {
+		assert_equal(0, indices[i]);
+	}
+
+	// sorted with duplicates, spanning several blocks and batches
+	for (int i = 0; i < 20000; i++) {
+		int value = i / 3 * 2 % 900;
+		arraylist_append(arraylist, &value);
+	}
+	arraylist_find_many(arraylist, keys, 1000, indices);
+	for (int i = 0; i < 1000; i++) {
+		assert_equal(arraylist_find(arraylist, &keys[i]), indices[i]);
+	}
+	arraylist_attach_bloom(arraylist, int_hash);
+	arraylist_find_many(arraylist, keys, 999, indices);
+	for (int i = 0; i < 999; i++) {
+		assert_equal(arraylist_find(arraylist, &keys[i]), indices[i]);
+	}
+	arraylist_sort(arraylist);
+	arraylist_lower_bound_many(arraylist, keys, 1000, indices);
+	for (int i = 0; i < 1000; i++) {
+		int64_t expected = 0;
+		while (expected < 20000 && *(int *)arraylist_get(arraylist, expected) < keys[i]) expected++;
+		assert_equal(expected, indices[i]);
+	}
+	// every length of a short arraylist
+	arraylist_clear(arraylist);
+	for (int len = 1; len < 40; len++) {
+		int value = 2 * len;
+		arraylist_append(arraylist, &value);
+		arraylist_lower_bound_many(arraylist, keys, 1000, indices);
+		for (int i = 0; i < 1000; i++) {
+			int64_t expected = keys[i] <= 2 ? 0 : MIN((keys[i] + 1) / 2 - 1, len);
+			assert_equal(expected, indices[i]);
+		}
+	}
+	arraylist_free(arraylist);
+}
+
+/** Tests for columnar arraylist. */
+void test_columnlist(void) {
+	// rows of an 8-byte id, an 8-byte value and a 4-byte flag
+	size_t column_sizes[] = { sizeof(int64_t), sizeof(double), sizeof(int32_t) };
+	columnlist_t *columnlist = columnlist_new(column_sizes, COUNTOF(column_sizes));
+	assert_equal(0, columnlist_len(columnlist));
+	assert_equal(20, columnlist->row_size);
+	assert_equal(NULL, columnlist_get(columnlist, 0, 0));
+	assert_equal(NULL, columnlist_column(columnlist, 3));
+
+	// append packed rows
+	int8_t row[20];
+	for (int64_t i = 0; i < 1000; i++) {
+		double value = i * 0.5;
+		int32_t flag = (int32_t)(i % 3);
+		memcpy(row, &i, 8);
+		memcpy(row + 8, &value, 8);
+		memcpy(row + 16, &flag, 4);
+		assert_true(columnlist_append(columnlist, row));
+	}
+	assert_equal(1000, columnlist_len(columnlist));
+
+	// columns are contiguous
+	const int64_t *ids = columnlist_column(columnlist, 0);
+	const double *values = columnlist_column(columnlist, 1);
+	const int32_t *flags = columnlist_column(columnlist, 2);
+	for (int64_t i = 0; i < 1000; i++) {
+		assert_equal(i, ids[i]);
+		assert_equal(i * 0.5, values[i]);
+		assert_equal(i % 3, flags[i]);
+	}
+	assert_equal(999, *(int64_t *)columnlist_get(columnlist, 0, -1));
+	assert_equal(NULL, columnlist_get(columnlist, 1, 1000));
+	assert_equal(NULL, columnlist_get(columnlist, -1, 0));
+
+	// get and set whole rows
+	assert_true(columnlist_get_row(columnlist, 10, row));
+	assert_equal(10, *(int64_t *)row);
+	assert_equal(5.0, *(double *)(row + 8));
+	assert_equal(1, *(int32_t *)(row + 16));
+	assert_false(columnlist_get_row(columnlist, -1001, row));
+	*(int64_t *)row = -10;
+	assert_true(columnlist_set_row(columnlist, 10, row));
+	assert_equal(-10, *(int64_t *)columnlist_get(columnlist, 0, 10));
+	assert_equal(5.0, *(double *)columnlist_get(columnlist, 1, 10));
+
+	// delete rows, shrinking every column
+	for (int i = 0; i < 900; i++) {
+		assert_true(columnlist_delete(columnlist, 0));
+	}
+	assert_false(columnlist_delete(columnlist, 100));
+	assert_equal(100, columnlist_len(columnlist));
+	assert_true(columnlist->phys_len < 1000);
+	for (int64_t i = 0; i < 100; i++) {
+		assert_equal(900 + i, *(int64_t *)columnlist_get(columnlist, 0, i));
+		assert_equal((900 + i) % 3, *(int32_t *)columnlist_get(columnlist, 2, i));
+	}
+	assert_true(columnlist_delete(columnlist, -1));
+	assert_equal(998, *(int64_t *)columnlist_get(columnlist, 0, -1));
+
+	// clear
+	columnlist_clear(columnlist);
+	assert_equal(0, columnlist_len(columnlist));
+	assert_true(columnlist_append(columnlist, row));
+	assert_equal(-10, *(int64_t *)columnlist_get(columnlist, 0, 0));
+	columnlist_free(columnlist);
+}
+
+/** Argument of segvec_task */
+typedef struct {
+	segvec_t *segvec;
+	int first;
+	int count;
+	int **elements;		// receives the pointer returned by each append
+} segvec_task_arg_t;
+
+/** Append `count` consecutive ints starting at `first`. */
+void segvec_task(void *arg) {
+	segvec_task_arg_t *task_arg = arg;
+	for (int i = 0; i < task_arg->count; i++) {
+		int value = task_arg->first + i;
+		task_arg->elements[value] = segvec_append(task_arg->segvec, &value);
+	}
+}
+
+/** Tests for segmented vector. */
+void test_segvec(void) {
+	segvec_t *segvec = segvec_new(sizeof(int), 3);
+	assert_equal(2, segvec->first_segment_bits);
+	assert_equal(0, segvec_len(segvec));
+	assert_equal(NULL, segvec_get(segvec, 0));
+
+	// element addresses are stable as segments are added
+	int *first = segvec_append(segvec, &(int){ 0 });
+	for (int i = 1; i < 10000; i++) {
+		int *elem = segvec_append(segvec, &i);
+		assert_equal(i, *elem);
+		assert_equal(elem, segvec_get(segvec, i));
+	}
+	assert_equal(10000, segvec_len(segvec));
+	assert_equal(first, segvec_get(segvec, 0));
+	assert_equal(0, *first);
+	assert_equal(9999, *(int *)segvec_get(segvec, -1));
+	assert_equal(0, *(int *)segvec_get(segvec, -10000));
+	assert_equal(NULL, segvec_get(segvec, 10000));
+	assert_equal(NULL, segvec_get(segvec, -10001));
+	for (int i = 0; i < 10000; i++) {
+		assert_equal(i, *(int *)segvec_get(segvec, i));
+	}
+	segvec_free(segvec);
+
+	// slots whose append failed read as missing: claim slot 4 without writing
+	// it, as an append whose segment could not be allocated does
+	segvec = segvec_new(sizeof(int), 4);
+	segvec->len = 5;
+	int *installed = segvec_append(segvec, &(int){ 5 });
+	assert_not_equal(NULL, installed);
+	assert_equal(6, segvec_len(segvec));
+	assert_equal(installed, segvec_get(segvec, 5));
+	assert_equal(NULL, segvec_get(segvec, 4));
+	assert_equal(NULL, segvec_get(segvec, 0));
+
+	// appends past the last segment fail but still count toward the length
+	int64_t capacity = ((int64_t)4 << SEGVEC_MAX_SEGMENTS) - 4;
+	segvec->len = capacity;
+	assert_equal(NULL, segvec_append(segvec, &(int){ 0 }));
+	assert_equal(NULL, segvec_append(segvec, &(int){ 0 }));
+	assert_equal(capacity + 2, segvec_len(segvec));
+	assert_equal(NULL, segvec_get(segvec, -1));
+	assert_equal(NULL, segvec_get(segvec, capacity));
+	assert_equal(installed, segvec_get(segvec, 5));
+	segvec_free(segvec);
+
+	// concurrent appends each get their own slot
+	segvec = segvec_new(sizeof(int), 1);
+	threadpool_t *pool = threadpool_new(4, false);
+	int **elements = malloc(40000 * sizeof(int *));
+	segvec_task_arg_t args[8];
+	threadpool_task_t tasks[8];
+	for (int i = 0; i < 8; i++) {
+		args[i] = (segvec_task_arg_t){ segvec, i * 5000, 5000, elements };
+		threadpool_spawn(pool, &tasks[i], segvec_task, &args[i]);
+	}
+	for (int i = 0; i < 8; i++) {
+		threadpool_join(pool, &tasks[i]);
+	}
+	assert_equal(40000, segvec_len(segvec));
+	bitset_t *seen = bitset_new(40000);
+	for (int i = 0; i < 40000; i++) {
+		assert_equal(i, *elements[i]);
+		int value = *(int *)segvec_get(segvec, i);
+		assert_false(bitset_test(seen, value));
+		bitset_set(seen, value);
+	}
+	assert_equal(40000, bitset_count(seen, 0, 40000));
+	bitset_free(seen);
+	free(elements);
+	threadpool_free(pool);
+	segvec_free(segvec);
+}
+
+/** Compare two byte strings by length only. Used to test varlist_sort */
+int64_t length_compare(const void *a, size_t len_a, const void *b, size_t len_b) {
+	return (int64_t)len_a - (int64_t)len_b;
+}
+
+/** Return whether the element at index `index` of `varlist` is the string
+ * `str`, without its null terminator. */
+bool varlist_equals(const varlist_t *varlist, int64_t index, const char *str) {
+	size_t len;
+	const void *value = varlist_get(varlist, index, &len);
+	return value && len == strlen(str) && memcmp(value, str, len) == 0;
+}
+
+/** Tests for variable-length arraylist. */
+void test_varlist(void) {
+	varlist_t *varlist = varlist_new(NULL);
+	assert_equal(0, varlist_len(varlist));
+	assert_equal(NULL, varlist_get(varlist, 0, NULL));
+
+	// append and get
+	char str[32];
+	for (int i = 0; i < 1000; i++) {
+		int len = snprintf(str, sizeof(str), "key%d", i * 7 % 1000);
+		assert_true(varlist_append(varlist, str, (size_t)len));
+	}
+	assert_true(varlist_append(varlist, "", 0));
+	assert_equal(1001, varlist_len(varlist));
+	size_t len;
+	assert_true(varlist_equals(varlist, 1, "key7"));
+	assert_true(varlist_equals(varlist, -1, ""));
+	assert_equal(NULL, varlist_get(varlist, 1001, &len));
+	assert_equal(NULL, varlist_get(varlist, -1002, &len));
+
+	// byte order sort is stable and puts prefixes first
+	assert_true(varlist_sort(varlist));
+	assert_true(varlist_equals(varlist, 0, ""));
+	assert_true(varlist_equals(varlist, 1, "key0"));
+	assert_true(varlist_equals(varlist, 2, "key1"));
+	assert_true(varlist_equals(varlist, 3, "key10"));
+	for (int64_t i = 2; i < 1001; i++) {
+		size_t prev_len;
+		const char *prev = varlist_get(varlist, i - 1, &prev_len), *next = varlist_get(varlist, i, &len);
+		int cmp = memcmp(prev, next, MIN(prev_len, len));
+		assert_true(cmp < 0 || (cmp == 0 && prev_len < len));
+	}
+
+	// deletions are compacted lazily, keeping the order
+	assert_false(varlist_delete(varlist, 1001));
+	assert_true(varlist_delete(varlist, 0));
+	for (int i = 0; i < 900; i++) {
+		assert_true(varlist_delete(varlist, -1));
+	}
+	assert_equal(100, varlist_len(varlist));
+	assert_true(varlist->garbage < varlist->arena_len);
+	assert_true(varlist_compact(varlist));
+	assert_equal(0, varlist->garbage);
+	int64_t total = 0;
+	for (int64_t i = 0; i < 100; i++) {
+		varlist_get(varlist, i, &len);
+		total += (int64_t)len;
+	}
+	assert_equal(total, varlist->arena_len);
+	assert_true(varlist_equals(varlist, 0, "key0"));
+
+	// stable sort with a user comparator
+	varlist_clear(varlist);
+	assert_equal(0, varlist_len(varlist));
+	varlist_t *by_length = varlist_new(length_compare);
+	const char *words[] = { "ccc", "a", "bb", "dd", "e", "fff", "gg" };
+	for (int i = 0; i < 7; i++) {
+		varlist_append(by_length, words[i], strlen(words[i]));
+	}
+	assert_true(varlist_sort(by_length));
+	const char *expected[] = { "a", "e", "bb", "dd", "gg", "ccc", "fff" };
+	for (int i = 0; i < 7; i++) {
+		assert_true(varlist_equals(by_length, i, expected[i]));
+	}
+	varlist_free(by_length);
+
+	// bulk import of lines, keeping empty lines but not a trailing empty one
+	const char *lines = "alpha\nbeta\n\ngamma\n";
+	assert_true(varlist_import_delimited(varlist, lines, strlen(lines), '\n'));
+	assert_equal(4, varlist_len(varlist));
+	assert_true(varlist_equals(varlist, 1, "beta"));
+	assert_true(varlist_equals(varlist, 2, ""));
+	assert_true(varlist_import_delimited(varlist, "x,yz", 4, ','));
+	assert_equal(6, varlist_len(varlist));
+	assert_true(varlist_equals(varlist, -1, "yz"));
+
+	// bulk import of length-prefixed elements, rejecting truncated buffers
+	int8_t buffer[64];
+	size_t size = 0;
+	for (uint32_t i = 0; i < 4; i++) {
+		memcpy(buffer + size, &i, sizeof(i));
+		memset(buffer + size + sizeof(i), 'a' + (int)i, i);
+		size += sizeof(i) + i;
+	}
+	assert_false(varlist_import_length_prefixed(varlist, buffer, size - 1));
+	assert_false(varlist_import_length_prefixed(varlist, buffer, 2));
+	assert_equal(6, varlist_len(varlist));
+	assert_true(varlist_import_length_prefixed(varlist, buffer, size));
+	assert_equal(10, varlist_len(varlist));
+	assert_true(varlist_equals(varlist, 6, ""));
+	assert_true(varlist_equals(varlist, -1, "ddd"));
+	varlist_free(varlist);
+}
+
+/** Tests for static search index. */
+void test_searchindex(void) {
+	arraylist_t *arraylist = arraylist_new(sizeof(int), int_compare);
+	searchindex_t *index = arraylist_build_search_index(arraylist);
+	assert_equal(0, searchindex_len(index));
+	assert_equal(0, searchindex_lower_bound(index, &(int){ 0 }));
+	searchindex_free(index);
+
+	// every length up to a few complete trees, with duplicates
+	for (int len = 1; len <= 70; len++) {
+		arraylist_clear(arraylist);
+		for (int i = 0; i < len; i++) {
+			int value = i / 3 * 2;
+			arraylist_append(arraylist, &value);
+		}
+		index = arraylist_build_search_index(arraylist);
+		assert_equal(len, searchindex_len(index));
+		for (int value = -1; value <= len; value++) {
+			int64_t expected = 0;
+			while (expected < len && *(int *)arraylist_get(arraylist, expected) < value) expected++;
+			assert_equal(expected, searchindex_lower_bound(index, &value));
+		}
+		searchindex_free(index);
+	}
+
+	// the index is a copy independent of the arraylist
+	arraylist_clear(arraylist);
+	for (int i = 0; i < 100000; i++) {
+		int value = 3 * i;
+		arraylist_append(arraylist, &value);
+	}
+	index = arraylist_build_search_index(arraylist);
+	arraylist_free(arraylist);
+	for (int i = 0; i < 100000; i++) {
+		int value = 3 * i;
+		assert_equal(i, searchindex_lower_bound(index, &value));
+		value--;
+		assert_equal(i, searchindex_lower_bound(index, &value));
+	}
+	assert_equal(100000, searchindex_lower_bound(index, &(int){ 300000 }));
+	searchindex_free(index);
+}
+
+/** Tests for compressed integer list. */
+void test_intlist(void) {
+	intlist_t *intlist = intlist_new();
+	int64_t value;
+	assert_equal(0, intlist_len(intlist));
+	assert_false(intlist_get(intlist, 0, &value));
+	assert_equal(0, intlist_lower_bound(intlist, 5));
+
+	// sorted timestamps with small gaps compress to a few bits per value
+	int64_t expected = 1700000000000;
+	for (int64_t i = 0; i < 100000; i++) {
+		assert_true(intlist_append(intlist, expected));
+		expected += 1 + i * 7919 % 13;
+	}
+	assert_equal(100000, intlist_len(intlist));
+	assert_true(intlist_size(intlist) * 4 < 100000 * (int64_t)sizeof(int64_t));
+	intlist_iter_t *iter = intlist_iter_new(intlist);
+	expected = 1700000000000;
+	int64_t prev = INT64_MIN;
+	for (int64_t i = 0; i < 100000; i++) {
+		const int64_t *next = intlist_iter_next(iter);
+		assert_equal(expected, *next);
+		assert_true(intlist_get(intlist, i, &value));
+		assert_equal(expected, value);
+		// the first value not less than each value or anything after the previous one
+		assert_equal(i, intlist_lower_bound(intlist, expected));
+		assert_equal(i, intlist_lower_bound(intlist, prev + 1));
+		prev = expected;
+		expected += 1 + i * 7919 % 13;
+	}
+	assert_equal(NULL, intlist_iter_next(iter));
+	intlist_iter_reset(iter);
+	assert_equal(1700000000000, *intlist_iter_next(iter));
+	intlist_iter_free(iter);
+	assert_equal(100000, intlist_lower_bound(intlist, expected));
+	assert_true(intlist_get(intlist, -1, &value));
+	assert_false(intlist_get(intlist, 100000, &value));
+	assert_false(intlist_get(intlist, -100001, &value));
+	intlist_free(intlist);
+
+	// unsorted values, duplicates and extremes round trip through arraylists
+	arraylist_t *arraylist = arraylist_new(sizeof(int64_t), NULL);
+	for (int64_t i = 0; i < 1000; i++) {
+		int64_t values[] = { i % 3 ? INT64_MAX : INT64_MIN, -i * 1000003, 42, 42, (i * 7919) % 256 };
+		arraylist_append(arraylist, &values[i % 5]);
+	}
+	intlist = intlist_from_arraylist(arraylist);
+	assert_equal(1000, intlist_len(intlist));
+	arraylist_t *decoded = arraylist_new(sizeof(int64_t), NULL);
+	assert_true(intlist_to_arraylist(intlist, decoded));
+	assert_equal(1000, arraylist_len(decoded));
+	assert_equal(0, memcmp(arraylist->contents, decoded->contents, 1000 * sizeof(int64_t)));
+	intlist_free(intlist);
+
+	// constant runs pack to zero bits
+	intlist = intlist_new();
+	for (int64_t i = 0; i < 1024; i++) {
+		intlist_append(intlist, 5);
+	}
+	assert_equal(0, intlist->num_words);
+	assert_equal(0, intlist_lower_bound(intlist, 5));
+	assert_equal(1024, intlist_lower_bound(intlist, 6));
+	assert_true(intlist_to_arraylist(intlist, decoded));
+	assert_equal(5, *(int64_t *)arraylist_get(decoded, 1023));
+
+	// conversions need arraylists of int64_t
+	arraylist_t *ints = arraylist_new(sizeof(int), int_compare);
+	assert_equal(NULL, intlist_from_arraylist(ints));
+	assert_false(intlist_to_arraylist(intlist, ints));
+	arraylist_free(ints);
+	intlist_free(intlist);
+
+	arraylist_free(arraylist);
+	arraylist_free(decoded);
+}
+
+/** Tests for bitset. */
+void test_bitset(void) {
+	// new bitset is clear
+	bitset_t *bitset = bitset_new(200);
+	assert_equal(200, bitset_len(bitset));
+	assert_equal(0, bitset_count(bitset, 0, 200));
+	assert_equal(-1, bitset_next_set(bitset, 0));
+	assert_equal(0, bitset_next_clear(bitset, 0));
+	assert_equal(-1, bitset_select(bitset, 0));
+
+	// set, clear, test, out of bounds
+	for (int64_t i = 0; i < 200; i += 3) {
+		assert_true(bitset_set(bitset, i));
+	}
+	assert_false(bitset_set(bitset, 200));
+	assert_false(bitset_set(bitset, -1));
+	assert_true(bitset_clear(bitset, 3));
+	assert_false(bitset_clear(bitset, 200));
+	assert_true(bitset_test(bitset, 0));
+	assert_false(bitset_test(bitset, 3));
+	assert_true(bitset_test(bitset, 198));
+	assert_false(bitset_test(bitset, 199));
+	assert_false(bitset_test(bitset, 201));
+
+	// count, rank, select
+	assert_equal(66, bitset_count(bitset, 0, 200));
+	assert_equal(66, bitset_count(bitset, -1000, 1000));
+	assert_equal(1, bitset_count(bitset, 63, 64));
+	assert_equal(21, bitset_count(bitset, 64, 128));
+	assert_equal(0, bitset_count(bitset, 100, 50));
+	assert_equal(0, bitset_rank(bitset, 0));
+	assert_equal(1, bitset_rank(bitset, 1));
+	assert_equal(1, bitset_rank(bitset, 6));
+	assert_equal(2, bitset_rank(bitset, 7));
+	assert_equal(66, bitset_rank(bitset, 500));
+	for (int64_t k = 1; k < 66; k++) {
+		assert_equal(3 * (k + 1), bitset_select(bitset, k));
+		assert_equal(k, bitset_rank(bitset, bitset_select(bitset, k)));
+	}
+	assert_equal(0, bitset_select(bitset, 0));
+	assert_equal(-1, bitset_select(bitset, 66));
+
+	// rank directory agrees with counting, including after modifications
+	bitset_t *large = bitset_new(10000);
+	for (int64_t i = 0; i < 10000; i++) {
+		if ((i * 2654435761u) % 7 < 3) bitset_set(large, i);
+	}
+	assert_true(bitset_build_rank(large));
+	assert_true(bitset_clear(large, 5000));
+	assert_true(bitset_set(large, 5001));
+	for (int pass = 0; pass < 2; pass++) {
+		int64_t num_set = bitset_count(large, 0, 10000);
+		for (int64_t i = 0; i <= 10000; i += 7) {
+			assert_equal(bitset_count(large, 0, i), bitset_rank(large, i));
+		}
+		int64_t index = -1;
+		for (int64_t k = 0; k < num_set; k++) {
+			index = bitset_next_set(large, index + 1);
+			assert_equal(index, bitset_select(large, k));
+		}
+		assert_equal(-1, bitset_select(large, num_set));
+		assert_true(bitset_build_rank(large));
+	}
+	assert_true(bitset_resize(large, 4096));
+	assert_equal(bitset_count(large, 0, 4096), bitset_rank(large, 4096));
+	assert_equal(-1, bitset_select(large, bitset_count(large, 0, 4096)));
+	bitset_fill(large, true);
+	assert_equal(4096, bitset_rank(large, 5000));
+	assert_equal(4095, bitset_select(large, 4095));
+	bitset_free(large);
+
+	// find next set and clear
+	assert_equal(6, bitset_next_set(bitset, 1));
+	assert_equal(126, bitset_next_set(bitset, 124));
+	assert_equal(-1, bitset_next_set(bitset, 199));
+	assert_equal(1, bitset_next_clear(bitset, 0));
+	assert_equal(3, bitset_next_clear(bitset, 3));
+	bitset_fill(bitset, true);
+	assert_equal(200, bitset_count(bitset, 0, 200));
+	assert_equal(-1, bitset_next_clear(bitset, 0));
+	assert_true(bitset_clear(bitset, 130));
+	assert_equal(130, bitset_next_clear(bitset, 64));
+
+	// resize keeps bits, clears new ones, and append grows
+	assert_true(bitset_resize(bitset, 100));
+	assert_equal(100, bitset_count(bitset, 0, 100));
+	assert_true(bitset_resize(bitset, 1000));
+	assert_equal(100, bitset_count(bitset, 0, 1000));
+	assert_false(bitset_test(bitset, 150));
+	for (int i = 0; i < 1000; i++) {
+		assert_true(bitset_append(bitset, i % 2));
+	}
+	assert_equal(2000, bitset_len(bitset));
+	assert_equal(600, bitset_count(bitset, 0, 2000));
+	assert_true(bitset_test(bitset, 1001));
+	assert_false(bitset_test(bitset, 1002));
+
+	// bitwise operations between bitsets of different lengths
+	bitset_t *a = bitset_new(130), *b = bitset_new(70);
+	for (int64_t i = 0; i < 130; i += 2) bitset_set(a, i);
+	for (int64_t i = 0; i < 70; i += 3) bitset_set(b, i);
+	bitset_t *c = bitset_new(130);
+	bitset_or(c, a);
+	bitset_and(c, b);
+	for (int64_t i = 0; i < 130; i++) {
+		assert_equal(i < 70 && i % 6 == 0, bitset_test(c, i));
+	}
+	bitset_fill(c, false);
+	bitset_or(c, a);
+	bitset_andnot(c, b);
+	for (int64_t i = 0; i < 130; i++) {
+		assert_equal(i % 2 == 0 && (i >= 70 || i % 3 != 0), bitset_test(c, i));
+	}
+	bitset_fill(c, false);
+	bitset_or(c, a);
+	bitset_xor(c, b);
+	for (int64_t i = 0; i < 130; i++) {
+		assert_equal((i % 2 == 0) != (i < 70 && i % 3 == 0), bitset_test(c, i));
+	}
+	bitset_fill(b, true);
+	bitset_or(b, a);
+	assert_equal(70, bitset_count(b, 0, 70));
+	assert_equal(70, bitset_len(b));
+	bitset_free(a);
+	bitset_free(b);
+	bitset_free(c);
+	bitset_free(bitset);
+}
+
+/** Tests for persistent vector. */
+void test_pvector(void) {
+	// empty persistent vector
+	pvector_t *empty = pvector_new(sizeof(int), int_compare);
+	assert_equal(0, pvector_len(empty));
+	assert_equal(NULL, pvector_get(empty, 0));
+	assert_equal(NULL, pvector_get(empty, -1));
+	int int_value = 7;
+	assert_equal(NULL, pvector_set(empty, 0, &int_value));
+
+	// pvector_append keeps every version intact, across several tree levels
+	pvector_t *versions[2001];
+	versions[0] = empty;
+	for (int i = 0; i < 2000; i++) {
+		versions[i + 1] = pvector_append(versions[i], &i);
+		assert_equal(i + 1, pvector_len(versions[i + 1]));
+	}
+	for (int v = 0; v <= 2000; v += 37) {
+		assert_equal(v, pvector_len(versions[v]));
+		for (int i = 0; i < v; i++) {
+			assert_equal(i, *(const int*)pvector_get(versions[v], i));
+		}
+	}
+	assert_equal(1999, *(const int*)pvector_get(versions[2000], -1));
+
+	// pvector_set in the tree and in the tail
+	pvector_t *set_tree = pvector_set(versions[2000], 5, &int_value);
+	pvector_t *set_tail = pvector_set(set_tree, -1, &int_value);
+	assert_equal(7, *(const int*)pvector_get(set_tree, 5));
+	assert_equal(1999, *(const int*)pvector_get(set_tree, 1999));
+	assert_equal(7, *(const int*)pvector_get(set_tail, 5));
+	assert_equal(7, *(const int*)pvector_get(set_tail, 1999));
+	assert_equal(5, *(const int*)pvector_get(versions[2000], 5));
+	assert_equal(1999, *(const int*)pvector_get(versions[2000], 1999));
+	assert_equal(NULL, pvector_set(set_tail, 2000, &int_value));
+	// freeing versions in any order leaves the others intact
+	for (int v = 0; v < 2000; v++) {
+		pvector_free(versions[v]);
+	}
+	pvector_free(set_tree);
+	assert_equal(1000, *(const int*)pvector_get(set_tail, 1000));
+	pvector_free(versions[2000]);
+
+	// transients
+	pvector_t *transient = pvector_transient(set_tail);
+	for (int i = 2000; i < 100000; i++) {
+		assert_true(pvector_transient_append(transient, &i));
+	}
+	for (int i = 0; i < 100000; i += 3) {
+		int doubled = 2 * i;
+		assert_true(pvector_transient_set(transient, i, &doubled));
+	}
+	assert_false(pvector_transient_set(transient, 100000, &int_value));
+	pvector_persistent(transient);
+	assert_equal(100000, pvector_len(transient));
+	assert_equal(2000, pvector_len(set_tail));
+	for (int i = 0; i < 100000; i++) {
+		int expected = i % 3 ? i : 2 * i;
+		if (i == 5 || i == 1999) expected = i % 3 ? 7 : expected;
+		assert_equal(expected, *(const int*)pvector_get(transient, i));
+	}
+	assert_equal(7, *(const int*)pvector_get(set_tail, 1999));
+	assert_equal(1000, *(const int*)pvector_get(set_tail, 1000));
+	pvector_free(set_tail);
+
+	// pvector_from_arraylist and pvector_to_arraylist
+	arraylist_t *arraylist = pvector_to_arraylist(transient);
+	assert_equal(100000, arraylist_len(arraylist));
+	pvector_t *from_arraylist = pvector_from_arraylist(arraylist);
+	assert_equal(100000, pvector_len(from_arraylist));
+	for (int i = 0; i < 100000; i++) {
+		assert_equal(*(int*)arraylist_get(arraylist, i), *(const int*)pvector_get(from_arraylist, i));
+	}
+	arraylist_free(arraylist);
+	pvector_free(from_arraylist);
+	pvector_free(transient);
+}
+
+/** Argument of skiplist_task */
+typedef struct {
+	skiplist_t *skiplist;
+	int first;		// first value handled by the task
+	int stride;		// distance between values handled by the task
+	int end;		// end of the values handled by the task
+	bool ok;		// whether every operation of the task succeeded
+} skiplist_task_arg_t;
+
+/** Insert every value of the task, then erase the multiples of 3 among them. */
+void skiplist_task(void *arg) {
+	skiplist_task_arg_t *task_arg = arg;
+	task_arg->ok = true;
+	for (int i = task_arg->first; i < task_arg->end; i += task_arg->stride) {
+		task_arg->ok &= skiplist_insert(task_arg->skiplist, &i);
+	}
+	for (int i = task_arg->first; i < task_arg->end; i += task_arg->stride) {
+		task_arg->ok &= skiplist_contains(task_arg->skiplist, &i);
+		if (i % 3 == 0) task_arg->ok &= skiplist_erase(task_arg->skiplist, &i);
+	}
+}
+
+/** Tests for concurrent skip list. */
+void test_skiplist(void) {
+	// empty skip list
+	skiplist_t *skiplist = skiplist_new(sizeof(int), int_compare);
+	assert_equal(0, skiplist_len(skiplist));
+	int int_value = 5;
+	assert_false(skiplist_contains(skiplist, &int_value));
+	assert_false(skiplist_erase(skiplist, &int_value));
+	skiplist_iter_t *iter = skiplist_iter_new(skiplist);
+	assert_equal(NULL, skiplist_iter_next(iter));
+	skiplist_iter_free(iter);
+
+	// insert in shuffled order, rejecting duplicates
+	for (int i = 0; i < 1000; i++) {
+		int value = i * 7 % 1000 * 2;
+		assert_true(skiplist_insert(skiplist, &value));
+	}
+	assert_equal(1000, skiplist_len(skiplist));
+	int_value = 10;
+	assert_false(skiplist_insert(skiplist, &int_value));
+	assert_equal(1000, skiplist_len(skiplist));
+	assert_true(skiplist_contains(skiplist, &int_value));
+	int_value = 11;
+	assert_false(skiplist_contains(skiplist, &int_value));
+
+	// iteration is in ascending order
+	iter = skiplist_iter_new(skiplist);
+	for (int i = 0; i < 1000; i++) {
+		assert_equal(i * 2, *(const int*)skiplist_iter_next(iter));
+	}
+	assert_equal(NULL, skiplist_iter_next(iter));
+	skiplist_iter_free(iter);
+
+	// erase
+	for (int i = 0; i < 2000; i += 4) {
+		assert_true(skiplist_erase(skiplist, &i));
+		assert_false(skiplist_erase(skiplist, &i));
+		assert_false(skiplist_contains(skiplist, &i));
+	}
+	assert_equal(500, skiplist_len(skiplist));
+
+	// lower bound on present and absent values, and past the end
+	int_value = 6;
+	iter = skiplist_lower_bound(skiplist, &int_value);
+	assert_equal(6, *(const int*)skiplist_iter_next(iter));
+	assert_equal(10, *(const int*)skiplist_iter_next(iter));
+	skiplist_iter_free(iter);
+	int_value = 7;
+	iter = skiplist_lower_bound(skiplist, &int_value);
+	assert_equal(10, *(const int*)skiplist_iter_next(iter));
+	skiplist_iter_free(iter);
+	int_value = 1999;
+	iter = skiplist_lower_bound(skiplist, &int_value);
+	assert_equal(NULL, skiplist_iter_next(iter));
+	skiplist_iter_free(iter);
+
+	// elements erased before an iterator reaches them are skipped
+	int_value = 2;
+	iter = skiplist_lower_bound(skiplist, &int_value);
+	assert_true(skiplist_erase(skiplist, &int_value));
+	assert_equal(6, *(const int*)skiplist_iter_next(iter));
+	int_value = 10;
+	assert_true(skiplist_erase(skiplist, &int_value));
+	assert_equal(14, *(const int*)skiplist_iter_next(iter));
+	skiplist_iter_free(iter);
+	skiplist_free(skiplist);
+
+	// concurrent inserts and erases of interleaved values
+	skiplist = skiplist_new(sizeof(int), int_compare);
+	threadpool_t *pool = threadpool_new(4, false);
+	skiplist_task_arg_t task_args[4];
+	threadpool_task_t tasks[4];
+	for (int t = 0; t < 4; t++) {
+		task_args[t] = (skiplist_task_arg_t){ skiplist, t, 4, 20000, false };
+		threadpool_spawn(pool, &tasks[t], skiplist_task, &task_args[t]);
+	}
+	for (int t = 0; t < 4; t++) {
+		threadpool_join(pool, &tasks[t]);
+		assert_true(task_args[t].ok);
+	}
+	threadpool_free(pool);
+	assert_equal(20000 - 6667, skiplist_len(skiplist));
+	iter = skiplist_iter_new(skiplist);
+	for (int i = 0; i < 20000; i++) {
+		if (i % 3) assert_equal(i, *(const int*)skiplist_iter_next(iter));
+	}
+	assert_equal(NULL, skiplist_iter_next(iter));
+	skiplist_iter_free(iter);
+	skiplist_free(skiplist);
+}
+
+/** Tests for doubly linked list. */
+void test_linkedlist(void) {
+	linkedlist_t *linkedlist = linkedlist_new(sizeof(int), int_compare);
+	assert_equal(0, linkedlist_len(linkedlist));
+	for (int i = 0; i < 10; i++) {
+		linkedlistnode_t *node = i % 2 ? linkedlist_append(linkedlist, &i) : linkedlist_prepend(linkedlist, &i);
+		assert_equal(i, *(int *)node->value);
+	}
+	assert_equal(10, linkedlist_len(linkedlist));
+	// 8 6 4 2 0 1 3 5 7 9
+	int expected[] = { 8, 6, 4, 2, 0, 1, 3, 5, 7, 9 };
+	int i = 0;
+	for (linkedlistnode_t *node = linkedlist->head; node; node = node->next) {
+		assert_equal(expected[i++], *(int *)node->value);
+	}
+	assert_equal(10, i);
+	for (linkedlistnode_t *node = linkedlist->tail; node; node = node->prev) {
+		assert_equal(expected[--i], *(int *)node->value);
+	}
+	linkedlist_delete(linkedlist, linkedlist->head);
+	linkedlist_delete(linkedlist, linkedlist->tail);
+	linkedlist_delete(linkedlist, linkedlist->head->next);
+	assert_equal(7, linkedlist_len(linkedlist));
+	assert_equal(6, *(int *)linkedlist->head->value);
+	assert_equal(2, *(int *)linkedlist->head->next->value);
+	assert_equal(7, *(int *)linkedlist->tail->value);
+	while (linkedlist->head) {
+		linkedlist_delete(linkedlist, linkedlist->head);
+	}
+	assert_true(linkedlist->tail == NULL);
+	assert_equal(0, linkedlist_len(linkedlist));
+	linkedlist_free(linkedlist);
+
+	// compaction keeps the order and lets nodes be deleted and added after it
+	linkedlist = linkedlist_new(sizeof(int), int_compare);
+	assert_true(linkedlist_compact(linkedlist));
+	assert_true(linkedlist->head == NULL);
+	for (i = 0; i < 1000; i++) {
+		linkedlist_append(linkedlist, &i);
+		linkedlist_prepend(linkedlist, &i);
+	}
+	for (linkedlistnode_t *node = linkedlist->head, *next; node; node = next) {
+		next = node->next;
+		if (*(int *)node->value % 3 == 0) linkedlist_delete(linkedlist, node);
+	}
+	int64_t len = linkedlist_len(linkedlist);
+	arraylist_t *before = arraylist_new(sizeof(int), int_compare);
+	for (linkedlistnode_t *node = linkedlist->head; node; node = node->next) {
+		arraylist_append(before, node->value);
+	}
+	assert_true(linkedlist_compact(linkedlist));
+	assert_equal(len, linkedlist_len(linkedlist));
+	i = 0;
+	for (linkedlistnode_t *node = linkedlist->head; node; node = node->next, i++) {
+		assert_equal(*(int *)arraylist_get(before, i), *(int *)node->value);
+		assert_true(!node->next || (int8_t *)node->next > (int8_t *)node);
+		assert_true(node->prev || node == linkedlist->head);
+	}
+	assert_equal(len, i);
+	assert_equal(*(int *)arraylist_get(before, -1), *(int *)linkedlist->tail->value);
+	linkedlist_delete(linkedlist, linkedlist->head->next);
+	linkedlist_append(linkedlist, &(int){ 5000 });
+	linkedlist_append(linkedlist, &(int){ 5000 });
+	assert_true(linkedlist_compact(linkedlist));
+	assert_equal(len + 1, linkedlist_len(linkedlist));
+	arraylist_free(before);
+
+	// prefetching traversals
+	assert_equal(2, linkedlist_count(linkedlist, &(int){ 5000 }));
+	assert_equal(0, linkedlist_count(linkedlist, &(int){ 5001 }));
+	assert_equal(linkedlist->tail->prev, linkedlist_find(linkedlist, &(int){ 5000 }));
+	assert_equal(NULL, linkedlist_find(linkedlist, &(int){ 5001 }));
+	linkedlist_foreach(linkedlist, increment);
+	assert_equal(5001, *(int *)linkedlist->tail->value);
+	assert_equal(2, linkedlist_count(linkedlist, &(int){ 5001 }));
+	linkedlist_free(linkedlist);
+
+	// values larger than a few pointers are stored inline too
+	linkedlist = linkedlist_new(100, NULL);
+	char value[100];
+	for (int j = 0; j < 100; j++) {
+		memset(value, j, sizeof(value));
+		linkedlist_append(linkedlist, value);
+	}
+	int j = 0;
+	for (linkedlistnode_t *node = linkedlist->head; node; node = node->next, j++) {
+		memset(value, j, sizeof(value));
+		assert_equal(0, memcmp(value, node->value, sizeof(value)));
+	}
+	linkedlist_free(linkedlist);
+}
+
+/** Struct on two intrusive lists at once */
+typedef struct {
+	int id;
+	ds_link_t all;
+	ds_link_t active;
+} linked_object_t;
+
+/** Tests for intrusive linked list. */
+void test_ds_link(void) {
+	ds_link_t all, active, other;
+	ds_link_init(&all);
+	ds_link_init(&active);
+	ds_link_init(&other);
+	assert_false(ds_link_is_linked(&all));
+	linked_object_t objects[6];
+	for (int i = 0; i < 6; i++) {
+		objects[i].id = i;
+		ds_link_init(&objects[i].active);
+		ds_link_insert_before(&all, &objects[i].all);
+		if (i % 2) ds_link_insert_after(&active, &objects[i].active);
+	}
+	assert_true(ds_link_is_linked(&all));
+	assert_false(ds_link_is_linked(&objects[0].active));
+	int i = 0;
+	DS_LINK_FOREACH(link, &all) {
+		assert_equal(i++, DS_CONTAINER_OF(link, linked_object_t, all)->id);
+	}
+	assert_equal(6, i);
+	// 5 3 1
+	int expected_active[] = { 5, 3, 1 };
+	i = 0;
+	DS_LINK_FOREACH(link, &active) {
+		assert_equal(expected_active[i++], DS_CONTAINER_OF(link, linked_object_t, active)->id);
+	}
+	assert_equal(3, i);
+
+	// unlinking from one list leaves the other intact
+	ds_link_unlink(&objects[3].active);
+	ds_link_unlink(&objects[3].active);
+	assert_false(ds_link_is_linked(&objects[3].active));
+	ds_link_unlink(&objects[2].all);
+	i = 0;
+	DS_LINK_FOREACH(link, &all) {
+		i++;
+		assert_not_equal(2, DS_CONTAINER_OF(link, linked_object_t, all)->id);
+	}
+	assert_equal(5, i);
+
+	// move to front from the same list, another list, and no list
+	ds_link_move_to_front(&active, &objects[1].active);
+	ds_link_move_to_front(&active, &objects[1].active);
+	ds_link_move_to_front(&active, &objects[4].active);
+	ds_link_move_to_front(&other, &objects[5].active);
+	int expected_moved[] = { 4, 1 };
+	i = 0;
+	DS_LINK_FOREACH(link, &active) {
+		assert_equal(expected_moved[i++], DS_CONTAINER_OF(link, linked_object_t, active)->id);
+	}
+	assert_equal(2, i);
+
+	// splice appends a whole list and empties it
+	ds_link_splice(&active, &other);
+	assert_false(ds_link_is_linked(&other));
+	ds_link_splice(&active, &other);
+	int expected_spliced[] = { 4, 1, 5 };
+	i = 0;
+	DS_LINK_FOREACH(link, &active) {
+		assert_equal(expected_spliced[i++], DS_CONTAINER_OF(link, linked_object_t, active)->id);
+	}
+	assert_equal(3, i);
+	assert_true(active.prev == &objects[5].active);
+}
+
+/** Count evictions into the int64_t `ctx` and check the evicted value is
+ * twice the key. Used to test cache_on_evict */
+void count_eviction(const void *key, void *value, void *ctx) {
+	assert_equal(2 * *(const int *)key, *(int *)value);
+	(*(int64_t *)ctx)++;
+}
+
+/** Tests for cache. */
+void test_cache(void) {
+	// LRU evicts the least recently used entry
+	cache_t *cache = cache_new(3, sizeof(int), sizeof(int), int_hash, int_compare, CACHE_LRU);
+	int64_t evicted = 0;
+	cache_on_evict(cache, count_eviction, &evicted);
+	assert_equal(NULL, cache_get(cache, &(int){ 1 }));
+	for (int i = 1; i <= 3; i++) {
+		assert_equal(2 * i, *(int *)cache_put(cache, &i, &(int){ 2 * i }));
+	}
+	assert_equal(3, cache_len(cache));
+	assert_equal(2, *(int *)cache_get(cache, &(int){ 1 }));
+	cache_put(cache, &(int){ 4 }, &(int){ 8 });
+	assert_equal(1, evicted);
+	assert_equal(NULL, cache_get(cache, &(int){ 2 }));
+	assert_equal(6, *(int *)cache_get(cache, &(int){ 3 }));
+	// updating an entry makes it the most recently used, without evicting
+	cache_put(cache, &(int){ 1 }, &(int){ 2 });
+	cache_put(cache, &(int){ 5 }, &(int){ 10 });
+	assert_equal(2, evicted);
+	assert_equal(NULL, cache_get(cache, &(int){ 4 }));
+	assert_equal(2, *(int *)cache_get(cache, &(int){ 1 }));
+	assert_equal(3, cache_len(cache));
+	assert_equal(3, cache->hits);
+	assert_equal(3, cache->misses);
+	assert_equal(2, cache->evictions);
+	// removing frees an entry without evicting
+	assert_true(cache_remove(cache, &(int){ 3 }));
+	assert_false(cache_remove(cache, &(int){ 3 }));
+	assert_equal(2, cache_len(cache));
+	cache_put(cache, &(int){ 6 }, &(int){ 12 });
+	assert_equal(2, evicted);
+	cache_put(cache, &(int){ 7 }, &(int){ 14 });
+	assert_equal(3, evicted);
+	assert_equal(NULL, cache_get(cache, &(int){ 5 }));
+	cache_free(cache);
+
+	// CLOCK gives entries hit since the hand passed a second chance
+	cache = cache_new(3, sizeof(int), sizeof(int), int_hash, int_compare, CACHE_CLOCK);
+	evicted = 0;
+	cache_on_evict(cache, count_eviction, &evicted);
+	for (int i = 1; i <= 3; i++) {
+		cache_put(cache, &i, &(int){ 2 * i });
+	}
+	cache_get(cache, &(int){ 1 });
+	cache_get(cache, &(int){ 3 });
+	cache_put(cache, &(int){ 4 }, &(int){ 8 });
+	assert_equal(1, evicted);
+	assert_equal(NULL, cache_get(cache, &(int){ 2 }));
+	assert_equal(2, *(int *)cache_get(cache, &(int){ 1 }));
+	assert_equal(6, *(int *)cache_get(cache, &(int){ 3 }));
+	assert_equal(8, *(int *)cache_get(cache, &(int){ 4 }));
+	cache_free(cache);
+
+	// many keys through a small cache with colliding buckets
+	cache = cache_new(100, sizeof(int), sizeof(int), int_hash, int_compare, CACHE_LRU);
+	for (int i = 0; i < 10000; i++) {
+		cache_put(cache, &i, &(int){ 2 * i });
+		assert_equal(i / 2 * 4, *(int *)cache_get(cache, &(int){ i / 2 * 2 }));
+	}
+	assert_equal(100, cache_len(cache));
+	int found = 0;
+	for (int i = 0; i < 10000; i++) {
+		int *value = cache_get(cache, &i);
+		if (value) {
+			assert_equal(2 * i, *value);
+			found++;
+		}
+	}
+	assert_equal(100, found);
+	cache_free(cache);
+}
+
+/** Tests for profiling. Statistics are only recorded when the library is
+ * built with DS_PROFILE. */
+void test_profile(void) {
+	ds_profile_reset();
+	arraylist_t *arraylist = arraylist_new(sizeof(int), int_compare);
+	for (int i = 0; i < 10000; i++) {
+		arraylist_append(arraylist, &i);
+	}
+	arraylist_free(arraylist);
+	ds_profile_stats_t stats[128];
+	int64_t num_ops = MIN(ds_profile_snapshot(stats, COUNTOF(stats)), (int64_t)COUNTOF(stats));
+	int64_t appends = 0, news = 0, nested_news = 0;
+	for (int64_t i = 0; i < num_ops; i++) {
+		assert_true(stats[i].p50 <= stats[i].p99 && stats[i].p99 <= stats[i].p999 && stats[i].p999 <= stats[i].max);
+		if (!strcmp(stats[i].name, "arraylist_append")) appends = stats[i].count;
+		if (!strcmp(stats[i].name, "arraylist_new")) news = stats[i].count;
+		if (!strcmp(stats[i].name, "arraylist_new_aligned")) nested_news = stats[i].count;
+	}
+#ifdef DS_PROFILE
+	assert_equal(10000, appends);
+	// arraylist_new calls arraylist_new_aligned, which is not recorded again
+	assert_equal(1, news);
+	assert_equal(0, nested_news);
+	// counters may be unavailable, such as in containers
+	if (ds_profile_enable_counters(true)) {
+		arraylist = arraylist_new(sizeof(int), int_compare);
+		arraylist_free(arraylist);
+		assert_true(ds_profile_enable_counters(false));
+	}
+	const char *path = "profile_test.txt";
+	FILE *file = open_file(path, "w");
+	assert_true(file != NULL);
+	ds_profile_report(file);
+	assert_true(ftell(file) > 0);
+	fclose(file);
+	remove(path);
+#else
+	assert_equal(0, appends);
+	assert_equal(0, news + nested_news);
+	assert_equal(0, num_ops);
+#endif
+	ds_profile_reset();
+}
+
 int main(void) {
 	run_test(test_arraylist);
+	run_test(test_arraylist_remove_if);
+	run_test(test_arraylist_select);
+	run_test(test_arraylist_merge);
+	run_test(test_arraylist_batch);
+	run_test(test_extsort);
+	run_test(test_arraylist_argsort);
+	run_test(test_arraylist_aligned);
+	run_test(test_arraylist_view);
+	run_test(test_bloom);
+	run_test(test_columnlist);
+	run_test(test_segvec);
+	run_test(test_varlist);
+	run_test(test_searchindex);
+	run_test(test_intlist);
+	run_test(test_bitset);
+	run_test(test_pvector);
+	run_test(test_skiplist);
+	run_test(test_arraylist_parallel);
+	run_test(test_threadpool);
+	run_test(test_linkedlist);
+	run_test(test_ds_link);
+	run_test(test_cache);
+	run_test(test_profile);
 	return EXIT_SUCCESS;
 }